@@ -13,6 +13,10 @@ extern "C" {
 /* Counting puts */
 typedef char * shmemx_ct_t;
 
+/* Streamed gets: called with each piece of the destination buffer as it
+ * arrives, in address order */
+typedef void (*shmemx_stream_fn_t)(void *chunk, size_t nbytes, void *arg);
+
 /* Counter */
 typedef struct {
     uint64_t pending_put;
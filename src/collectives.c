@@ -15,12 +15,14 @@
 
 #include "config.h"
 #include <string.h>
+#include <inttypes.h>
 
 #define SHMEM_INTERNAL_INCLUDE
 #include "shmem.h"
 #include "shmem_internal.h"
 #include "shmem_collectives.h"
 #include "shmem_internal_op.h"
+#include "uthash.h"
 
 coll_type_t shmem_internal_barrier_type = AUTO;
 coll_type_t shmem_internal_bcast_type = AUTO;
@@ -35,13 +37,47 @@ char *coll_type_str[] = { "AUTO",
                           "TREE",
                           "DISSEM",
                           "RING",
-                          "RECDBL" };
+                          "RECDBL",
+                          "PIPELINED",
+                          "SCATTER_ALLGATHER",
+                          "HIERARCHICAL",
+                          "SHM",
+                          "RABENSEIFNER",
+                          "SCAN" };
 
 static int *full_tree_children;
 static int full_tree_num_children;
 static int full_tree_parent;
 static long tree_radix = -1;
 
+/* Node index of every PE, numbered in order of the lowest PE on each node.
+ * Only built when a hierarchical algorithm is selected. */
+static int *node_of_pe = NULL;
+static int num_nodes = 0;
+
+struct hier_key_t {
+    int PE_start;
+    int PE_stride;
+    int PE_size;
+};
+
+/* Node layout of an active set, as seen from this PE */
+struct hier_set_t {
+    struct hier_key_t key;
+    int   num_local;        /* Members on this PE's node */
+    int  *local;            /* ... in active set order */
+    int   num_leaders;      /* Nodes with at least one member */
+    int  *leaders;          /* Lowest member of each node, in active set order */
+    int   my_leader_idx;    /* Index of this PE's node in leaders */
+    int  *node_leader_idx;  /* Index in leaders of each node, or -1 */
+    UT_hash_handle hh;
+};
+
+static struct hier_set_t *hier_sets = NULL;
+#ifdef ENABLE_THREADS
+static shmem_internal_mutex_t hier_sets_lock;
+#endif
+
 
 static int
 shmem_internal_build_kary_tree(int radix, int PE_start, int stride,
@@ -107,8 +143,192 @@ shmem_internal_circular_iter_next(int curr, int PE_start, int PE_stride, int PE_
 }
 
 
+/* Address of a symmetric collective buffer on a PE of a shared memory
+ * active set */
+static inline void *
+shmem_internal_coll_shr_ptr(const void *addr, int pe)
+{
+    void *ptr = shmem_internal_ptr(addr, pe);
+
+#ifdef ENABLE_ERROR_CHECKING
+    if (NULL == ptr) {
+        RAISE_ERROR_MSG("Collective buffer (0x%"PRIXPTR") is not symmetric\n",
+                        (uintptr_t) addr);
+    }
+#endif
+
+    return ptr;
+}
+
+
+/* Learn the node of every PE.  Each PE contributes the lowest PE on its
+ * node, which is found from the runtime's node ranks. */
+static int
+shmem_internal_build_node_map(void)
+{
+    int i, my_node_pe = shmem_internal_my_pe;
+    int *node_pes;
+    long *psync;
+
+    for (i = 0; i < shmem_internal_my_pe; i++) {
+        if (shmem_runtime_get_node_rank(i) >= 0) {
+            my_node_pe = i;
+            break;
+        }
+    }
+
+    node_pes = shmem_internal_shmalloc(sizeof(int) * shmem_internal_num_pes);
+    psync = shmem_internal_shmalloc(sizeof(long) * SHMEM_COLLECT_SYNC_SIZE);
+    if (NULL == node_pes || NULL == psync) return -1;
+
+    for (i = 0; i < SHMEM_COLLECT_SYNC_SIZE; i++)
+        psync[i] = SHMEM_SYNC_VALUE;
+
+    /* Peers may not have initialized their pSync yet */
+    shmem_runtime_barrier();
+    shmem_internal_fcollect(node_pes, &my_node_pe, sizeof(int), 0, 1,
+                            shmem_internal_num_pes, psync);
+
+    node_of_pe = malloc(sizeof(int) * shmem_internal_num_pes);
+    if (NULL == node_of_pe) return -1;
+
+    /* A node's lowest PE precedes all of the others */
+    for (i = 0; i < shmem_internal_num_pes; i++) {
+        if (node_pes[i] == i)
+            node_of_pe[i] = num_nodes++;
+        else
+            node_of_pe[i] = node_of_pe[node_pes[i]];
+    }
+
+    shmem_runtime_barrier();
+    shmem_internal_free(psync);
+    shmem_internal_free(node_pes);
+
+    DEBUG_MSG("Hierarchical collectives: %d nodes, this PE is on node %d\n",
+              num_nodes, node_of_pe[shmem_internal_my_pe]);
+
+    return 0;
+}
+
+
+/* Look up, or build and cache, the node layout of an active set.  Returns
+ * NULL when the node map is not available. */
+static struct hier_set_t *
+shmem_internal_get_hier_set(int PE_start, int PE_stride, int PE_size)
+{
+    struct hier_key_t key;
+    struct hier_set_t *set;
+    int i, pe, max_local, my_node;
+
+    if (NULL == node_of_pe) return NULL;
+
+    my_node = node_of_pe[shmem_internal_my_pe];
+
+    memset(&key, 0, sizeof(key));
+    key.PE_start = PE_start;
+    key.PE_stride = PE_stride;
+    key.PE_size = PE_size;
+
+    SHMEM_MUTEX_LOCK(hier_sets_lock);
+
+    HASH_FIND(hh, hier_sets, &key, sizeof(key), set);
+    if (NULL != set) goto out;
+
+    max_local = shmem_runtime_get_node_size();
+    if (max_local > PE_size) max_local = PE_size;
+
+    set = malloc(sizeof(struct hier_set_t));
+    if (NULL == set) RAISE_ERROR_STR("Out of memory allocating hierarchy");
+
+    set->key = key;
+    set->num_local = 0;
+    set->num_leaders = 0;
+    set->local = malloc(sizeof(int) * max_local);
+    set->leaders = malloc(sizeof(int) * (PE_size < num_nodes ? PE_size : num_nodes));
+    set->node_leader_idx = malloc(sizeof(int) * num_nodes);
+    if (NULL == set->local || NULL == set->leaders || NULL == set->node_leader_idx)
+        RAISE_ERROR_STR("Out of memory allocating hierarchy");
+
+    for (i = 0; i < num_nodes; i++)
+        set->node_leader_idx[i] = -1;
+
+    for (i = 0, pe = PE_start; i < PE_size; i++, pe += PE_stride) {
+        const int node = node_of_pe[pe];
+
+        if (set->node_leader_idx[node] < 0) {
+            set->node_leader_idx[node] = set->num_leaders;
+            set->leaders[set->num_leaders++] = pe;
+        }
+
+        if (node == my_node) {
+            shmem_internal_assert(set->num_local < max_local);
+            set->local[set->num_local++] = pe;
+        }
+    }
+
+    set->my_leader_idx = set->node_leader_idx[my_node];
+
+    HASH_ADD(hh, hier_sets, key, sizeof(struct hier_key_t), set);
+
+    DEBUG_MSG("Hierarchy of [%d, %d, %d]: %d nodes, %d local PEs, leader %d\n",
+              PE_start, PE_stride, PE_size, set->num_leaders, set->num_local,
+              set->local[0]);
+
+ out:
+    SHMEM_MUTEX_UNLOCK(hier_sets_lock);
+    return set;
+}
+
+
+/* Build a two level tree over an active set.  The PEs on each node are the
+ * children of their node's leader, which is the root on the root's node and
+ * the lowest member elsewhere.  The leaders form a k-ary tree.  children must
+ * have room for tree_radix plus the number of PEs on the node. */
+static void
+shmem_internal_build_hier_tree(struct hier_set_t *set, int real_root,
+                               int *parent, int *num_children, int *children)
+{
+    const int root_idx = set->node_leader_idx[node_of_pe[real_root]];
+    const int nleaders = set->num_leaders;
+    const int my_head = (set->my_leader_idx == root_idx) ? real_root :
+                                                            set->local[0];
+    int i;
+
+#define HEAD_OF(idx_) (((idx_) == root_idx) ? real_root : set->leaders[idx_])
+
+    *num_children = 0;
+
+    if (my_head != shmem_internal_my_pe) {
+        *parent = my_head;
+        return;
+    }
+
+    /* Inter-node children come first, so that data leaves the node before
+     * it is copied within the node */
+    {
+        const int my_id = (set->my_leader_idx - root_idx + nleaders) % nleaders;
+
+        *parent = (my_id == 0) ? shmem_internal_my_pe :
+            HEAD_OF((root_idx + (my_id - 1) / tree_radix) % nleaders);
+
+        for (i = 1; i <= tree_radix; i++) {
+            long tmp = tree_radix * my_id + i;
+            if (tmp < nleaders)
+                children[(*num_children)++] = HEAD_OF((root_idx + tmp) % nleaders);
+        }
+    }
+
+    for (i = 0; i < set->num_local; i++) {
+        if (set->local[i] != shmem_internal_my_pe)
+            children[(*num_children)++] = set->local[i];
+    }
+
+#undef HEAD_OF
+}
+
+
 int
-shmem_internal_collectives_init(void)
+shmem_internal_collectives_init(int enable_node_ranks)
 {
     int i, j, k;
     int tmp_radix;
@@ -117,6 +337,11 @@ shmem_internal_collectives_init(void)
 
     tree_radix = shmem_internal_params.COLL_RADIX;
 
+    if (shmem_internal_params.BCAST_SEGMENT_SIZE == 0) {
+        RAISE_WARN_STR("Ignoring zero broadcast segment size, using 8192 bytes");
+        shmem_internal_params.BCAST_SEGMENT_SIZE = 8192;
+    }
+
     /* initialize barrier_all psync array */
     shmem_internal_barrier_all_psync =
         shmem_internal_shmalloc(sizeof(long) * SHMEM_BARRIER_SYNC_SIZE);
@@ -175,6 +400,10 @@ shmem_internal_collectives_init(void)
             shmem_internal_barrier_type = TREE;
         } else if (0 == strcmp(type, "dissem")) {
             shmem_internal_barrier_type = DISSEM;
+        } else if (0 == strcmp(type, "hierarchical")) {
+            shmem_internal_barrier_type = HIER;
+        } else if (0 == strcmp(type, "shm")) {
+            shmem_internal_barrier_type = SHM;
         } else {
             RAISE_WARN_MSG("Ignoring bad barrier algorithm '%s'\n", type);
         }
@@ -187,6 +416,14 @@ shmem_internal_collectives_init(void)
             shmem_internal_bcast_type = LINEAR;
         } else if (0 == strcmp(type, "tree")) {
             shmem_internal_bcast_type = TREE;
+        } else if (0 == strcmp(type, "pipelined")) {
+            shmem_internal_bcast_type = PIPELINED;
+        } else if (0 == strcmp(type, "scatter-allgather")) {
+            shmem_internal_bcast_type = SCATTER_ALLGATHER;
+        } else if (0 == strcmp(type, "hierarchical")) {
+            shmem_internal_bcast_type = HIER;
+        } else if (0 == strcmp(type, "shm")) {
+            shmem_internal_bcast_type = SHM;
         } else {
             RAISE_WARN_MSG("Ignoring bad broadcast algorithm '%s'\n", type);
         }
@@ -203,6 +440,12 @@ shmem_internal_collectives_init(void)
             shmem_internal_reduce_type = TREE;
         } else if (0 == strcmp(type, "recdbl")) {
             shmem_internal_reduce_type = RECDBL;
+        } else if (0 == strcmp(type, "hierarchical")) {
+            shmem_internal_reduce_type = HIER;
+        } else if (0 == strcmp(type, "shm")) {
+            shmem_internal_reduce_type = SHM;
+        } else if (0 == strcmp(type, "rabenseifner")) {
+            shmem_internal_reduce_type = RABENSEIFNER;
         } else {
             RAISE_WARN_MSG("Ignoring bad reduction algorithm '%s'\n", type);
         }
@@ -213,6 +456,10 @@ shmem_internal_collectives_init(void)
             shmem_internal_collect_type = AUTO;
         } else if (0 == strcmp(type, "linear")) {
             shmem_internal_collect_type = LINEAR;
+        } else if (0 == strcmp(type, "scan")) {
+            shmem_internal_collect_type = SCAN;
+        } else if (0 == strcmp(type, "ring")) {
+            shmem_internal_collect_type = RING;
         } else {
             RAISE_WARN_MSG("Ignoring bad collect algorithm '%s'\n", type);
         }
@@ -229,11 +476,25 @@ shmem_internal_collectives_init(void)
             shmem_internal_fcollect_type = RING;
         } else if (0 == strcmp(type, "recdbl")) {
             shmem_internal_fcollect_type = RECDBL;
+        } else if (0 == strcmp(type, "hierarchical")) {
+            shmem_internal_fcollect_type = HIER;
         } else {
             RAISE_WARN_MSG("Ignoring bad fcollect algorithm '%s'\n", type);
         }
     }
 
+    if (shmem_internal_barrier_type == HIER || shmem_internal_bcast_type == HIER ||
+        shmem_internal_reduce_type == HIER || shmem_internal_fcollect_type == HIER) {
+        if (enable_node_ranks && shmem_internal_num_pes > 1) {
+            SHMEM_MUTEX_INIT(hier_sets_lock);
+            if (0 != shmem_internal_build_node_map()) return -1;
+        } else if (!enable_node_ranks) {
+            /* The hierarchical algorithms fall back to tree and ring
+             * algorithms without a node map */
+            RAISE_WARN_STR("Node ranks are disabled, hierarchical collectives will not be used");
+        }
+    }
+
     return 0;
 }
 
@@ -286,25 +547,13 @@ shmem_internal_sync_linear(int PE_start, int PE_stride, int PE_size, long *pSync
 }
 
 
-void
-shmem_internal_sync_tree(int PE_start, int PE_stride, int PE_size, long *pSync)
+/* Tree barrier over an arbitrary tree, in which this PE is the root if it is
+ * its own parent */
+static void
+shmem_internal_sync_tree_common(int parent, int num_children, int *children,
+                                long *pSync)
 {
     long zero = 0, one = 1;
-    int parent, num_children, *children;
-
-    /* need 1 slot */
-    shmem_internal_assert(SHMEM_BARRIER_SYNC_SIZE >= 1);
-
-    if (PE_size == shmem_internal_num_pes) {
-        /* we're the full tree, use the binomial tree */
-        parent = full_tree_parent;
-        num_children = full_tree_num_children;
-        children = full_tree_children;
-    } else {
-        children = alloca(sizeof(int) * tree_radix);
-        shmem_internal_build_kary_tree(tree_radix, PE_start, PE_stride, PE_size,
-                                       0, &parent, &num_children, children);
-    }
 
     if (num_children != 0) {
         /* Not a pure leaf node */
@@ -367,6 +616,51 @@ shmem_internal_sync_tree(int PE_start, int PE_stride, int PE_size, long *pSync)
 }
 
 
+void
+shmem_internal_sync_tree(int PE_start, int PE_stride, int PE_size, long *pSync)
+{
+    int parent, num_children, *children;
+
+    /* need 1 slot */
+    shmem_internal_assert(SHMEM_BARRIER_SYNC_SIZE >= 1);
+
+    if (PE_size == shmem_internal_num_pes) {
+        /* we're the full tree, use the binomial tree */
+        parent = full_tree_parent;
+        num_children = full_tree_num_children;
+        children = full_tree_children;
+    } else {
+        children = alloca(sizeof(int) * tree_radix);
+        shmem_internal_build_kary_tree(tree_radix, PE_start, PE_stride, PE_size,
+                                       0, &parent, &num_children, children);
+    }
+
+    shmem_internal_sync_tree_common(parent, num_children, children, pSync);
+}
+
+
+void
+shmem_internal_sync_hier(int PE_start, int PE_stride, int PE_size, long *pSync)
+{
+    int parent, num_children, *children;
+    struct hier_set_t *set;
+
+    /* need 1 slot */
+    shmem_internal_assert(SHMEM_BARRIER_SYNC_SIZE >= 1);
+
+    set = shmem_internal_get_hier_set(PE_start, PE_stride, PE_size);
+    if (NULL == set) {
+        shmem_internal_sync_tree(PE_start, PE_stride, PE_size, pSync);
+        return;
+    }
+
+    children = alloca(sizeof(int) * (tree_radix + set->num_local));
+    shmem_internal_build_hier_tree(set, PE_start, &parent, &num_children, children);
+
+    shmem_internal_sync_tree_common(parent, num_children, children, pSync);
+}
+
+
 void
 shmem_internal_sync_dissem(int PE_start, int PE_stride, int PE_size, long *pSync)
 {
@@ -407,6 +701,46 @@ shmem_internal_sync_dissem(int PE_start, int PE_stride, int PE_size, long *pSync
 }
 
 
+/* Shared memory barrier.  Members count in on the root's pSync with an atomic
+ * add, and the root releases each member by storing to the member's own
+ * pSync, so every PE spins on a flag in its own memory.  A PE resets its flag
+ * before it can count in again, so back to back barriers do not need a sense
+ * bit. */
+void
+shmem_internal_sync_shr(int PE_start, int PE_stride, int PE_size, long *pSync)
+{
+    /* need 1 slot */
+    shmem_internal_assert(SHMEM_BARRIER_SYNC_SIZE >= 1);
+
+    if (PE_start == shmem_internal_my_pe) {
+        int pe, i;
+
+        /* wait for N - 1 callins */
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, PE_size - 1);
+
+        /* Clear pSync before any member can count in again */
+        __atomic_store_n(pSync, 0, __ATOMIC_RELAXED);
+
+        for (pe = PE_start + PE_stride, i = 1 ;
+             i < PE_size ;
+             i++, pe += PE_stride) {
+            __atomic_store_n((long *) shmem_internal_coll_shr_ptr(pSync, pe), 1,
+                             __ATOMIC_RELEASE);
+        }
+
+    } else {
+        __atomic_fetch_add((long *) shmem_internal_coll_shr_ptr(pSync, PE_start), 1,
+                           __ATOMIC_ACQ_REL);
+
+        /* wait for release */
+        SHMEM_WAIT(pSync, 0);
+
+        /* Clear pSync */
+        __atomic_store_n(pSync, 0, __ATOMIC_RELAXED);
+    }
+}
+
+
 /*****************************************
  *
  * BROADCAST
@@ -472,32 +806,17 @@ shmem_internal_bcast_linear(void *target, const void *source, size_t len,
 }
 
 
-void
-shmem_internal_bcast_tree(void *target, const void *source, size_t len,
-                          int PE_root, int PE_start, int PE_stride, int PE_size,
-                          long *pSync, int complete)
+/* Store and forward broadcast over an arbitrary tree, in which the root is
+ * its own parent */
+static void
+shmem_internal_bcast_tree_common(void *target, const void *source, size_t len,
+                                 int parent, int num_children, int *children,
+                                 long *pSync, int complete)
 {
     long zero = 0, one = 1;
     long completion = 0;
-    int parent, num_children, *children;
     const void *send_buf = source;
 
-    /* need 1 slot */
-    shmem_internal_assert(SHMEM_BCAST_SYNC_SIZE >= 1);
-
-    if (PE_size == 1 || len == 0) return;
-
-    if (PE_size == shmem_internal_num_pes && 0 == PE_root) {
-        /* we're the full tree, use the binomial tree */
-        parent = full_tree_parent;
-        num_children = full_tree_num_children;
-        children = full_tree_children;
-    } else {
-        children = alloca(sizeof(int) * tree_radix);
-        shmem_internal_build_kary_tree(tree_radix, PE_start, PE_stride, PE_size,
-                                       PE_root, &parent, &num_children, children);
-    }
-
     if (0 != num_children) {
         int i;
 
@@ -560,78 +879,408 @@ shmem_internal_bcast_tree(void *target, const void *source, size_t len,
 }
 
 
-/*****************************************
- *
- * REDUCTION
- *
- *****************************************/
 void
-shmem_internal_op_to_all_linear(void *target, const void *source, size_t count, size_t type_size,
-                                int PE_start, int PE_stride, int PE_size,
-                                void *pWrk, long *pSync,
-                                shm_internal_op_t op, shm_internal_datatype_t datatype)
+shmem_internal_bcast_tree(void *target, const void *source, size_t len,
+                          int PE_root, int PE_start, int PE_stride, int PE_size,
+                          long *pSync, int complete)
 {
+    int parent, num_children, *children;
 
-    long zero = 0, one = 1;
-    long completion = 0;
-
-    /* need 2 slots, plus bcast */
-    shmem_internal_assert(SHMEM_REDUCE_SYNC_SIZE >= 2 + SHMEM_BCAST_SYNC_SIZE);
-
-    if (count == 0) return;
+    /* need 1 slot */
+    shmem_internal_assert(SHMEM_BCAST_SYNC_SIZE >= 1);
 
-    if (PE_start == shmem_internal_my_pe) {
-        int pe, i;
-        /* update our target buffer with our contribution.  The put
-           will flush any atomic cache value that may currently
-           exist. */
-        shmem_internal_put_nb(SHMEM_CTX_DEFAULT, target, source, count * type_size,
-                              shmem_internal_my_pe, &completion);
-        shmem_internal_put_wait(SHMEM_CTX_DEFAULT, &completion);
-        shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+    if (PE_size == 1 || len == 0) return;
 
-        /* let everyone know that it's safe to send to us */
-        for (pe = PE_start + PE_stride, i = 1 ;
-             i < PE_size ;
-             i++, pe += PE_stride) {
-            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one), pe);
-        }
+    if (PE_size == shmem_internal_num_pes && 0 == PE_root) {
+        /* we're the full tree, use the binomial tree */
+        parent = full_tree_parent;
+        num_children = full_tree_num_children;
+        children = full_tree_children;
+    } else {
+        children = alloca(sizeof(int) * tree_radix);
+        shmem_internal_build_kary_tree(tree_radix, PE_start, PE_stride, PE_size,
+                                       PE_root, &parent, &num_children, children);
+    }
 
-        /* Wait for others to acknowledge sending data */
-        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, PE_size - 1);
+    shmem_internal_bcast_tree_common(target, source, len, parent, num_children,
+                                     children, pSync, complete);
+}
 
-        /* reset pSync */
-        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &zero, sizeof(zero), shmem_internal_my_pe);
-        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, 0);
 
-    } else {
-        /* wait for clear to send */
-        SHMEM_WAIT(pSync, 0);
+void
+shmem_internal_bcast_hier(void *target, const void *source, size_t len,
+                          int PE_root, int PE_start, int PE_stride, int PE_size,
+                          long *pSync, int complete)
+{
+    int parent, num_children, *children;
+    struct hier_set_t *set;
 
-        /* reset pSync */
-        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &zero, sizeof(zero), shmem_internal_my_pe);
-        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, 0);
+    /* need 1 slot */
+    shmem_internal_assert(SHMEM_BCAST_SYNC_SIZE >= 1);
 
-        /* send data, ack, and wait for completion */
-        shmem_internal_atomicv(SHMEM_CTX_DEFAULT, target, source, count * type_size,
-                               PE_start, op, datatype, &completion);
-        shmem_internal_put_wait(SHMEM_CTX_DEFAULT, &completion);
-        shmem_internal_fence(SHMEM_CTX_DEFAULT);
+    if (PE_size == 1 || len == 0) return;
 
-        shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one),
-                              PE_start, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+    set = shmem_internal_get_hier_set(PE_start, PE_stride, PE_size);
+    if (NULL == set) {
+        shmem_internal_bcast_tree(target, source, len, PE_root, PE_start,
+                                  PE_stride, PE_size, pSync, complete);
+        return;
     }
 
-    /* broadcast out */
-    shmem_internal_bcast(target, target, count * type_size, 0,
-                         PE_start, PE_stride, PE_size, pSync + 2, 0);
-}
+    children = alloca(sizeof(int) * (tree_radix + set->num_local));
+    shmem_internal_build_hier_tree(set, PE_start + PE_root * PE_stride,
+                                   &parent, &num_children, children);
 
+    shmem_internal_bcast_tree_common(target, source, len, parent, num_children,
+                                     children, pSync, complete);
+}
 
-#define chunk_count(id_, count_, npes_) \
-    (count_)/(npes_) + ((id_) < (count_) % (_npes))
 
-void
+/* Pipelined tree broadcast.  The buffer is split into segments, and segments
+ * are forwarded down the tree as soon as they arrive, so a depth d tree costs
+ * roughly (nsegs + d) segment times rather than d message times.
+ *
+ * The root sends one segment at a time; other PEs forward all of the segments
+ * that have arrived as a batch.  The last segment of a batch is put with a
+ * signal that adds the batch's segment count to the child's pSync counter.
+ * Batches are fenced, so a count of k means the first k segments arrived.
+ * Completion acks from the children are added to the same counter; they can
+ * only arrive after this PE forwarded its last segment.
+ */
+void
+shmem_internal_bcast_pipelined(void *target, const void *source, size_t len,
+                               int PE_root, int PE_start, int PE_stride, int PE_size,
+                               long *pSync, int complete)
+{
+    long zero = 0, one = 1;
+    int parent, num_children, *children;
+    const void *send_buf = source;
+    const size_t seg_size = shmem_internal_params.BCAST_SEGMENT_SIZE;
+    const long nsegs = (long) ((len + seg_size - 1) / seg_size);
+    long sent = 0;
+
+    /* need 1 slot */
+    shmem_internal_assert(SHMEM_BCAST_SYNC_SIZE >= 1);
+    shmem_internal_assert(sizeof(long) == sizeof(uint64_t));
+
+    if (PE_size == 1 || len == 0) return;
+
+    if (PE_size == shmem_internal_num_pes && 0 == PE_root) {
+        /* we're the full tree, use the binomial tree */
+        parent = full_tree_parent;
+        num_children = full_tree_num_children;
+        children = full_tree_children;
+    } else {
+        children = alloca(sizeof(int) * tree_radix);
+        shmem_internal_build_kary_tree(tree_radix, PE_start, PE_stride, PE_size,
+                                       PE_root, &parent, &num_children, children);
+    }
+
+    if (parent != shmem_internal_my_pe) {
+        send_buf = target;
+
+        if (0 == num_children) {
+            /* leaf node, wait for all segments */
+            SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, nsegs);
+            sent = nsegs;
+        }
+    }
+
+    while (sent < nsegs) {
+        long ready = sent + 1;
+        size_t batch_off, last_off, end;
+        int i;
+
+        if (parent != shmem_internal_my_pe) {
+            /* wait for the next segment, then take every segment that has
+             * arrived */
+            SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_GE, sent + 1);
+            ready = SYNC_LOAD(pSync);
+            shmem_internal_membar_acq_rel();
+            shmem_transport_syncmem();
+            shmem_internal_assert(ready <= nsegs);
+        }
+
+        batch_off = sent * seg_size;
+        last_off  = (ready - 1) * seg_size;
+        end       = (ready == nsegs) ? len : ready * seg_size;
+
+        for (i = 0; i < num_children; ++i) {
+            shmem_internal_put_nbi(SHMEM_CTX_DEFAULT, (uint8_t *) target + batch_off,
+                                   (uint8_t *) send_buf + batch_off,
+                                   last_off - batch_off, children[i]);
+        }
+
+        /* order the batch, and the previous batch's signal, before this
+         * batch's signal */
+        if (sent > 0 || last_off > batch_off)
+            shmem_internal_fence(SHMEM_CTX_DEFAULT);
+
+        for (i = 0; i < num_children; ++i) {
+            shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT, (uint8_t *) target + last_off,
+                                          (uint8_t *) send_buf + last_off, end - last_off,
+                                          (uint64_t *) pSync, ready - sent,
+                                          SHMEM_SIGNAL_ADD, children[i]);
+        }
+
+        sent = ready;
+    }
+
+    if (num_children != 0)
+        shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+
+    if (1 == complete) {
+        if (parent != shmem_internal_my_pe) {
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one),
+                                  parent, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+        }
+
+        /* wait for acks from the children */
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ,
+                         num_children + ((parent == shmem_internal_my_pe) ? 0 : nsegs));
+    }
+
+    /* Clear pSync */
+    if (parent != shmem_internal_my_pe || (1 == complete && num_children != 0)) {
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &zero, sizeof(zero),
+                                  shmem_internal_my_pe);
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, 0);
+    }
+}
+
+
+/* Scatter-allgather (van de Geijn) broadcast.  The root puts block i of the
+ * buffer to the PE at position i relative to the root, and the blocks are
+ * then circulated around a ring, so every PE sends and receives about 2n
+ * bytes regardless of the number of PEs.  The root sends from its source
+ * buffer and never receives.
+ *
+ * The root's block signal adds SCATTER_SIGNAL to the pSync counter and each
+ * ring step adds one, so the counter tells a PE both that its own block
+ * arrived and how many ring steps completed.  Ring steps are fenced to keep
+ * their signals in order.
+ */
+#define SCATTER_SIGNAL (1L << 32)
+
+void
+shmem_internal_bcast_scatter_allgather(void *target, const void *source, size_t len,
+                                       int PE_root, int PE_start, int PE_stride,
+                                       int PE_size, long *pSync, int complete)
+{
+    long zero = 0, one = 1;
+    const int group_rank = (shmem_internal_my_pe - PE_start) / PE_stride;
+    /* Position relative to the root */
+    const int my_id = (group_rank - PE_root + PE_size) % PE_size;
+    const int next_proc = PE_start + ((group_rank + 1) % PE_size) * PE_stride;
+    const size_t block = (len + PE_size - 1) / PE_size;
+    int i;
+
+/* Offset and length of the block at position id_, the last blocks may be
+ * short or empty */
+#define BLOCK_OFFSET(id_) (((size_t) (id_) * block < len) ? (size_t) (id_) * block : len)
+#define BLOCK_LEN(id_)    (BLOCK_OFFSET((id_) + 1) - BLOCK_OFFSET(id_))
+
+    /* need 1 slot */
+    shmem_internal_assert(SHMEM_BCAST_SYNC_SIZE >= 1);
+    shmem_internal_assert(sizeof(long) == sizeof(uint64_t));
+
+    if (PE_size == 1 || len == 0) return;
+
+    if (0 == my_id) {
+        int pe, id;
+
+        /* Scatter */
+        for (id = 1; id < PE_size; id++) {
+            pe = PE_start + ((PE_root + id) % PE_size) * PE_stride;
+            shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT, (uint8_t *) target + BLOCK_OFFSET(id),
+                                          (uint8_t *) source + BLOCK_OFFSET(id), BLOCK_LEN(id),
+                                          (uint64_t *) pSync, SCATTER_SIGNAL,
+                                          SHMEM_SIGNAL_ADD, pe);
+        }
+    }
+
+    /* Allgather.  At step i, send the block received at step i - 1 (or this
+     * PE's own block at step 1) to the next PE, unless it is the root. */
+    for (i = 1; i < PE_size; i++) {
+        int id = (my_id - i + 1 + PE_size) % PE_size;
+
+        if (0 != my_id) {
+            /* wait for own block and the previous ring step */
+            SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_GE, SCATTER_SIGNAL + i - 1);
+        }
+
+        if (my_id != PE_size - 1) {
+            shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT, (uint8_t *) target + BLOCK_OFFSET(id),
+                                          (uint8_t *) (0 == my_id ? source : target) + BLOCK_OFFSET(id),
+                                          BLOCK_LEN(id), (uint64_t *) pSync, 1,
+                                          SHMEM_SIGNAL_ADD, next_proc);
+            shmem_internal_fence(SHMEM_CTX_DEFAULT);
+        }
+    }
+
+#undef BLOCK_OFFSET
+#undef BLOCK_LEN
+
+    shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+
+    if (0 == my_id) {
+        if (1 == complete) {
+            /* wait for acks from everyone */
+            SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, PE_size - 1);
+
+            /* Clear pSync */
+            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &zero, sizeof(zero),
+                                      shmem_internal_my_pe);
+            SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, 0);
+        }
+    } else {
+        /* wait for the last ring step */
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, SCATTER_SIGNAL + PE_size - 1);
+
+        /* Clear pSync */
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &zero, sizeof(zero),
+                                  shmem_internal_my_pe);
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, 0);
+
+        if (1 == complete) {
+            /* send ack back to root */
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one),
+                                  PE_start + PE_root * PE_stride,
+                                  SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+        }
+    }
+}
+
+#undef SCATTER_SIGNAL
+
+
+/* Single copy shared memory broadcast.  The root adds SHR_READY to the pSync
+ * of every other PE, which then copies the data straight out of the root's
+ * source buffer and acks in the low bits of the root's pSync.  The root
+ * always waits for the acks, since its source must not change while it is
+ * being read.  A PE can be signaled for the next broadcast before it consumes
+ * the current one's acks or signal, so both are subtracted rather than
+ * cleared. */
+#define SHR_READY (1L << 32)
+
+void
+shmem_internal_bcast_shr(void *target, const void *source, size_t len,
+                         int PE_root, int PE_start, int PE_stride, int PE_size,
+                         long *pSync, int complete)
+{
+    int real_root = PE_start + PE_root * PE_stride;
+
+    /* need 1 slot */
+    shmem_internal_assert(SHMEM_BCAST_SYNC_SIZE >= 1);
+
+    if (PE_size == 1 || len == 0) return;
+
+    if (real_root == shmem_internal_my_pe) {
+        int i, pe;
+
+        for (pe = PE_start, i = 0; i < PE_size; pe += PE_stride, i++) {
+            if (pe == shmem_internal_my_pe) continue;
+            __atomic_fetch_add((long *) shmem_internal_coll_shr_ptr(pSync, pe),
+                               SHR_READY, __ATOMIC_ACQ_REL);
+        }
+
+        /* wait for acks from everyone */
+        while ((__atomic_load_n(pSync, __ATOMIC_ACQUIRE) & (SHR_READY - 1)) < PE_size - 1) {
+            shmem_transport_probe();
+            SPINLOCK_BODY();
+        }
+        shmem_internal_membar_acq_rel();
+
+        __atomic_fetch_sub(pSync, PE_size - 1, __ATOMIC_RELAXED);
+
+    } else {
+        /* wait for the root's signal */
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_GE, SHR_READY);
+        __atomic_fetch_sub(pSync, SHR_READY, __ATOMIC_RELAXED);
+
+        memcpy(target, shmem_internal_coll_shr_ptr(source, real_root), len);
+
+        /* send ack back to root */
+        __atomic_fetch_add((long *) shmem_internal_coll_shr_ptr(pSync, real_root), 1,
+                           __ATOMIC_ACQ_REL);
+    }
+}
+
+#undef SHR_READY
+
+
+/*****************************************
+ *
+ * REDUCTION
+ *
+ *****************************************/
+void
+shmem_internal_op_to_all_linear(void *target, const void *source, size_t count, size_t type_size,
+                                int PE_start, int PE_stride, int PE_size,
+                                void *pWrk, long *pSync,
+                                shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+
+    long zero = 0, one = 1;
+    long completion = 0;
+
+    /* need 2 slots, plus bcast */
+    shmem_internal_assert(SHMEM_REDUCE_SYNC_SIZE >= 2 + SHMEM_BCAST_SYNC_SIZE);
+
+    if (count == 0) return;
+
+    if (PE_start == shmem_internal_my_pe) {
+        int pe, i;
+        /* update our target buffer with our contribution.  The put
+           will flush any atomic cache value that may currently
+           exist. */
+        shmem_internal_put_nb(SHMEM_CTX_DEFAULT, target, source, count * type_size,
+                              shmem_internal_my_pe, &completion);
+        shmem_internal_put_wait(SHMEM_CTX_DEFAULT, &completion);
+        shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+
+        /* let everyone know that it's safe to send to us */
+        for (pe = PE_start + PE_stride, i = 1 ;
+             i < PE_size ;
+             i++, pe += PE_stride) {
+            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one), pe);
+        }
+
+        /* Wait for others to acknowledge sending data */
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, PE_size - 1);
+
+        /* reset pSync */
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &zero, sizeof(zero), shmem_internal_my_pe);
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, 0);
+
+    } else {
+        /* wait for clear to send */
+        SHMEM_WAIT(pSync, 0);
+
+        /* reset pSync */
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &zero, sizeof(zero), shmem_internal_my_pe);
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, 0);
+
+        /* send data, ack, and wait for completion */
+        shmem_internal_atomicv(SHMEM_CTX_DEFAULT, target, source, count * type_size,
+                               PE_start, op, datatype, &completion);
+        shmem_internal_put_wait(SHMEM_CTX_DEFAULT, &completion);
+        shmem_internal_fence(SHMEM_CTX_DEFAULT);
+
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one),
+                              PE_start, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+    }
+
+    /* broadcast out */
+    shmem_internal_bcast(target, target, count * type_size, 0,
+                         PE_start, PE_stride, PE_size, pSync + 2, 0);
+}
+
+
+#define chunk_count(id_, count_, npes_) \
+    (count_)/(npes_) + ((id_) < (count_) % (_npes))
+
+void
 shmem_internal_op_to_all_ring(void *target, const void *source, size_t count, size_t type_size,
                               int PE_start, int PE_stride, int PE_size,
                               void *pWrk, long *pSync,
@@ -751,39 +1400,174 @@ shmem_internal_op_to_all_ring(void *target, const void *source, size_t count, si
 }
 
 
+/* Rabenseifner reduction: a recursive halving reduce-scatter followed by a
+ * recursive doubling allgather, so every PE sends and receives about 2n
+ * bytes in 2 log2(p) steps.  When the set is not a power of two in size,
+ * each of the first PE_size - pow2 PEs first folds in the vector of an extra
+ * PE, and returns the result to it at the end.
+ *
+ * Step i of both phases exchanges with the PE whose id differs in bit
+ * log2(pow2) - i - 1, using pSync[i].  A PE adds one to its peer's slot when
+ * its target can receive, and the peer's data is put with a signal that adds
+ * two, so a slot of three or more means the step's data arrived.  The slot
+ * is decremented rather than cleared because the peer may already be
+ * signaling for the allgather.  The fold-in uses the last pSync slot.
+ */
 void
-shmem_internal_op_to_all_tree(void *target, const void *source, size_t count, size_t type_size,
-                              int PE_start, int PE_stride, int PE_size,
-                              void *pWrk, long *pSync,
-                              shm_internal_op_t op, shm_internal_datatype_t datatype)
+shmem_internal_op_to_all_rabenseifner(void *target, const void *source, size_t count,
+                                      size_t type_size, int PE_start, int PE_stride,
+                                      int PE_size, void *pWrk, long *pSync,
+                                      shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
-    long zero = 0, one = 1;
-    long completion = 0;
-    int parent, num_children, *children;
+    const int my_id = (shmem_internal_my_pe - PE_start) / PE_stride;
+    long * const pSync_extra_peer = pSync + SHMEM_REDUCE_SYNC_SIZE - 1;
+    long one = 1, neg_one = -1, neg_two = -2, neg_three = -3;
+    size_t keep_lo[sizeof(int) * 8], keep_hi[sizeof(int) * 8];
+    size_t send_lo[sizeof(int) * 8], send_hi[sizeof(int) * 8];
+    size_t lo, hi, mid;
+    int log2_proc = 0, pow2_proc = 1;
+    int i, peer;
+    void *acc;
 
-    /* need 2 slots, plus bcast */
-    shmem_internal_assert(SHMEM_REDUCE_SYNC_SIZE >= 2 + SHMEM_BCAST_SYNC_SIZE);
+    if (count == 0) return;
 
     if (PE_size == 1) {
-        if (target != source) {
-            memcpy(target, source, type_size*count);
-        }
+        if (target != source)
+            memcpy(target, source, count * type_size);
         return;
     }
 
-    if (count == 0) return;
+    while (pow2_proc * 2 <= PE_size) {
+        pow2_proc *= 2;
+        log2_proc++;
+    }
 
-    if (PE_size == shmem_internal_num_pes) {
-        /* we're the full tree, use the binomial tree */
-        parent = full_tree_parent;
-        num_children = full_tree_num_children;
-        children = full_tree_children;
-    } else {
-        children = alloca(sizeof(int) * tree_radix);
-        shmem_internal_build_kary_tree(tree_radix, PE_start, PE_stride, PE_size,
-                                       0, &parent, &num_children, children);
+    /* need one slot per step, plus the fold-in slot */
+    shmem_internal_assert(log2_proc < SHMEM_REDUCE_SYNC_SIZE);
+
+    /* Extra PEs hand their vector to a partner and wait for the result */
+    if (my_id >= pow2_proc) {
+        peer = PE_start + (my_id - pow2_proc) * PE_stride;
+
+        SHMEM_WAIT_UNTIL(pSync_extra_peer, SHMEM_CMP_GE, 1);
+        shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT, target, source, count * type_size,
+                                      (uint64_t *) pSync_extra_peer, 1,
+                                      SHMEM_SIGNAL_ADD, peer);
+
+        SHMEM_WAIT_UNTIL(pSync_extra_peer, SHMEM_CMP_GE, 2);
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync_extra_peer, &neg_two, sizeof(long),
+                              shmem_internal_my_pe, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+        shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+        return;
+    }
+
+    /* The target receives peers' data, so reduce into a private copy of the
+     * source; this also handles in-place reductions */
+    acc = malloc(count * type_size);
+    if (NULL == acc)
+        RAISE_ERROR_MSG("Unable to allocate %zub temporary buffer\n", count * type_size);
+    memcpy(acc, source, count * type_size);
+
+    if (my_id < PE_size - pow2_proc) {
+        peer = PE_start + (my_id + pow2_proc) * PE_stride;
+
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync_extra_peer, &one, sizeof(long),
+                              peer, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+        SHMEM_WAIT_UNTIL(pSync_extra_peer, SHMEM_CMP_GE, 1);
+
+        shmem_internal_reduce_local(op, datatype, count, target, acc);
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync_extra_peer, &neg_one, sizeof(long),
+                              shmem_internal_my_pe, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+    }
+
+    /* Reduce-scatter: keep one half of the current range and send the other
+     * half to the peer, which reduces it into its own half */
+    lo = 0;
+    hi = count;
+    for (i = 0; i < log2_proc; i++) {
+        int mask = pow2_proc >> (i + 1);
+
+        mid = lo + (hi - lo) / 2;
+        if (my_id & mask) {
+            keep_lo[i] = mid; keep_hi[i] = hi;
+            send_lo[i] = lo;  send_hi[i] = mid;
+        } else {
+            keep_lo[i] = lo;  keep_hi[i] = mid;
+            send_lo[i] = mid; send_hi[i] = hi;
+        }
+        peer = PE_start + (my_id ^ mask) * PE_stride;
+
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, &pSync[i], &one, sizeof(long),
+                              peer, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+        SHMEM_WAIT_UNTIL(&pSync[i], SHMEM_CMP_GE, 1);
+
+        shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT,
+                                      (uint8_t *) target + send_lo[i] * type_size,
+                                      (uint8_t *) acc + send_lo[i] * type_size,
+                                      (send_hi[i] - send_lo[i]) * type_size,
+                                      (uint64_t *) &pSync[i], 2, SHMEM_SIGNAL_ADD, peer);
+        shmem_internal_fence(SHMEM_CTX_DEFAULT);
+
+        SHMEM_WAIT_UNTIL(&pSync[i], SHMEM_CMP_GE, 3);
+        if (keep_hi[i] > keep_lo[i])
+            shmem_internal_reduce_local(op, datatype, keep_hi[i] - keep_lo[i],
+                                        (uint8_t *) target + keep_lo[i] * type_size,
+                                        (uint8_t *) acc + keep_lo[i] * type_size);
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, &pSync[i], &neg_three, sizeof(long),
+                              shmem_internal_my_pe, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+
+        lo = keep_lo[i];
+        hi = keep_hi[i];
+    }
+
+    memcpy((uint8_t *) target + lo * type_size, (uint8_t *) acc + lo * type_size,
+           (hi - lo) * type_size);
+
+    /* Allgather: retrace the steps, exchanging the reduced halves */
+    for (i = log2_proc - 1; i >= 0; i--) {
+        peer = PE_start + (my_id ^ (pow2_proc >> (i + 1))) * PE_stride;
+
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, &pSync[i], &one, sizeof(long),
+                              peer, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+        SHMEM_WAIT_UNTIL(&pSync[i], SHMEM_CMP_GE, 1);
+
+        shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT,
+                                      (uint8_t *) target + keep_lo[i] * type_size,
+                                      (uint8_t *) target + keep_lo[i] * type_size,
+                                      (keep_hi[i] - keep_lo[i]) * type_size,
+                                      (uint64_t *) &pSync[i], 2, SHMEM_SIGNAL_ADD, peer);
+        shmem_internal_fence(SHMEM_CTX_DEFAULT);
+
+        SHMEM_WAIT_UNTIL(&pSync[i], SHMEM_CMP_GE, 3);
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, &pSync[i], &neg_three, sizeof(long),
+                              shmem_internal_my_pe, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+    }
+
+    /* Return the result to the extra PE */
+    if (my_id < PE_size - pow2_proc) {
+        peer = PE_start + (my_id + pow2_proc) * PE_stride;
+
+        shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT, target, target, count * type_size,
+                                      (uint64_t *) pSync_extra_peer, 1,
+                                      SHMEM_SIGNAL_ADD, peer);
     }
 
+    /* Complete outstanding puts from acc and the local pSync decrements */
+    shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+    free(acc);
+}
+
+
+/* Reduce up an arbitrary tree into the root's target buffer */
+static void
+shmem_internal_reduce_tree_common(void *target, const void *source, size_t count,
+                                  size_t type_size, int parent, int num_children,
+                                  int *children, long *pSync,
+                                  shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    long zero = 0, one = 1;
+    long completion = 0;
+
     if (0 != num_children) {
         int i;
 
@@ -827,6 +1611,42 @@ shmem_internal_op_to_all_tree(void *target, const void *source, size_t count, si
         shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one),
                               parent, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
     }
+}
+
+
+void
+shmem_internal_op_to_all_tree(void *target, const void *source, size_t count, size_t type_size,
+                              int PE_start, int PE_stride, int PE_size,
+                              void *pWrk, long *pSync,
+                              shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    int parent, num_children, *children;
+
+    /* need 2 slots, plus bcast */
+    shmem_internal_assert(SHMEM_REDUCE_SYNC_SIZE >= 2 + SHMEM_BCAST_SYNC_SIZE);
+
+    if (PE_size == 1) {
+        if (target != source) {
+            memcpy(target, source, type_size*count);
+        }
+        return;
+    }
+
+    if (count == 0) return;
+
+    if (PE_size == shmem_internal_num_pes) {
+        /* we're the full tree, use the binomial tree */
+        parent = full_tree_parent;
+        num_children = full_tree_num_children;
+        children = full_tree_children;
+    } else {
+        children = alloca(sizeof(int) * tree_radix);
+        shmem_internal_build_kary_tree(tree_radix, PE_start, PE_stride, PE_size,
+                                       0, &parent, &num_children, children);
+    }
+
+    shmem_internal_reduce_tree_common(target, source, count, type_size, parent,
+                                      num_children, children, pSync, op, datatype);
 
     /* broadcast out */
     shmem_internal_bcast(target, target, count * type_size, 0, PE_start,
@@ -834,6 +1654,107 @@ shmem_internal_op_to_all_tree(void *target, const void *source, size_t count, si
 }
 
 
+void
+shmem_internal_op_to_all_hier(void *target, const void *source, size_t count, size_t type_size,
+                              int PE_start, int PE_stride, int PE_size,
+                              void *pWrk, long *pSync,
+                              shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    int parent, num_children, *children;
+    struct hier_set_t *set;
+
+    /* need 2 slots, plus bcast */
+    shmem_internal_assert(SHMEM_REDUCE_SYNC_SIZE >= 2 + SHMEM_BCAST_SYNC_SIZE);
+
+    set = (PE_size == 1) ? NULL :
+        shmem_internal_get_hier_set(PE_start, PE_stride, PE_size);
+    if (NULL == set) {
+        shmem_internal_op_to_all_tree(target, source, count, type_size,
+                                      PE_start, PE_stride, PE_size,
+                                      pWrk, pSync, op, datatype);
+        return;
+    }
+
+    if (count == 0) return;
+
+    children = alloca(sizeof(int) * (tree_radix + set->num_local));
+    shmem_internal_build_hier_tree(set, PE_start, &parent, &num_children, children);
+
+    shmem_internal_reduce_tree_common(target, source, count, type_size, parent,
+                                      num_children, children, pSync, op, datatype);
+
+    /* broadcast out, down the same tree */
+    shmem_internal_bcast_hier(target, target, count * type_size, 0, PE_start,
+                              PE_stride, PE_size, pSync + 2, 0);
+}
+
+
+/* Shared memory reduce-scatter plus allgather.  Each PE reduces its slice of
+ * the buffer directly out of every PE's source into its own target, then
+ * copies the other slices out of their owners' targets.  Every element is
+ * reduced by exactly one PE, in PE order, so all PEs see the same result. */
+void
+shmem_internal_op_to_all_shr(void *target, const void *source, size_t count, size_t type_size,
+                             int PE_start, int PE_stride, int PE_size,
+                             void *pWrk, long *pSync,
+                             shm_internal_op_t op, shm_internal_datatype_t datatype)
+{
+    const int group_rank = (shmem_internal_my_pe - PE_start) / PE_stride;
+    const size_t block = (count + PE_size - 1) / PE_size;
+    size_t my_offset, my_count;
+    int i, pe;
+
+/* Element offset and count of the slice reduced by group rank id_, the last
+ * slices may be short or empty */
+#define SLICE_OFFSET(id_) (((size_t) (id_) * block < count) ? (size_t) (id_) * block : count)
+#define SLICE_COUNT(id_)  (SLICE_OFFSET((id_) + 1) - SLICE_OFFSET(id_))
+
+    /* need 1 slot */
+    shmem_internal_assert(SHMEM_REDUCE_SYNC_SIZE >= 1);
+
+    if (count == 0) return;
+
+    if (PE_size == 1) {
+        if (target != source) memcpy(target, source, count * type_size);
+        return;
+    }
+
+    my_offset = SLICE_OFFSET(group_rank) * type_size;
+    my_count  = SLICE_COUNT(group_rank);
+
+    /* wait for every PE's source */
+    shmem_internal_sync_shr(PE_start, PE_stride, PE_size, pSync);
+
+    if (my_count > 0) {
+        memmove((uint8_t *) target + my_offset, (uint8_t *) source + my_offset,
+                my_count * type_size);
+
+        for (pe = PE_start, i = 0; i < PE_size; pe += PE_stride, i++) {
+            if (pe == shmem_internal_my_pe) continue;
+            shmem_internal_reduce_local(op, datatype, my_count,
+                                        (uint8_t *) shmem_internal_coll_shr_ptr(source, pe) + my_offset,
+                                        (uint8_t *) target + my_offset);
+        }
+    }
+
+    /* wait for every slice, sources are no longer read after this */
+    shmem_internal_sync_shr(PE_start, PE_stride, PE_size, pSync);
+
+    for (pe = PE_start, i = 0; i < PE_size; pe += PE_stride, i++) {
+        if (pe == shmem_internal_my_pe || SLICE_COUNT(i) == 0) continue;
+        memcpy((uint8_t *) target + SLICE_OFFSET(i) * type_size,
+               (uint8_t *) shmem_internal_coll_shr_ptr(target, pe) + SLICE_OFFSET(i) * type_size,
+               SLICE_COUNT(i) * type_size);
+    }
+
+#undef SLICE_OFFSET
+#undef SLICE_COUNT
+
+    /* keep targets in place until every PE has copied from them */
+    shmem_internal_sync_shr(PE_start, PE_stride, PE_size, pSync);
+}
+
+
 void
 shmem_internal_op_to_all_recdbl_sw(void *target, const void *source, size_t count, size_t type_size,
                                    int PE_start, int PE_stride, int PE_size,
@@ -1040,6 +1961,255 @@ shmem_internal_collect_linear(void *target, const void *source, size_t len,
 }
 
 
+/* Exclusive prefix sum of the PEs' lengths, by recursive doubling.  At step
+ * i, each PE sends its partial sum 2^i PEs up and adds the partial sum from
+ * 2^i PEs down, so after ceil(log2(PE_size)) steps each PE has the sum of its
+ * own and all lower lengths.  Partial sums are sent plus one, so a nonzero
+ * pSync[i] means step i's sum arrived.  Also returns the length of the
+ * previous PE, which is the first sum received. */
+static void
+shmem_internal_collect_offset(size_t len, int PE_start, int PE_stride, int PE_size,
+                              long *pSync, size_t *offset, size_t *prev_len)
+{
+    const int group_rank = (shmem_internal_my_pe - PE_start) / PE_stride;
+    size_t sum = len;
+    long tmp;
+    int i, distance;
+
+    *prev_len = 0;
+
+    for (i = 0, distance = 1; distance < PE_size; i++, distance <<= 1) {
+        if (group_rank + distance < PE_size) {
+            tmp = (long) sum + 1; /* FIXME: Potential truncation of size_t into long */
+            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, &pSync[i], &tmp, sizeof(long),
+                                      shmem_internal_my_pe + distance * PE_stride);
+        }
+
+        if (group_rank >= distance) {
+            SHMEM_WAIT(&pSync[i], 0);
+            tmp = pSync[i] - 1;
+            pSync[i] = SHMEM_SYNC_VALUE;
+
+            if (i == 0) *prev_len = (size_t) tmp;
+            sum += (size_t) tmp;
+        }
+    }
+
+    *offset = sum - len;
+}
+
+
+/* Number of pSync slots used by shmem_internal_collect_offset */
+static inline int
+shmem_internal_collect_offset_steps(int PE_size)
+{
+    int steps = 0, distance;
+
+    for (distance = 1; distance < PE_size; distance <<= 1)
+        steps++;
+
+    return steps;
+}
+
+
+/* Offsets from a recursive doubling scan, then every PE puts its data to all
+ * of the others.  Each put carries a signal, so a PE is done once PE_size - 1
+ * signals have arrived. */
+void
+shmem_internal_collect_scan(void *target, const void *source, size_t len,
+                            int PE_start, int PE_stride, int PE_size, long *pSync)
+{
+    long * const pSync_count = pSync + SHMEM_COLLECT_SYNC_SIZE - 1;
+    long zero = 0;
+    size_t my_offset, prev_len;
+    int peer, start_pe;
+
+    DEBUG_MSG("target=%p, source=%p, len=%zd, PE_Start=%d, PE_stride=%d, PE_size=%d, pSync=%p\n",
+              target, source, len, PE_start, PE_stride, PE_size, (void*) pSync);
+
+    if (PE_size == 1) {
+        if (target != source) memcpy(target, source, len);
+        return;
+    }
+
+    /* need one slot per scan step, plus the counter */
+    if (shmem_internal_collect_offset_steps(PE_size) > SHMEM_COLLECT_SYNC_SIZE - 1) {
+        shmem_internal_collect_linear(target, source, len, PE_start, PE_stride,
+                                      PE_size, pSync);
+        return;
+    }
+
+    shmem_internal_collect_offset(len, PE_start, PE_stride, PE_size, pSync,
+                                  &my_offset, &prev_len);
+
+    /* Send data round-robin, ending with my PE */
+    start_pe = shmem_internal_circular_iter_next(shmem_internal_my_pe,
+                                                 PE_start, PE_stride,
+                                                 PE_size);
+    peer = start_pe;
+    do {
+        if (peer == shmem_internal_my_pe) {
+            if (len > 0) memcpy((uint8_t *) target + my_offset, source, len);
+        } else {
+            shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT, (uint8_t *) target + my_offset,
+                                          source, len, (uint64_t *) pSync_count, 1,
+                                          SHMEM_SIGNAL_ADD, peer);
+        }
+        peer = shmem_internal_circular_iter_next(peer, PE_start, PE_stride,
+                                                 PE_size);
+    } while (peer != start_pe);
+
+    SHMEM_WAIT_UNTIL(pSync_count, SHMEM_CMP_GE, PE_size - 1);
+
+    /* Clear pSync */
+    shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync_count, &zero, sizeof(zero),
+                              shmem_internal_my_pe);
+    SHMEM_WAIT_UNTIL(pSync_count, SHMEM_CMP_EQ, 0);
+
+    /* Complete the puts from source */
+    shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+}
+
+
+/* Offsets from a recursive doubling scan, then the data is passed down a
+ * ring, so each PE sends and receives about the size of the result no matter
+ * how many PEs there are.
+ *
+ * Each PE passes everything it has to the previous PE, except that PE's own
+ * block.  A PE receives the data above its block in address order, which is
+ * counted in pSync_head, then the data from offset zero up to its block,
+ * which is counted in pSync_tail.  The head is complete when RING_DONE is
+ * added to the count, since only the last PE knows where the data ends.  PE 0
+ * passes its data to the last PE, which has nothing above its block, so PE 0
+ * sends everything to the last PE's tail.
+ */
+#define RING_DONE (1L << 62)
+
+void
+shmem_internal_collect_ring(void *target, const void *source, size_t len,
+                            int PE_start, int PE_stride, int PE_size, long *pSync)
+{
+    const int group_rank = (shmem_internal_my_pe - PE_start) / PE_stride;
+    const int to = PE_start + ((group_rank + PE_size - 1) % PE_size) * PE_stride;
+    long * const pSync_head  = pSync + SHMEM_COLLECT_SYNC_SIZE - 1;
+    long * const pSync_tail  = pSync + SHMEM_COLLECT_SYNC_SIZE - 2;
+    long * const pSync_bound = pSync + SHMEM_COLLECT_SYNC_SIZE - 3;
+    long done = RING_DONE, tmp;
+    size_t my_offset, prev_len, to_offset;
+    size_t head_sent, head_end, tail_sent, tail_end;
+    long head, tail;
+    int done_sent = 0;
+
+    DEBUG_MSG("target=%p, source=%p, len=%zd, PE_Start=%d, PE_stride=%d, PE_size=%d, pSync=%p\n",
+              target, source, len, PE_start, PE_stride, PE_size, (void*) pSync);
+
+    if (PE_size == 1) {
+        if (target != source) memcpy(target, source, len);
+        return;
+    }
+
+    /* need one slot per scan step, plus head, tail, and bound */
+    if (shmem_internal_collect_offset_steps(PE_size) > SHMEM_COLLECT_SYNC_SIZE - 3) {
+        shmem_internal_collect_linear(target, source, len, PE_start, PE_stride,
+                                      PE_size, pSync);
+        return;
+    }
+
+    shmem_internal_collect_offset(len, PE_start, PE_stride, PE_size, pSync,
+                                  &my_offset, &prev_len);
+
+    if (len > 0) memcpy((uint8_t *) target + my_offset, source, len);
+
+    /* The last PE's offset is not known to PE 0, send it around */
+    if (group_rank == PE_size - 1) {
+        tmp = (long) my_offset + 1;
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync_bound, &tmp, sizeof(long),
+                                  PE_start);
+    }
+
+    if (group_rank == 0) {
+        SHMEM_WAIT(pSync_bound, 0);
+        to_offset = (size_t) (*pSync_bound - 1);
+        *pSync_bound = SHMEM_SYNC_VALUE;
+
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync_head, &done, sizeof(long),
+                              to, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+        done_sent = 1;
+    } else {
+        to_offset = my_offset - prev_len;
+    }
+
+    /* The head includes this PE's own block */
+    head_sent = my_offset;
+    tail_sent = 0;
+
+    for (;;) {
+        head = SYNC_LOAD(pSync_head);
+        tail = SYNC_LOAD(pSync_tail);
+        shmem_internal_membar_acq_rel();
+        shmem_transport_syncmem();
+
+        head_end = my_offset + len + (size_t) (head & ~RING_DONE);
+
+        if (group_rank == 0) {
+            /* Everything goes to the tail of the last PE */
+            head_end = MIN(head_end, to_offset);
+            if (head_end > head_sent) {
+                shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT, (uint8_t *) target + head_sent,
+                                              (uint8_t *) target + head_sent, head_end - head_sent,
+                                              (uint64_t *) pSync_tail, head_end - head_sent,
+                                              SHMEM_SIGNAL_ADD, to);
+                shmem_internal_fence(SHMEM_CTX_DEFAULT);
+                head_sent = head_end;
+            }
+
+            if ((head & RING_DONE) && head_sent == to_offset)
+                break;
+
+        } else {
+            if (head_end > head_sent) {
+                shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT, (uint8_t *) target + head_sent,
+                                              (uint8_t *) target + head_sent, head_end - head_sent,
+                                              (uint64_t *) pSync_head, head_end - head_sent,
+                                              SHMEM_SIGNAL_ADD, to);
+                shmem_internal_fence(SHMEM_CTX_DEFAULT);
+                head_sent = head_end;
+            }
+
+            if ((head & RING_DONE) && !done_sent) {
+                shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync_head, &done, sizeof(long),
+                                      to, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+                shmem_internal_fence(SHMEM_CTX_DEFAULT);
+                done_sent = 1;
+            }
+
+            tail_end = MIN((size_t) tail, to_offset);
+            if (tail_end > tail_sent) {
+                shmem_internal_put_signal_nbi(SHMEM_CTX_DEFAULT, (uint8_t *) target + tail_sent,
+                                              (uint8_t *) target + tail_sent, tail_end - tail_sent,
+                                              (uint64_t *) pSync_tail, tail_end - tail_sent,
+                                              SHMEM_SIGNAL_ADD, to);
+                shmem_internal_fence(SHMEM_CTX_DEFAULT);
+                tail_sent = tail_end;
+            }
+
+            if (done_sent && tail_sent == to_offset && (size_t) tail == my_offset)
+                break;
+        }
+
+        shmem_transport_probe();
+        SPINLOCK_BODY();
+    }
+
+    /* Nothing more is sent to this PE, clear pSync */
+    *pSync_head = SHMEM_SYNC_VALUE;
+    *pSync_tail = SHMEM_SYNC_VALUE;
+
+    shmem_internal_quiet(SHMEM_CTX_DEFAULT);
+}
+
+#undef RING_DONE
+
 /*****************************************
  *
  * COLLECT (same size)
@@ -1210,6 +2380,120 @@ shmem_internal_fcollect_recdbl(void *target, const void *source, size_t len,
 }
 
 
+/* Two level algorithm.  Each PE sends its block to its node leader, the
+ * leaders exchange their nodes' blocks, and each leader copies the result
+ * to the PEs on its node.  Blocks from PEs with consecutive positions in the
+ * active set are sent between leaders as one message.
+ *
+ * pSync[0] counts blocks arriving from the node, pSync[1] counts leaders
+ * that have sent their blocks, and pSync[2] marks the result as arrived on
+ * the other PEs.
+ */
+void
+shmem_internal_fcollect_hier(void *target, const void *source, size_t len,
+                             int PE_start, int PE_stride, int PE_size, long *pSync)
+{
+    int my_id = ((shmem_internal_my_pe - PE_start) / PE_stride);
+    long completion = 0;
+    long zero = 0, one = 1;
+    struct hier_set_t *set;
+    int i, j;
+
+    /* need 3 slots */
+    shmem_internal_assert(SHMEM_COLLECT_SYNC_SIZE >= 3);
+
+    if (len == 0) return;
+
+    set = (PE_size == 1) ? NULL :
+        shmem_internal_get_hier_set(PE_start, PE_stride, PE_size);
+    if (NULL == set) {
+        shmem_internal_fcollect_ring(target, source, len, PE_start, PE_stride,
+                                     PE_size, pSync);
+        return;
+    }
+
+    if (set->local[0] != shmem_internal_my_pe) {
+        /* send my block to the leader */
+        shmem_internal_put_nb(SHMEM_CTX_DEFAULT, (char*) target + my_id * len, source,
+                              len, set->local[0], &completion);
+        shmem_internal_put_wait(SHMEM_CTX_DEFAULT, &completion);
+        shmem_internal_fence(SHMEM_CTX_DEFAULT);
+
+        shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync, &one, sizeof(one),
+                              set->local[0], SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+
+        /* wait for the result */
+        SHMEM_WAIT(pSync + 2, 0);
+
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync + 2, &zero, sizeof(zero),
+                                  shmem_internal_my_pe);
+        SHMEM_WAIT_UNTIL(pSync + 2, SHMEM_CMP_EQ, 0);
+        return;
+    }
+
+    memcpy((char*) target + my_id * len, source, len);
+
+    if (set->num_local > 1) {
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, set->num_local - 1);
+
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync, &zero, sizeof(zero),
+                                  shmem_internal_my_pe);
+        SHMEM_WAIT_UNTIL(pSync, SHMEM_CMP_EQ, 0);
+    }
+
+    if (set->num_leaders > 1) {
+        /* send this node's blocks to the other leaders, starting with the
+         * next one so that leaders do not all target the same peer */
+        for (j = 1; j < set->num_leaders; j++) {
+            int peer = set->leaders[(set->my_leader_idx + j) % set->num_leaders];
+
+            for (i = 0; i < set->num_local; ) {
+                int first = (set->local[i] - PE_start) / PE_stride;
+                int n = 1;
+
+                while (i + n < set->num_local &&
+                       (set->local[i + n] - PE_start) / PE_stride == first + n)
+                    n++;
+
+                shmem_internal_put_nb(SHMEM_CTX_DEFAULT, (char*) target + first * len,
+                                      (char*) target + first * len, n * len, peer,
+                                      &completion);
+                i += n;
+            }
+        }
+        shmem_internal_put_wait(SHMEM_CTX_DEFAULT, &completion);
+        shmem_internal_fence(SHMEM_CTX_DEFAULT);
+
+        for (j = 1; j < set->num_leaders; j++) {
+            int peer = set->leaders[(set->my_leader_idx + j) % set->num_leaders];
+            shmem_internal_atomic(SHMEM_CTX_DEFAULT, pSync + 1, &one, sizeof(one),
+                                  peer, SHM_INTERNAL_SUM, SHM_INTERNAL_LONG);
+        }
+
+        SHMEM_WAIT_UNTIL(pSync + 1, SHMEM_CMP_EQ, set->num_leaders - 1);
+
+        shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync + 1, &zero, sizeof(zero),
+                                  shmem_internal_my_pe);
+        SHMEM_WAIT_UNTIL(pSync + 1, SHMEM_CMP_EQ, 0);
+    }
+
+    if (set->num_local > 1) {
+        /* copy the result to the other PEs on the node */
+        for (i = 1; i < set->num_local; i++) {
+            shmem_internal_put_nb(SHMEM_CTX_DEFAULT, target, target, len * PE_size,
+                                  set->local[i], &completion);
+        }
+        shmem_internal_put_wait(SHMEM_CTX_DEFAULT, &completion);
+        shmem_internal_fence(SHMEM_CTX_DEFAULT);
+
+        for (i = 1; i < set->num_local; i++) {
+            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, pSync + 2, &one, sizeof(one),
+                                      set->local[i]);
+        }
+    }
+}
+
+
 void
 shmem_internal_alltoall(void *dest, const void *source, size_t len,
                         int PE_start, int PE_stride, int PE_size, long *pSync)
@@ -1258,12 +2542,11 @@ shmem_internal_alltoalls(void *dest, const void *source, ptrdiff_t dst,
     if (0 == nelems)
         return;
 
-    /* Implementation note: Neither OFI nor Portals presently has support for
-     * noncontiguous data at the target of a one-sided operation.  I'm not sure
-     * of the best communication schedule for the resulting doubly-nested
-     * all-to-all.  It may be preferable in some scenarios to exchange the
-     * loops below to spread out the communication and decrease the exposure to
-     * incast.
+    /* Implementation note: Each peer's elements are sent with a single
+     * strided put, which the OFI transport gathers into vectored writes.  I'm
+     * not sure of the best communication schedule for the all-to-all.  It may
+     * be preferable in some scenarios to interleave the peers to spread out
+     * the communication and decrease the exposure to incast.
      */
 
     /* Send data round-robin, ending with my PE */
@@ -1272,18 +2555,12 @@ shmem_internal_alltoalls(void *dest, const void *source, ptrdiff_t dst,
                                                  PE_size);
     peer = start_pe;
     do {
-        size_t i;
         int peer_as_rank    = (peer - PE_start) / PE_stride; /* Peer's index in active set */
-        uint8_t *dest_ptr   = (uint8_t *) dest_base;
         uint8_t *source_ptr = (uint8_t *) source + peer_as_rank * nelems * sst * elem_size;
 
-        for (i = nelems ; i > 0; i--) {
-            shmem_internal_put_scalar(SHMEM_CTX_DEFAULT, (void *) dest_ptr, (uint8_t *) source_ptr,
-                                     elem_size, peer);
-
-            source_ptr += sst * elem_size;
-            dest_ptr   += dst * elem_size;
-        }
+        shmem_internal_put_strided(SHMEM_CTX_DEFAULT, (void *) dest_base, source_ptr,
+                                   dst * elem_size, sst * elem_size, elem_size,
+                                   nelems, peer);
         peer = shmem_internal_circular_iter_next(peer, PE_start, PE_stride,
                                                  PE_size);
     } while (peer != start_pe);
@@ -403,7 +403,7 @@ shmem_internal_init(int tl_requested, int *tl_provided)
     }
     shr_initialized = 1;
 
-    ret = shmem_internal_collectives_init();
+    ret = shmem_internal_collectives_init(enable_node_ranks);
     if (ret != 0) {
         RETURN_ERROR_MSG("Initialization of collectives failed (%d)\n", ret);
         goto cleanup;
@@ -37,6 +37,9 @@
 #pragma weak shmemx_pcntr_get_all = pshmemx_pcntr_get_all
 #define shmemx_pcntr_get_all pshmemx_pcntr_get_all
 
+#pragma weak shmemx_pcntr_get_cq_batch = pshmemx_pcntr_get_cq_batch
+#define shmemx_pcntr_get_cq_batch pshmemx_pcntr_get_cq_batch
+
 #endif /* ENABLE_PROFILING */
 
 void SHMEM_FUNCTION_ATTRIBUTES 
@@ -87,3 +90,10 @@ shmemx_pcntr_get_all(shmem_ctx_t ctx, shmemx_pcntr_t *pcntr)
     return;
 }
 
+void SHMEM_FUNCTION_ATTRIBUTES
+shmemx_pcntr_get_cq_batch(shmem_ctx_t ctx, double *avg_batch)
+{
+    SHMEM_ERR_CHECK_INITIALIZED();
+    *avg_batch = shmem_transport_pcntr_get_cq_batch((shmem_transport_ctx_t *) ctx);
+    return;
+}
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <mpi.h>
 
 #include "runtime.h"
@@ -38,6 +39,7 @@ static int kv_length = 0;
 static int initialized_mpi = 0;
 static int node_size;
 static int *node_ranks;
+static int node_exchange = 0;
 
 char* kv_store_me;
 char* kv_store_all;
@@ -100,6 +102,28 @@ shmem_runtime_init(int enable_node_ranks)
     kv_store_me = (char*)malloc(MAX_KV_COUNT * sizeof(char)* MAX_KV_LENGTH);
     if (NULL == kv_store_me) return 8;
 
+    if (size > 1 && shmem_internal_params.RUNTIME_NODE_EXCHANGE) {
+        /* MPI does not name the job, so use rank 0's host and process ID */
+        char job_id[MPI_MAX_PROCESSOR_NAME + 32];
+        MPI_Comm shared;
+        int len, local_size;
+
+        if (rank == 0) {
+            MPI_Get_processor_name(job_id, &len);
+            snprintf(job_id + len, sizeof(job_id) - len, "-%ld", (long) getpid());
+        }
+        MPI_Bcast(job_id, sizeof(job_id), MPI_CHAR, 0, SHMEM_RUNTIME_WORLD);
+
+        MPI_Comm_split_type(SHMEM_RUNTIME_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &shared);
+        MPI_Comm_size(shared, &local_size);
+        MPI_Comm_free(&shared);
+
+        if (0 == shmem_runtime_util_node_init(job_id, rank, size, local_size))
+            node_exchange = 1;
+        else
+            RAISE_WARN_STR("Node-aggregated KVS exchange unavailable, using MPI_Allgather");
+    }
+
     if (size > 1 && enable_node_ranks) {
         node_ranks = malloc(size * sizeof(int));
         if (NULL == node_ranks) return 8;
@@ -114,6 +138,10 @@ shmem_runtime_fini(void)
     int ret = MPI_SUCCESS;
     int finalized = 0;
 
+    if (node_exchange) {
+        shmem_runtime_util_node_fini();
+    }
+
     if (node_ranks) {
         MPI_Comm_free(&SHMEM_RUNTIME_SHARED);
         free(node_ranks);
@@ -202,6 +230,53 @@ shmem_runtime_get_node_size(void)
     return node_size;
 }
 
+static int
+node_fence(void)
+{
+    return MPI_SUCCESS != MPI_Barrier(SHMEM_RUNTIME_WORLD);
+}
+
+/* Node leaders exchange their blobs over a communicator of their own */
+static int
+node_leader_allgather(const void *blob, size_t len, void **all, size_t *all_len)
+{
+    MPI_Comm leaders;
+    int nleaders, i, mylen = (int) len, total = 0;
+    int *lens, *displs;
+
+    MPI_Comm_split(SHMEM_RUNTIME_WORLD, blob ? 0 : MPI_UNDEFINED, rank, &leaders);
+
+    if (NULL == blob) {
+        return 0;
+    }
+
+    MPI_Comm_size(leaders, &nleaders);
+    lens = malloc(2 * nleaders * sizeof(int));
+    if (NULL == lens) return 1;
+    displs = lens + nleaders;
+
+    MPI_Allgather(&mylen, 1, MPI_INT, lens, 1, MPI_INT, leaders);
+
+    for (i = 0; i < nleaders; i++) {
+        displs[i] = total;
+        total += lens[i];
+    }
+
+    *all = malloc(total);
+    if (NULL == *all) {
+        free(lens);
+        return 1;
+    }
+
+    MPI_Allgatherv(blob, mylen, MPI_BYTE, *all, lens, displs, MPI_BYTE, leaders);
+    *all_len = total;
+
+    free(lens);
+    MPI_Comm_free(&leaders);
+
+    return 0;
+}
+
 int
 shmem_runtime_exchange(void)
 {
@@ -233,6 +308,18 @@ shmem_runtime_exchange(void)
         free(world_ranks);
     }
 
+    if (node_exchange) {
+        struct shmem_runtime_util_node_ops ops = {
+            .put = NULL,
+            .get = NULL,
+            .max_valuelen = 0,
+            .fence = node_fence,
+            .leader_allgather = node_leader_allgather
+        };
+
+        return shmem_runtime_util_node_exchange(&ops);
+    }
+
     int chunkSize = kv_length * sizeof(char) * MAX_KV_LENGTH;
 
     kv_store_all = (char*)malloc(chunkSize * size);
@@ -250,6 +337,9 @@ shmem_runtime_exchange(void)
 int
 shmem_runtime_put(char *key, void *value, size_t valuelen)
 {
+    if (node_exchange)
+        return shmem_runtime_util_node_put(key, value, valuelen);
+
     if (kv_length < MAX_KV_COUNT && valuelen < MAX_KV_LENGTH) {
         memcpy(kv_index(kv_store_me, kv_length), key, MAX_KV_LENGTH);
         kv_length++;
@@ -266,6 +356,9 @@ shmem_runtime_put(char *key, void *value, size_t valuelen)
 int
 shmem_runtime_get(int pe, char *key, void *value, size_t valuelen)
 {
+    if (node_exchange)
+        return shmem_runtime_util_node_get(pe, key, value, valuelen);
+
     int flag = 0;
     for (int i = pe * kv_length; i < kv_length * size; i+= 2) {
         if (strcmp(kv_index(kv_store_all, i), key) == 0) {
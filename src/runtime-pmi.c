@@ -38,6 +38,7 @@ static char *kvs_name, *kvs_key, *kvs_value;
 static int max_name_len, max_key_len, max_val_len;
 static int initialized_pmi = 0;
 static int *location_array = NULL;
+static int node_exchange = 0;
 
 #define SINGLETON_KEY_LEN 128
 #define SINGLETON_VAL_LEN 1024
@@ -93,6 +94,18 @@ shmem_runtime_init(int enable_node_ranks)
             return 9;
         }
 
+        if (shmem_internal_params.RUNTIME_NODE_EXCHANGE) {
+            int local_size = 0;
+
+            if (PMI_SUCCESS != PMI_Get_clique_size(&local_size))
+                local_size = 0;
+
+            if (0 == shmem_runtime_util_node_init(kvs_name, rank, size, local_size))
+                node_exchange = 1;
+            else
+                RAISE_WARN_STR("Node-aggregated KVS exchange unavailable, using per-PE keys");
+        }
+
         if (enable_node_ranks) {
             location_array = malloc(sizeof(int) * size);
             if (NULL == location_array) return 10;
@@ -119,6 +132,10 @@ shmem_runtime_init(int enable_node_ranks)
 int
 shmem_runtime_fini(void)
 {
+    if (node_exchange) {
+        shmem_runtime_util_node_fini();
+    }
+
     free(location_array);
     free(kvs_name);
     free(kvs_key);
@@ -194,45 +211,8 @@ shmem_runtime_get_node_size(void)
 }
 
 
-int
-shmem_runtime_exchange(void)
-{
-    int ret;
-
-    /* Use singleton KVS for single process jobs */
-    if (size == 1)
-        return 0;
-
-    if (location_array) {
-        ret = shmem_runtime_util_put_hostname();
-        if (ret != 0) {
-            RETURN_ERROR_MSG("KVS hostname put (%d)", ret);
-            return 4;
-        }
-    }
-
-    if (PMI_SUCCESS != PMI_KVS_Commit(kvs_name)) {
-        return 5;
-    }
-
-    if (PMI_SUCCESS != PMI_Barrier()) {
-        return 6;
-    }
-
-    if (location_array) {
-        ret = shmem_runtime_util_populate_node(location_array, size, &node_size);
-        if (0 != ret) {
-            RETURN_ERROR_MSG("Node PE mapping failed (%d)\n", ret);
-            return 7;
-        }
-    }
-
-    return 0;
-}
-
-
-int
-shmem_runtime_put(char *key, void *value, size_t valuelen)
+static int
+kvs_put(char *key, void *value, size_t valuelen)
 {
     snprintf(kvs_key, max_key_len, "shmem-%lu-%s", (long unsigned) rank, key);
     if (0 != shmem_runtime_util_encode(value, valuelen, kvs_value,
@@ -258,8 +238,8 @@ shmem_runtime_put(char *key, void *value, size_t valuelen)
 }
 
 
-int
-shmem_runtime_get(int pe, char *key, void *value, size_t valuelen)
+static int
+kvs_get(int pe, char *key, void *value, size_t valuelen)
 {
     snprintf(kvs_key, max_key_len, "shmem-%lu-%s", (long unsigned) pe, key);
     if (size == 1) {
@@ -282,6 +262,101 @@ shmem_runtime_get(int pe, char *key, void *value, size_t valuelen)
 }
 
 
+static int
+kvs_fence(void)
+{
+    if (PMI_SUCCESS != PMI_KVS_Commit(kvs_name)) {
+        return 5;
+    }
+
+    if (PMI_SUCCESS != PMI_Barrier()) {
+        return 6;
+    }
+
+    return 0;
+}
+
+
+int
+shmem_runtime_exchange(void)
+{
+    int ret;
+
+    /* Use singleton KVS for single process jobs */
+    if (size == 1)
+        return 0;
+
+    if (node_exchange) {
+        struct shmem_runtime_util_node_ops ops = {
+            .put = kvs_put,
+            .get = kvs_get,
+            .max_valuelen = (max_val_len - 1) / 4 * 3,
+            .fence = kvs_fence,
+            .leader_allgather = NULL
+        };
+
+        ret = shmem_runtime_util_node_exchange(&ops);
+        if (ret != 0) {
+            RETURN_ERROR_MSG("Node-aggregated KVS exchange failed (%d)\n", ret);
+            return 8;
+        }
+
+        if (location_array) {
+            ret = shmem_runtime_util_node_populate(location_array, &node_size);
+            if (0 != ret) {
+                RETURN_ERROR_MSG("Node PE mapping failed (%d)\n", ret);
+                return 7;
+            }
+        }
+
+        return 0;
+    }
+
+    if (location_array) {
+        ret = shmem_runtime_util_put_hostname();
+        if (ret != 0) {
+            RETURN_ERROR_MSG("KVS hostname put (%d)", ret);
+            return 4;
+        }
+    }
+
+    ret = kvs_fence();
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (location_array) {
+        ret = shmem_runtime_util_populate_node(location_array, size, &node_size);
+        if (0 != ret) {
+            RETURN_ERROR_MSG("Node PE mapping failed (%d)\n", ret);
+            return 7;
+        }
+    }
+
+    return 0;
+}
+
+
+int
+shmem_runtime_put(char *key, void *value, size_t valuelen)
+{
+    if (node_exchange)
+        return shmem_runtime_util_node_put(key, value, valuelen);
+
+    return kvs_put(key, value, valuelen);
+}
+
+
+int
+shmem_runtime_get(int pe, char *key, void *value, size_t valuelen)
+{
+    if (node_exchange)
+        return shmem_runtime_util_node_get(pe, key, value, valuelen);
+
+    return kvs_get(pe, key, value, valuelen);
+}
+
+
 void
 shmem_runtime_barrier(void)
 {
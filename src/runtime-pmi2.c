@@ -42,6 +42,79 @@ static char *kvs_name, *kvs_key, *kvs_value;
 static int max_name_len, max_key_len, max_val_len;
 static int initialized_pmi = 0;
 static int *location_array = NULL;
+static int node_exchange = 0;
+
+
+/* Read the next (start node, node count, PEs per node) block of a PMI process
+ * mapping vector */
+static int
+node_map_next(const char **pos, int *start, int *nnodes, int *ppn)
+{
+    const char *p = strchr(*pos, '(');
+
+    if (NULL == p || 3 != sscanf(p, "(%d,%d,%d)", start, nnodes, ppn))
+        return 0;
+
+    *pos = p + 1;
+    return 1;
+}
+
+
+/* Walk the mapping, whose blocks repeat until every rank is placed.  Returns
+ * the node of this PE when node is negative, otherwise the number of PEs on
+ * node, or -1 if the mapping cannot be parsed. */
+static int
+node_map_walk(const char *vec, int node)
+{
+    const char *pos;
+    int start, nnodes, ppn, i, n, r = 0, count = 0;
+
+    while (r < size) {
+        int placed = r;
+
+        pos = vec;
+        while (r < size && node_map_next(&pos, &start, &nnodes, &ppn)) {
+            if (nnodes <= 0 || ppn <= 0) return -1;
+
+            for (i = 0; i < nnodes && r < size; i++) {
+                n = (ppn < size - r) ? ppn : size - r;
+                if (node < 0 && rank >= r && rank < r + n)
+                    return start + i;
+                if (start + i == node)
+                    count += n;
+                r += n;
+            }
+        }
+
+        if (r == placed) return -1;
+    }
+
+    return (node < 0) ? -1 : count;
+}
+
+
+/* Number of PEs on this PE's node, from the process mapping published by the
+ * PMI2 server, or 0 if it is not available */
+static int
+node_local_size(void)
+{
+    char map[PMI2_MAX_VALLEN];
+    const char *vec;
+    int found = 0, node;
+
+    if (PMI2_SUCCESS != PMI2_Info_GetJobAttr("PMI_process_mapping", map,
+                                             sizeof(map), &found) || !found)
+        return 0;
+
+    vec = strstr(map, "vector,");
+    if (NULL == vec) return 0;
+    vec += strlen("vector,");
+
+    node = node_map_walk(vec, -1);
+    if (node < 0) return 0;
+
+    return node_map_walk(vec, node);
+}
 
 
 int
@@ -74,6 +147,13 @@ shmem_runtime_init(int enable_node_ranks)
         return 7;
     }
 
+    if (shmem_internal_params.RUNTIME_NODE_EXCHANGE && size > 1) {
+        if (0 == shmem_runtime_util_node_init(kvs_name, rank, size, node_local_size()))
+            node_exchange = 1;
+        else
+            RAISE_WARN_STR("Node-aggregated KVS exchange unavailable, using per-PE keys");
+    }
+
     if (enable_node_ranks) {
         location_array = malloc(sizeof(int) * size);
         if (NULL == location_array) return 8;
@@ -86,6 +166,10 @@ shmem_runtime_init(int enable_node_ranks)
 int
 shmem_runtime_fini(void)
 {
+    if (node_exchange) {
+        shmem_runtime_util_node_fini();
+    }
+
     if (location_array) {
         free(location_array);
     }
@@ -145,11 +229,82 @@ shmem_runtime_get_node_size(void)
 }
 
 
+static int
+kvs_put(char *key, void *value, size_t valuelen)
+{
+    snprintf(kvs_key, max_key_len, "shmem-%lu-%s", (long unsigned) rank, key);
+    if (0 != shmem_runtime_util_encode(value, valuelen, kvs_value,
+                                       max_val_len)) {
+        return 1;
+    }
+    if (PMI2_SUCCESS != PMI2_KVS_Put(kvs_key, kvs_value)) {
+        return 2;
+    }
+
+    return 0;
+}
+
+
+static int
+kvs_get(int pe, char *key, void *value, size_t valuelen)
+{
+    int len;
+
+    snprintf(kvs_key, max_key_len, "shmem-%lu-%s", (long unsigned) pe, key);
+    if (PMI2_SUCCESS != PMI2_KVS_Get(kvs_name, PMI2_ID_NULL,
+                                     kvs_key, kvs_value, max_val_len, &len)) {
+        return 1;
+    }
+    if (0 != shmem_runtime_util_decode(kvs_value, value, valuelen)) {
+        return 2;
+    }
+
+    return 0;
+}
+
+
+static int
+kvs_fence(void)
+{
+    if (PMI2_SUCCESS != PMI2_KVS_Fence()) {
+        return 5;
+    }
+
+    return 0;
+}
+
+
 int
 shmem_runtime_exchange(void)
 {
     int ret;
 
+    if (node_exchange) {
+        struct shmem_runtime_util_node_ops ops = {
+            .put = kvs_put,
+            .get = kvs_get,
+            .max_valuelen = (max_val_len - 1) / 4 * 3,
+            .fence = kvs_fence,
+            .leader_allgather = NULL
+        };
+
+        ret = shmem_runtime_util_node_exchange(&ops);
+        if (ret != 0) {
+            RETURN_ERROR_MSG("Node-aggregated KVS exchange failed (%d)\n", ret);
+            return 8;
+        }
+
+        if (location_array) {
+            ret = shmem_runtime_util_node_populate(location_array, &node_size);
+            if (0 != ret) {
+                RETURN_ERROR_MSG("Node PE mapping failed (%d)\n", ret);
+                return 7;
+            }
+        }
+
+        return 0;
+    }
+
     if (location_array) {
         ret = shmem_runtime_util_put_hostname();
         if (ret != 0) {
@@ -158,8 +313,9 @@ shmem_runtime_exchange(void)
         }
     }
 
-    if (PMI2_SUCCESS != PMI2_KVS_Fence()) {
-        return 5;
+    ret = kvs_fence();
+    if (ret != 0) {
+        return ret;
     }
 
     if (location_array) {
@@ -177,33 +333,19 @@ shmem_runtime_exchange(void)
 int
 shmem_runtime_put(char *key, void *value, size_t valuelen)
 {
-    snprintf(kvs_key, max_key_len, "shmem-%lu-%s", (long unsigned) rank, key);
-    if (0 != shmem_runtime_util_encode(value, valuelen, kvs_value,
-                                       max_val_len)) {
-        return 1;
-    }
-    if (PMI2_SUCCESS != PMI2_KVS_Put(kvs_key, kvs_value)) {
-        return 2;
-    }
+    if (node_exchange)
+        return shmem_runtime_util_node_put(key, value, valuelen);
 
-    return 0;
+    return kvs_put(key, value, valuelen);
 }
 
 int
 shmem_runtime_get(int pe, char *key, void *value, size_t valuelen)
 {
-    int len;
+    if (node_exchange)
+        return shmem_runtime_util_node_get(pe, key, value, valuelen);
 
-    snprintf(kvs_key, max_key_len, "shmem-%lu-%s", (long unsigned) pe, key);
-    if (PMI2_SUCCESS != PMI2_KVS_Get(kvs_name, PMI2_ID_NULL,
-                                     kvs_key, kvs_value, max_val_len, &len)) {
-        return 1;
-    }
-    if (0 != shmem_runtime_util_decode(kvs_value, value, valuelen)) {
-        return 2;
-    }
-
-    return 0;
+    return kvs_get(pe, key, value, valuelen);
 }
 
 
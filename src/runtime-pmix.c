@@ -37,6 +37,7 @@ static pmix_proc_t myproc;
 static uint32_t size;
 static uint32_t node_size = 0;
 static int *node_ranks = NULL;
+static int node_exchange = 0;
 
 int
 shmem_runtime_init(int enable_node_ranks)
@@ -63,6 +64,21 @@ shmem_runtime_init(int enable_node_ranks)
         return rc;
     }
 
+    if (shmem_internal_params.RUNTIME_NODE_EXCHANGE && size > 1) {
+        uint32_t local_size = 0;
+
+        if (PMIX_SUCCESS == PMIx_Get(&proc, PMIX_LOCAL_SIZE, NULL, 0, &val)) {
+            local_size = val->data.uint32;
+            PMIX_VALUE_RELEASE(val);
+        }
+
+        if (0 == shmem_runtime_util_node_init(myproc.nspace, (int) myproc.rank, (int) size,
+                                              (int) local_size))
+            node_exchange = 1;
+        else
+            RAISE_WARN_STR("Node-aggregated KVS exchange unavailable, using per-PE keys");
+    }
+
     if (enable_node_ranks) {
         node_ranks = (int *)malloc(size * sizeof(int));
         if (NULL == node_ranks) {
@@ -80,6 +96,9 @@ shmem_runtime_fini(void)
 {
     pmix_status_t rc;
 
+    if (node_exchange)
+        shmem_runtime_util_node_fini();
+
     if (node_ranks)
         free(node_ranks);
 
@@ -143,6 +162,28 @@ shmem_runtime_get_node_size(void)
     return (int) node_size;
 }
 
+static int kvs_put(char *key, void *value, size_t valuelen);
+static int kvs_get(int pe, char *key, void *value, size_t valuelen);
+
+/* Data is fetched on demand by the node leaders, so the fence does not
+ * collect it */
+static int
+kvs_fence(void)
+{
+    pmix_status_t rc;
+
+    if (PMIX_SUCCESS != (rc = PMIx_Commit())) {
+        RETURN_ERROR_MSG("PMIx_Commit failed (%d)\n", rc);
+        return rc;
+    }
+
+    if (PMIX_SUCCESS != (rc = PMIx_Fence(NULL, 0, NULL, 0))) {
+        RETURN_ERROR_MSG("PMIx_Fence failed (%d)\n", rc);
+    }
+
+    return rc;
+}
+
 // static void opcbfunc(pmix_status_t status, void *cbdata)
 // {
 //     bool *active = (bool*)cbdata;
@@ -200,6 +241,18 @@ shmem_runtime_exchange(void)
         }
     }
 
+    if (node_exchange) {
+        struct shmem_runtime_util_node_ops ops = {
+            .put = kvs_put,
+            .get = kvs_get,
+            .max_valuelen = SIZE_MAX,
+            .fence = kvs_fence,
+            .leader_allgather = NULL
+        };
+
+        return shmem_runtime_util_node_exchange(&ops);
+    }
+
     /* commit any values we "put" */
     if (PMIX_SUCCESS != (rc = PMIx_Commit())) {
         RETURN_ERROR_MSG("PMIx_Commit failed (%d)\n", rc);
@@ -225,8 +278,8 @@ shmem_runtime_exchange(void)
 }
 
 
-int
-shmem_runtime_put(char *key, void *value, size_t valuelen)
+static int
+kvs_put(char *key, void *value, size_t valuelen)
 {
     pmix_value_t val;
     pmix_status_t rc;
@@ -245,8 +298,8 @@ shmem_runtime_put(char *key, void *value, size_t valuelen)
 }
 
 /* I'm assuming you malloc'd a region and are giving me its length */
-int
-shmem_runtime_get(int pe, char *key, void *value, size_t valuelen)
+static int
+kvs_get(int pe, char *key, void *value, size_t valuelen)
 {
     pmix_proc_t proc;
     pmix_value_t *val;
@@ -280,6 +333,26 @@ shmem_runtime_get(int pe, char *key, void *value, size_t valuelen)
 }
 
 
+int
+shmem_runtime_put(char *key, void *value, size_t valuelen)
+{
+    if (node_exchange)
+        return shmem_runtime_util_node_put(key, value, valuelen);
+
+    return kvs_put(key, value, valuelen);
+}
+
+
+int
+shmem_runtime_get(int pe, char *key, void *value, size_t valuelen)
+{
+    if (node_exchange)
+        return shmem_runtime_util_node_get(pe, key, value, valuelen);
+
+    return kvs_get(pe, key, value, valuelen);
+}
+
+
 void
 shmem_runtime_barrier(void)
 {
@@ -44,4 +44,27 @@ int shmem_runtime_util_populate_node(int *location_array, int size, int *node_si
 
 int shmem_runtime_util_encode(const void *inval, int invallen, char *outval, int outvallen);
 int shmem_runtime_util_decode(const char *inval, void *outval, size_t outvallen);
+
+/* Node-aggregated exchange (SHMEM_RUNTIME_NODE_EXCHANGE).  Backends buffer
+ * puts with shmem_runtime_util_node_put and serve gets from the node's shared
+ * memory segment.  Node leaders exchange their blobs with leader_allgather
+ * when the backend provides it, and through put/get otherwise. */
+struct shmem_runtime_util_node_ops {
+    /* Publish under the caller's rank; get must return exactly valuelen */
+    int (*put)(char *key, void *value, size_t valuelen);
+    int (*get)(int pe, char *key, void *value, size_t valuelen);
+    size_t max_valuelen;
+    /* Commit outstanding puts and synchronize all PEs */
+    int (*fence)(void);
+    /* Collective over all PEs; non-leaders pass a NULL blob */
+    int (*leader_allgather)(const void *blob, size_t len, void **all, size_t *all_len);
+};
+
+/* local_size is the number of PEs on the calling PE's node */
+int shmem_runtime_util_node_init(const char *job_id, int rank, int size, int local_size);
+int shmem_runtime_util_node_put(const char *key, const void *value, size_t valuelen);
+int shmem_runtime_util_node_get(int pe, const char *key, void *value, size_t valuelen);
+int shmem_runtime_util_node_exchange(const struct shmem_runtime_util_node_ops *ops);
+int shmem_runtime_util_node_populate(int *location_array, int *node_size);
+void shmem_runtime_util_node_fini(void);
 #endif
@@ -13,12 +13,21 @@
  *
  */
 
+#include "config.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <limits.h>
+#include <stdint.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef HAVE_SHM_OPEN
+#include <sys/mman.h>
+#endif
 
 #include "shmem_internal.h"
 #include "runtime.h"
@@ -30,25 +39,51 @@
 #endif
 
 
+/* Values are encoded four characters per three bytes, without padding, using
+ * an alphabet that is safe in the PMI wire protocols (no '=', ';' or space) */
+static const char encodings[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+#define ENCODED_LEN(len) (((len) * 4 + 2) / 3)
+
+static inline int
+decode_char(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-') return 62;
+    if (c == '_') return 63;
+    return -1;
+}
+
+
 int
 shmem_runtime_util_encode(const void *inval, int invallen, char *outval,
                           int outvallen)
 {
-    static unsigned char encodings[] = {
-        '0','1','2','3','4','5','6','7', \
-        '8','9','a','b','c','d','e','f' };
-    int i;
+    const unsigned char *in = (const unsigned char *) inval;
+    uint32_t bits = 0;
+    int i, nbits = 0, j = 0;
 
-    if (invallen * 2 + 1 > outvallen) {
+    if (ENCODED_LEN(invallen) + 1 > outvallen) {
         return 1;
     }
 
     for (i = 0; i < invallen; i++) {
-        outval[2 * i] = encodings[((unsigned char *)inval)[i] & 0xf];
-        outval[2 * i + 1] = encodings[((unsigned char *)inval)[i] >> 4];
+        bits = (bits << 8) | in[i];
+        nbits += 8;
+        while (nbits >= 6) {
+            nbits -= 6;
+            outval[j++] = encodings[(bits >> nbits) & 0x3f];
+        }
     }
 
-    outval[invallen * 2] = '\0';
+    if (nbits > 0) {
+        outval[j++] = encodings[(bits << (6 - nbits)) & 0x3f];
+    }
+
+    outval[j] = '\0';
 
     return 0;
 }
@@ -57,26 +92,28 @@ shmem_runtime_util_encode(const void *inval, int invallen, char *outval,
 int
 shmem_runtime_util_decode(const char *inval, void *outval, size_t outvallen)
 {
-    size_t i;
-    char *ret = (char*) outval;
+    unsigned char *ret = (unsigned char*) outval;
+    uint32_t bits = 0;
+    size_t i = 0;
+    int nbits = 0;
 
-    if (outvallen != strlen(inval) / 2) {
+    if (ENCODED_LEN(outvallen) != strlen(inval)) {
         return 1;
     }
 
-    for (i = 0 ; i < outvallen ; ++i) {
-        if (*inval >= '0' && *inval <= '9') {
-            ret[i] = *inval - '0';
-        } else {
-            ret[i] = *inval - 'a' + 10;
+    for ( ; *inval != '\0' ; inval++) {
+        int c = decode_char(*inval);
+
+        if (c < 0) {
+            return 1;
         }
-        inval++;
-        if (*inval >= '0' && *inval <= '9') {
-            ret[i] |= ((*inval - '0') << 4);
-        } else {
-            ret[i] |= ((*inval - 'a' + 10) << 4);
+
+        bits = (bits << 6) | c;
+        nbits += 6;
+        if (nbits >= 8) {
+            nbits -= 8;
+            ret[i++] = (bits >> nbits) & 0xff;
         }
-        inval++;
     }
 
     return 0;
@@ -164,3 +201,509 @@ int shmem_runtime_util_populate_node(int *location_array, int size, int *node_si
 
     return 0;
 }
+
+
+/* Node-aggregated KVS exchange.
+ *
+ * Key/value pairs are buffered in a per-PE record instead of being published
+ * individually.  At exchange time the PEs on a node copy their records into a
+ * registration segment in shared memory, the lowest ranked of them (the node
+ * leader) packs the records into a blob, and the leaders swap blobs, either
+ * through the backend's KVS or a backend collective.  Each leader then writes
+ * the records of every PE into a data segment that all PEs on its node map,
+ * and gets are served from that segment.  A PE therefore performs O(nodes)
+ * KVS operations at most, rather than O(PEs) per key. */
+
+#define NODE_REG_SLOT_SIZE 8192
+
+typedef struct {
+    int count;          /* PEs registered on this node */
+    int ready;          /* Data segment has been created by the leader */
+    int mapped;         /* Non-leader PEs that have mapped the data segment */
+    int pad;
+    size_t data_len;
+} node_reg_hdr_t;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t len;
+} node_index_t;
+
+/* Record entry and blob entry headers, followed by the key (including
+ * its terminator) and the value, or by the record itself */
+typedef struct {
+    uint32_t keylen;
+    uint32_t vallen;
+} node_entry_t;
+
+typedef struct {
+    uint32_t rank;
+    uint32_t len;
+} node_blob_entry_t;
+
+static int node_rank = -1, node_npes = 0, node_reg_npes = 0;
+static char node_reg_name[NAME_MAX], node_data_name[NAME_MAX];
+static char *node_rec = NULL;
+static size_t node_rec_len = 0, node_rec_size = 0;
+static char *node_data = NULL;
+static size_t node_data_len = 0;
+static int *node_local_ranks = NULL;
+static int node_nlocal = 0;
+
+
+static int
+node_cmp_int(const void *a, const void *b)
+{
+    return *(const int *) a - *(const int *) b;
+}
+
+
+int
+shmem_runtime_util_node_init(const char *job_id, int rank, int size, int local_size)
+{
+#ifdef HAVE_SHM_OPEN
+    uint64_t hash = 14695981039346656037ULL;
+    const char *c;
+
+    if (local_size <= 0 || local_size > size) {
+        RETURN_ERROR_MSG("Invalid number of PEs on this node (%d)\n", local_size);
+        return 1;
+    }
+
+    /* Segment names only need to be unique among the jobs sharing a node */
+    for (c = job_id; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    }
+
+    snprintf(node_reg_name, NAME_MAX, "/shmem-kvs-%d-%016llx-reg",
+             (int) getuid(), (unsigned long long) hash);
+    snprintf(node_data_name, NAME_MAX, "/shmem-kvs-%d-%016llx-data",
+             (int) getuid(), (unsigned long long) hash);
+
+    node_rank = rank;
+    node_npes = size;
+    node_reg_npes = local_size;
+
+    return 0;
+#else
+    RETURN_ERROR_STR("Node-aggregated exchange requires shm_open");
+    return 1;
+#endif
+}
+
+
+int
+shmem_runtime_util_node_put(const char *key, const void *value, size_t valuelen)
+{
+    node_entry_t entry;
+    size_t need;
+
+    entry.keylen = strlen(key) + 1;
+    entry.vallen = valuelen;
+    need = node_rec_len + sizeof(entry) + entry.keylen + entry.vallen;
+
+    if (need > NODE_REG_SLOT_SIZE) {
+        RETURN_ERROR_MSG("KVS record exceeds %d bytes storing key '%s'\n",
+                         NODE_REG_SLOT_SIZE, key);
+        return 1;
+    }
+
+    if (need > node_rec_size) {
+        char *rec = realloc(node_rec, NODE_REG_SLOT_SIZE);
+        if (NULL == rec) return 2;
+        node_rec = rec;
+        node_rec_size = NODE_REG_SLOT_SIZE;
+    }
+
+    memcpy(node_rec + node_rec_len, &entry, sizeof(entry));
+    memcpy(node_rec + node_rec_len + sizeof(entry), key, entry.keylen);
+    memcpy(node_rec + node_rec_len + sizeof(entry) + entry.keylen, value, valuelen);
+    node_rec_len = need;
+
+    return 0;
+}
+
+
+int
+shmem_runtime_util_node_get(int pe, const char *key, void *value, size_t valuelen)
+{
+    node_index_t *index = (node_index_t *) node_data;
+    char *rec, *end;
+
+    if (NULL == node_data || pe < 0 || pe >= node_npes || 0 == index[pe].len) {
+        return 1;
+    }
+
+    rec = node_data + index[pe].offset;
+    end = rec + index[pe].len;
+
+    while (rec + sizeof(node_entry_t) <= end) {
+        node_entry_t entry;
+
+        memcpy(&entry, rec, sizeof(entry));
+        rec += sizeof(entry);
+
+        if (0 == strcmp(rec, key)) {
+            if (entry.vallen > valuelen) return 2;
+            memcpy(value, rec + entry.keylen, entry.vallen);
+            return 0;
+        }
+
+        rec += entry.keylen + entry.vallen;
+    }
+
+    return 3;
+}
+
+
+#ifdef HAVE_SHM_OPEN
+static void *
+node_segment_map(const char *name, size_t len, int create)
+{
+    void *seg;
+    int fd;
+
+    fd = shm_open(name, O_RDWR | (create ? O_CREAT : 0), S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        RETURN_ERROR_MSG("shm_open of '%s' failed (%s)\n", name, strerror(errno));
+        return NULL;
+    }
+
+    /* Every PE sizes the segment identically, so concurrent calls are benign */
+    if (create && 0 != ftruncate(fd, len)) {
+        RETURN_ERROR_MSG("ftruncate of '%s' failed (%s)\n", name, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    seg = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (MAP_FAILED == seg) {
+        RETURN_ERROR_MSG("mmap of '%s' failed (%s)\n", name, strerror(errno));
+        return NULL;
+    }
+
+    return seg;
+}
+
+
+/* Fetch the blobs of all other nodes through the backend KVS.  Each PE
+ * publishes its leader's rank, so a leader needs one lookup per node to find
+ * the next blob and skips the ranks that blob covers. */
+static int
+node_kvs_allgather(const struct shmem_runtime_util_node_ops *ops, int leader,
+                   const void *blob, size_t len, char **all, size_t *all_len)
+{
+    size_t off, chunk, max = ops->max_valuelen;
+    char key[64];
+    char *known = NULL, *buf = NULL;
+    size_t buf_len = 0;
+    int ret = 0, i;
+
+    ret = ops->put("node-leader", &leader, sizeof(int));
+    if (ret) {
+        RETURN_ERROR_MSG("KVS node leader put failed (%d)\n", ret);
+        return ret;
+    }
+
+    if (blob) {
+        ret = ops->put("node-blob-len", &len, sizeof(size_t));
+        for (off = 0, i = 0; 0 == ret && off < len; off += chunk, i++) {
+            chunk = (len - off < max) ? len - off : max;
+            snprintf(key, sizeof(key), "node-blob-%d", i);
+            ret = ops->put(key, (char *) blob + off, chunk);
+        }
+        if (ret) {
+            RETURN_ERROR_MSG("KVS node blob put failed (%d)\n", ret);
+            return ret;
+        }
+    }
+
+    ret = ops->fence();
+    if (ret) {
+        RETURN_ERROR_MSG("KVS fence failed (%d)\n", ret);
+        return ret;
+    }
+
+    if (NULL == blob) return 0;
+
+    known = calloc(node_npes, 1);
+    buf = malloc(len);
+    if (NULL == known || NULL == buf) {
+        ret = 1;
+        goto out;
+    }
+
+    memcpy(buf, blob, len);
+    buf_len = len;
+    for (i = 0; i < node_nlocal; i++)
+        known[node_local_ranks[i]] = 1;
+
+    for (i = 0; i < node_npes; i++) {
+        int peer_leader, c;
+        size_t peer_len;
+        char *tmp;
+
+        if (known[i]) continue;
+
+        ret = ops->get(i, "node-leader", &peer_leader, sizeof(int));
+        if (0 == ret)
+            ret = ops->get(peer_leader, "node-blob-len", &peer_len, sizeof(size_t));
+        if (ret) {
+            RETURN_ERROR_MSG("KVS node blob lookup for PE %d failed (%d)\n", i, ret);
+            goto out;
+        }
+
+        tmp = realloc(buf, buf_len + peer_len);
+        if (NULL == tmp) {
+            ret = 1;
+            goto out;
+        }
+        buf = tmp;
+
+        for (c = 0, off = 0; off < peer_len; c++, off += chunk) {
+            chunk = (peer_len - off < max) ? peer_len - off : max;
+            snprintf(key, sizeof(key), "node-blob-%d", c);
+            ret = ops->get(peer_leader, key, buf + buf_len + off, chunk);
+            if (ret) {
+                RETURN_ERROR_MSG("KVS node blob get from PE %d failed (%d)\n",
+                                 peer_leader, ret);
+                goto out;
+            }
+        }
+
+        for (off = 0; off + sizeof(node_blob_entry_t) <= peer_len; ) {
+            node_blob_entry_t entry;
+            memcpy(&entry, buf + buf_len + off, sizeof(entry));
+            if (entry.rank >= (uint32_t) node_npes) {
+                RETURN_ERROR_MSG("Invalid PE %u in node blob from PE %d\n",
+                                 entry.rank, peer_leader);
+                ret = 1;
+                goto out;
+            }
+            known[entry.rank] = 1;
+            off += sizeof(entry) + entry.len;
+        }
+        buf_len += peer_len;
+
+        if (!known[i]) {
+            RETURN_ERROR_MSG("Node blob from PE %d does not cover PE %d\n",
+                             peer_leader, i);
+            ret = 1;
+            goto out;
+        }
+    }
+
+    *all = buf;
+    *all_len = buf_len;
+    buf = NULL;
+
+out:
+    free(known);
+    free(buf);
+    return ret;
+}
+
+
+/* Leader: lay out the records of every PE in a new data segment */
+static int
+node_data_create(const char *all, size_t all_len, size_t *data_len)
+{
+    node_index_t *index;
+    size_t off, pos;
+
+    *data_len = sizeof(node_index_t) * node_npes;
+    for (off = 0; off + sizeof(node_blob_entry_t) <= all_len; ) {
+        node_blob_entry_t entry;
+        memcpy(&entry, all + off, sizeof(entry));
+        *data_len += entry.len;
+        off += sizeof(entry) + entry.len;
+    }
+
+    shm_unlink(node_data_name);
+    node_data = node_segment_map(node_data_name, *data_len, 1);
+    if (NULL == node_data) return 1;
+
+    index = (node_index_t *) node_data;
+    pos = sizeof(node_index_t) * node_npes;
+
+    for (off = 0; off + sizeof(node_blob_entry_t) <= all_len; ) {
+        node_blob_entry_t entry;
+        memcpy(&entry, all + off, sizeof(entry));
+        off += sizeof(entry);
+        index[entry.rank].offset = pos;
+        index[entry.rank].len = entry.len;
+        memcpy(node_data + pos, all + off, entry.len);
+        pos += entry.len;
+        off += entry.len;
+    }
+
+    return 0;
+}
+#endif /* HAVE_SHM_OPEN */
+
+
+int
+shmem_runtime_util_node_exchange(const struct shmem_runtime_util_node_ops *ops)
+{
+#ifdef HAVE_SHM_OPEN
+    size_t reg_len = sizeof(node_reg_hdr_t) +
+                     (sizeof(int) + sizeof(size_t) + NODE_REG_SLOT_SIZE) * node_reg_npes;
+    node_reg_hdr_t *hdr;
+    int *reg_ranks;
+    size_t *reg_lens;
+    char *reg_slots, *blob = NULL, *all = NULL;
+    size_t blob_len = 0, all_len = 0;
+    int ret = 0, idx, i, is_leader;
+
+    /* The registration segment has one slot per PE on this node */
+    hdr = node_segment_map(node_reg_name, reg_len, 1);
+    if (NULL == hdr) return 1;
+
+    reg_ranks = (int *) (hdr + 1);
+    reg_lens = (size_t *) (reg_ranks + node_reg_npes);
+    reg_slots = (char *) (reg_lens + node_reg_npes);
+
+    idx = __atomic_fetch_add(&hdr->count, 1, __ATOMIC_ACQ_REL);
+    if (idx >= node_reg_npes) {
+        RETURN_ERROR_MSG("Stale KVS segment '%s' (%d PEs registered)\n",
+                         node_reg_name, idx + 1);
+        ret = 1;
+        goto out;
+    }
+    if (node_rec_len)
+        memcpy(reg_slots + (size_t) idx * NODE_REG_SLOT_SIZE, node_rec, node_rec_len);
+    reg_lens[idx] = node_rec_len;
+    reg_ranks[idx] = node_rank;
+
+    ret = ops->fence();
+    if (ret) {
+        RETURN_ERROR_MSG("KVS fence failed (%d)\n", ret);
+        goto out;
+    }
+
+    node_nlocal = hdr->count;
+    node_local_ranks = malloc(sizeof(int) * node_nlocal);
+    if (NULL == node_local_ranks) {
+        ret = 1;
+        goto out;
+    }
+    memcpy(node_local_ranks, reg_ranks, sizeof(int) * node_nlocal);
+    qsort(node_local_ranks, node_nlocal, sizeof(int), node_cmp_int);
+    is_leader = (node_local_ranks[0] == node_rank);
+
+    if (is_leader) {
+        size_t off = 0;
+
+        for (i = 0; i < node_nlocal; i++)
+            blob_len += sizeof(node_blob_entry_t) + reg_lens[i];
+
+        blob = malloc(blob_len);
+        if (NULL == blob) {
+            ret = 1;
+            goto out;
+        }
+
+        for (i = 0; i < node_nlocal; i++) {
+            node_blob_entry_t entry;
+            entry.rank = reg_ranks[i];
+            entry.len = reg_lens[i];
+            memcpy(blob + off, &entry, sizeof(entry));
+            memcpy(blob + off + sizeof(entry),
+                   reg_slots + (size_t) i * NODE_REG_SLOT_SIZE, entry.len);
+            off += sizeof(entry) + entry.len;
+        }
+    }
+
+    if (ops->leader_allgather) {
+        void *tmp = NULL;
+        ret = ops->leader_allgather(blob, blob_len, &tmp, &all_len);
+        all = tmp;
+    } else {
+        ret = node_kvs_allgather(ops, node_local_ranks[0], blob, blob_len,
+                                 &all, &all_len);
+    }
+    if (ret) goto out;
+
+    if (is_leader) {
+        ret = node_data_create(all, all_len, &node_data_len);
+        if (ret) goto out;
+
+        hdr->data_len = node_data_len;
+        __atomic_store_n(&hdr->ready, 1, __ATOMIC_RELEASE);
+
+        /* Names can be removed once every local PE holds a mapping */
+        while (__atomic_load_n(&hdr->mapped, __ATOMIC_ACQUIRE) < node_nlocal - 1)
+            sched_yield();
+
+        shm_unlink(node_data_name);
+        shm_unlink(node_reg_name);
+    } else {
+        while (!__atomic_load_n(&hdr->ready, __ATOMIC_ACQUIRE))
+            sched_yield();
+
+        node_data_len = hdr->data_len;
+        node_data = node_segment_map(node_data_name, node_data_len, 0);
+        if (NULL == node_data) {
+            ret = 1;
+            goto out;
+        }
+
+        __atomic_fetch_add(&hdr->mapped, 1, __ATOMIC_ACQ_REL);
+    }
+
+    DEBUG_MSG("Node KVS exchange: %d local PEs, leader %d, %zu byte table\n",
+              node_nlocal, node_local_ranks[0], node_data_len);
+
+out:
+    free(blob);
+    free(all);
+    munmap(hdr, reg_len);
+    return ret;
+#else
+    return 1;
+#endif
+}
+
+
+/* Fill the topology array from the PEs that shared the node's segment.  Only
+ * valid after shmem_runtime_util_node_exchange. */
+int
+shmem_runtime_util_node_populate(int *location_array, int *node_size)
+{
+    int i;
+
+    if (NULL == node_local_ranks) {
+        RETURN_ERROR_STR("Node topology requested before the KVS exchange");
+        return 1;
+    }
+
+    for (i = 0; i < node_npes; i++)
+        location_array[i] = -1;
+
+    for (i = 0; i < node_nlocal; i++)
+        location_array[node_local_ranks[i]] = i;
+
+    *node_size = node_nlocal;
+
+    return 0;
+}
+
+
+void
+shmem_runtime_util_node_fini(void)
+{
+#ifdef HAVE_SHM_OPEN
+    if (node_data) {
+        munmap(node_data, node_data_len);
+    }
+#endif
+
+    free(node_rec);
+    free(node_local_ranks);
+    node_data = NULL;
+    node_rec = NULL;
+    node_local_ranks = NULL;
+    node_rec_len = node_rec_size = 0;
+}
@@ -164,6 +164,20 @@ shmem_internal_cntr_dec(shmem_internal_cntr_t *val) {
     return;
 }
 
+static inline
+void
+shmem_internal_cntr_add(shmem_internal_cntr_t *val, uint64_t n) {
+    __atomic_fetch_add(val, n, __ATOMIC_RELEASE);
+    return;
+}
+
+static inline
+void
+shmem_internal_cntr_sub(shmem_internal_cntr_t *val, uint64_t n) {
+    __atomic_fetch_sub(val, n, __ATOMIC_RELEASE);
+    return;
+}
+
 #    else /* HAVE_STDATOMIC_H */
 
 #include <stdatomic.h>
@@ -197,6 +211,20 @@ shmem_internal_cntr_dec(shmem_internal_cntr_t *val) {
     return;
 }
 
+static inline
+void
+shmem_internal_cntr_add(shmem_internal_cntr_t *val, uint64_t n) {
+    atomic_fetch_add(val, n);
+    return;
+}
+
+static inline
+void
+shmem_internal_cntr_sub(shmem_internal_cntr_t *val, uint64_t n) {
+    atomic_fetch_sub(val, n);
+    return;
+}
+
 #    endif
 #  else /* !define( ENABLE_THREADS ) */
 
@@ -228,6 +256,20 @@ shmem_internal_cntr_dec(shmem_internal_cntr_t *val) {
     *val = *val-1;
     return;
 }
+
+static inline
+void
+shmem_internal_cntr_add(shmem_internal_cntr_t *val, uint64_t n) {
+    *val = *val+n;
+    return;
+}
+
+static inline
+void
+shmem_internal_cntr_sub(shmem_internal_cntr_t *val, uint64_t n) {
+    *val = *val-n;
+    return;
+}
 #  endif /* ENABLE_THREADS */
 
 #endif
@@ -17,6 +17,7 @@
 #define SHMEM_COLLECTIVES_H
 
 #include "shmem_synchronization.h"
+#include "shmem_remote_pointer.h"
 
 
 enum coll_type_t {
@@ -25,7 +26,13 @@ enum coll_type_t {
     TREE,
     DISSEM,
     RING,
-    RECDBL
+    RECDBL,
+    PIPELINED,
+    SCATTER_ALLGATHER,
+    HIER,
+    SHM,
+    RABENSEIFNER,
+    SCAN
 };
 typedef enum coll_type_t coll_type_t;
 
@@ -40,9 +47,29 @@ extern coll_type_t shmem_internal_reduce_type;
 extern coll_type_t shmem_internal_collect_type;
 extern coll_type_t shmem_internal_fcollect_type;
 
+
+/* The shared memory algorithms load and store directly to the other PEs'
+ * symmetric memory, which requires a pointer to every PE in the set */
+static inline
+int
+shmem_internal_coll_is_shr(int PE_start, int PE_stride, int PE_size, long *pSync)
+{
+    int i, pe;
+
+    if (PE_size > shmem_internal_get_shr_size()) return 0;
+
+    for (i = 0, pe = PE_start; i < PE_size; i++, pe += PE_stride) {
+        if (NULL == shmem_internal_ptr(pSync, pe)) return 0;
+    }
+
+    return 1;
+}
+
 void shmem_internal_sync_linear(int PE_start, int PE_stride, int PE_size, long *pSync);
 void shmem_internal_sync_tree(int PE_start, int PE_stride, int PE_size, long *pSync);
 void shmem_internal_sync_dissem(int PE_start, int PE_stride, int PE_size, long *pSync);
+void shmem_internal_sync_hier(int PE_start, int PE_stride, int PE_size, long *pSync);
+void shmem_internal_sync_shr(int PE_start, int PE_stride, int PE_size, long *pSync);
 
 static inline
 void
@@ -57,7 +84,9 @@ shmem_internal_sync(int PE_start, int PE_stride, int PE_size, long *pSync)
 
     switch (shmem_internal_barrier_type) {
     case AUTO:
-        if (PE_size < shmem_internal_params.COLL_CROSSOVER) {
+        if (shmem_internal_coll_is_shr(PE_start, PE_stride, PE_size, pSync)) {
+            shmem_internal_sync_shr(PE_start, PE_stride, PE_size, pSync);
+        } else if (PE_size < shmem_internal_params.COLL_CROSSOVER) {
             shmem_internal_sync_linear(PE_start, PE_stride, PE_size, pSync);
         } else {
             shmem_internal_sync_tree(PE_start, PE_stride, PE_size, pSync);
@@ -72,6 +101,16 @@ shmem_internal_sync(int PE_start, int PE_stride, int PE_size, long *pSync)
     case DISSEM:
         shmem_internal_sync_dissem(PE_start, PE_stride, PE_size, pSync);
         break;
+    case HIER:
+        shmem_internal_sync_hier(PE_start, PE_stride, PE_size, pSync);
+        break;
+    case SHM:
+        if (shmem_internal_coll_is_shr(PE_start, PE_stride, PE_size, pSync)) {
+            shmem_internal_sync_shr(PE_start, PE_stride, PE_size, pSync);
+        } else {
+            shmem_internal_sync_tree(PE_start, PE_stride, PE_size, pSync);
+        }
+        break;
     default:
         RAISE_ERROR_MSG("Illegal barrier/sync type (%d)\n",
                         shmem_internal_barrier_type);
@@ -115,6 +154,18 @@ void shmem_internal_bcast_linear(void *target, const void *source, size_t len,
 void shmem_internal_bcast_tree(void *target, const void *source, size_t len,
                                int PE_root, int PE_start, int PE_stride, int PE_size,
                                long *pSync, int complete);
+void shmem_internal_bcast_pipelined(void *target, const void *source, size_t len,
+                                    int PE_root, int PE_start, int PE_stride, int PE_size,
+                                    long *pSync, int complete);
+void shmem_internal_bcast_scatter_allgather(void *target, const void *source, size_t len,
+                                            int PE_root, int PE_start, int PE_stride,
+                                            int PE_size, long *pSync, int complete);
+void shmem_internal_bcast_hier(void *target, const void *source, size_t len,
+                               int PE_root, int PE_start, int PE_stride, int PE_size,
+                               long *pSync, int complete);
+void shmem_internal_bcast_shr(void *target, const void *source, size_t len,
+                              int PE_root, int PE_start, int PE_stride, int PE_size,
+                              long *pSync, int complete);
 
 static inline
 void
@@ -124,7 +175,10 @@ shmem_internal_bcast(void *target, const void *source, size_t len,
 {
     switch (shmem_internal_bcast_type) {
     case AUTO:
-        if (PE_size < shmem_internal_params.COLL_CROSSOVER) {
+        if (shmem_internal_coll_is_shr(PE_start, PE_stride, PE_size, pSync)) {
+            shmem_internal_bcast_shr(target, source, len, PE_root, PE_start,
+                                     PE_stride, PE_size, pSync, complete);
+        } else if (PE_size < shmem_internal_params.COLL_CROSSOVER) {
             shmem_internal_bcast_linear(target, source, len, PE_root, PE_start,
                                         PE_stride, PE_size, pSync, complete);
         } else {
@@ -140,6 +194,28 @@ shmem_internal_bcast(void *target, const void *source, size_t len,
         shmem_internal_bcast_tree(target, source, len, PE_root, PE_start,
                                   PE_stride, PE_size, pSync, complete);
         break;
+    case PIPELINED:
+        shmem_internal_bcast_pipelined(target, source, len, PE_root, PE_start,
+                                       PE_stride, PE_size, pSync, complete);
+        break;
+    case SCATTER_ALLGATHER:
+        shmem_internal_bcast_scatter_allgather(target, source, len, PE_root,
+                                               PE_start, PE_stride, PE_size,
+                                               pSync, complete);
+        break;
+    case HIER:
+        shmem_internal_bcast_hier(target, source, len, PE_root, PE_start,
+                                  PE_stride, PE_size, pSync, complete);
+        break;
+    case SHM:
+        if (shmem_internal_coll_is_shr(PE_start, PE_stride, PE_size, pSync)) {
+            shmem_internal_bcast_shr(target, source, len, PE_root, PE_start,
+                                     PE_stride, PE_size, pSync, complete);
+        } else {
+            shmem_internal_bcast_tree(target, source, len, PE_root, PE_start,
+                                      PE_stride, PE_size, pSync, complete);
+        }
+        break;
     default:
         RAISE_ERROR_MSG("Illegal broadcast type (%d)\n",
                         shmem_internal_bcast_type);
@@ -159,6 +235,18 @@ void shmem_internal_op_to_all_tree(void *target, const void *source, size_t coun
                                    int PE_start, int PE_stride, int PE_size,
                                    void *pWrk, long *pSync,
                                    shm_internal_op_t op, shm_internal_datatype_t datatype);
+void shmem_internal_op_to_all_hier(void *target, const void *source, size_t count, size_t type_size,
+                                   int PE_start, int PE_stride, int PE_size,
+                                   void *pWrk, long *pSync,
+                                   shm_internal_op_t op, shm_internal_datatype_t datatype);
+void shmem_internal_op_to_all_rabenseifner(void *target, const void *source, size_t count,
+                                           size_t type_size, int PE_start, int PE_stride,
+                                           int PE_size, void *pWrk, long *pSync,
+                                           shm_internal_op_t op, shm_internal_datatype_t datatype);
+void shmem_internal_op_to_all_shr(void *target, const void *source, size_t count, size_t type_size,
+                                  int PE_start, int PE_stride, int PE_size,
+                                  void *pWrk, long *pSync,
+                                  shm_internal_op_t op, shm_internal_datatype_t datatype);
 
 void shmem_internal_op_to_all_recdbl_sw(void *target, const void *source, size_t count, size_t type_size,
                                    int PE_start, int PE_stride, int PE_size,
@@ -177,7 +265,16 @@ shmem_internal_op_to_all(void *target, const void *source, size_t count,
 
     switch (shmem_internal_reduce_type) {
         case AUTO:
-            if (shmem_transport_atomic_supported(op, datatype)) {
+            if (shmem_internal_coll_is_shr(PE_start, PE_stride, PE_size, pSync)) {
+                shmem_internal_op_to_all_shr(target, source, count, type_size,
+                                             PE_start, PE_stride, PE_size,
+                                             pWrk, pSync, op, datatype);
+            } else if (count * type_size >= shmem_internal_params.COLL_SIZE_CROSSOVER &&
+                       count >= (size_t) PE_size) {
+                shmem_internal_op_to_all_rabenseifner(target, source, count, type_size,
+                                                      PE_start, PE_stride, PE_size,
+                                                      pWrk, pSync, op, datatype);
+            } else if (shmem_transport_atomic_supported(op, datatype)) {
                 if (PE_size < shmem_internal_params.COLL_CROSSOVER) {
                     shmem_internal_op_to_all_linear(target, source, count, type_size,
                                                     PE_start, PE_stride, PE_size,
@@ -231,6 +328,33 @@ shmem_internal_op_to_all(void *target, const void *source, size_t count,
                                                PE_start, PE_stride, PE_size,
                                                pWrk, pSync, op, datatype);
             break;
+        case RABENSEIFNER:
+            shmem_internal_op_to_all_rabenseifner(target, source, count, type_size,
+                                                  PE_start, PE_stride, PE_size,
+                                                  pWrk, pSync, op, datatype);
+            break;
+        case SHM:
+            if (shmem_internal_coll_is_shr(PE_start, PE_stride, PE_size, pSync)) {
+                shmem_internal_op_to_all_shr(target, source, count, type_size,
+                                             PE_start, PE_stride, PE_size,
+                                             pWrk, pSync, op, datatype);
+            } else {
+                shmem_internal_op_to_all_recdbl_sw(target, source, count, type_size,
+                                                   PE_start, PE_stride, PE_size,
+                                                   pWrk, pSync, op, datatype);
+            }
+            break;
+        case HIER:
+            if (shmem_transport_atomic_supported(op, datatype)) {
+                shmem_internal_op_to_all_hier(target, source, count, type_size,
+                                              PE_start, PE_stride, PE_size,
+                                              pWrk, pSync, op, datatype);
+            } else {
+                shmem_internal_op_to_all_recdbl_sw(target, source, count, type_size,
+                                                   PE_start, PE_stride, PE_size,
+                                                   pWrk, pSync, op, datatype);
+            }
+            break;
         default:
             RAISE_ERROR_MSG("Illegal reduction type (%d)\n",
                             shmem_internal_reduce_type);
@@ -240,6 +364,10 @@ shmem_internal_op_to_all(void *target, const void *source, size_t count,
 
 void shmem_internal_collect_linear(void *target, const void *source, size_t len,
                                    int PE_start, int PE_stride, int PE_size, long *pSync);
+void shmem_internal_collect_scan(void *target, const void *source, size_t len,
+                                 int PE_start, int PE_stride, int PE_size, long *pSync);
+void shmem_internal_collect_ring(void *target, const void *source, size_t len,
+                                 int PE_start, int PE_stride, int PE_size, long *pSync);
 
 static inline
 void
@@ -255,6 +383,14 @@ shmem_internal_collect(void *target, const void *source, size_t len,
         shmem_internal_collect_linear(target, source, len, PE_start, PE_stride,
                                       PE_size, pSync);
         break;
+    case SCAN:
+        shmem_internal_collect_scan(target, source, len, PE_start, PE_stride,
+                                    PE_size, pSync);
+        break;
+    case RING:
+        shmem_internal_collect_ring(target, source, len, PE_start, PE_stride,
+                                    PE_size, pSync);
+        break;
     default:
         RAISE_ERROR_MSG("Illegal collect type (%d)\n",
                         shmem_internal_collect_type);
@@ -268,6 +404,8 @@ void shmem_internal_fcollect_ring(void *target, const void *source, size_t len,
                                   int PE_start, int PE_stride, int PE_size, long *pSync);
 void shmem_internal_fcollect_recdbl(void *target, const void *source, size_t len,
                                     int PE_start, int PE_stride, int PE_size, long *pSync);
+void shmem_internal_fcollect_hier(void *target, const void *source, size_t len,
+                                  int PE_start, int PE_stride, int PE_size, long *pSync);
 
 static inline
 void
@@ -296,6 +434,10 @@ shmem_internal_fcollect(void *target, const void *source, size_t len,
                                          PE_size, pSync);
         }
         break;
+    case HIER:
+        shmem_internal_fcollect_hier(target, source, len, PE_start, PE_stride,
+                                     PE_size, pSync);
+        break;
     default:
         RAISE_ERROR_MSG("Illegal fcollect type (%d)\n",
                         shmem_internal_fcollect_type);
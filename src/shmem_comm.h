@@ -115,6 +115,31 @@ shmem_internal_put_wait(shmem_ctx_t ctx, long *completion)
 }
 
 
+/* Blocking strided put of nblocks blocks of bsize bytes, with strides given in
+ * bytes.  On return, the source buffer may be reused. */
+static inline
+void
+shmem_internal_put_strided(shmem_ctx_t ctx, void *target, const void *source,
+                           ptrdiff_t tst, ptrdiff_t sst, size_t bsize,
+                           size_t nblocks, int pe)
+{
+    long completion = 0;
+    size_t i;
+
+    if (bsize == 0 || nblocks == 0) return;
+
+    if (shmem_shr_transport_use_write(ctx, target, source, bsize, pe)) {
+        for (i = 0; i < nblocks; i++)
+            shmem_shr_transport_put(ctx, (uint8_t *) target + (ptrdiff_t) i * tst,
+                                    (uint8_t *) source + (ptrdiff_t) i * sst, bsize, pe);
+    } else {
+        shmem_transport_put_strided((shmem_transport_ctx_t *)ctx, target, source,
+                                    tst, sst, bsize, nblocks, pe, &completion);
+        shmem_internal_put_wait(ctx, &completion);
+    }
+}
+
+
 static inline
 void
 shmem_internal_get(shmem_ctx_t ctx, void *target, const void *source, size_t len, int pe)
@@ -129,6 +154,48 @@ shmem_internal_get(shmem_ctx_t ctx, void *target, const void *source, size_t len
 }
 
 
+/* Blocking get that passes target to callback in pieces as they arrive.
+ * Shared memory copies complete immediately, so they are handed over whole. */
+static inline
+void
+shmem_internal_get_stream(shmem_ctx_t ctx, void *target, const void *source, size_t len,
+                          int pe, shmemx_stream_fn_t callback, void *arg)
+{
+    if (len == 0) return;
+
+    if (shmem_shr_transport_use_read(ctx, target, source, len, pe)) {
+        shmem_shr_transport_get(ctx, target, source, len, pe);
+        callback(target, len, arg);
+    } else {
+        shmem_transport_get_stream((shmem_transport_ctx_t *)ctx, target, source, len, pe,
+                                   callback, arg);
+    }
+}
+
+
+/* Strided get of nblocks blocks of bsize bytes, with strides given in bytes.
+ * Completed by shmem_internal_get_wait. */
+static inline
+void
+shmem_internal_get_strided(shmem_ctx_t ctx, void *target, const void *source,
+                           ptrdiff_t tst, ptrdiff_t sst, size_t bsize,
+                           size_t nblocks, int pe)
+{
+    size_t i;
+
+    if (bsize == 0 || nblocks == 0) return;
+
+    if (shmem_shr_transport_use_read(ctx, target, source, bsize, pe)) {
+        for (i = 0; i < nblocks; i++)
+            shmem_shr_transport_get(ctx, (uint8_t *) target + (ptrdiff_t) i * tst,
+                                    (uint8_t *) source + (ptrdiff_t) i * sst, bsize, pe);
+    } else {
+        shmem_transport_get_strided((shmem_transport_ctx_t *)ctx, target, source,
+                                    tst, sst, bsize, nblocks, pe);
+    }
+}
+
+
 static inline
 void
 shmem_internal_get_ct(shmemx_ct_t ct, void *target, const void *source, size_t len, int pe)
@@ -58,15 +58,19 @@ SHMEM_INTERNAL_ENV_DEF(COLL_SIZE_CROSSOVER, size, 16384, SHMEM_INTERNAL_ENV_CAT_
 SHMEM_INTERNAL_ENV_DEF(COLL_RADIX, long, 4, SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
                        "Radix for tree-based collectives")
 SHMEM_INTERNAL_ENV_DEF(BARRIER_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
-                       "Algorithm for barrier.  Options are auto, linear, tree, dissem")
+                       "Algorithm for barrier.  Options are auto, linear, tree, dissem, hierarchical, shm")
 SHMEM_INTERNAL_ENV_DEF(BCAST_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
-                       "Algorithm for broadcast.  Options are auto, linear, tree")
+                       "Algorithm for broadcast.  Options are auto, linear, tree, pipelined, scatter-allgather, "
+                       "hierarchical, shm")
+SHMEM_INTERNAL_ENV_DEF(BCAST_SEGMENT_SIZE, size, 8192, SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
+                       "Segment size of pipelined broadcasts (bytes)")
 SHMEM_INTERNAL_ENV_DEF(REDUCE_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
-                       "Algorithm for reductions.  Options are auto, linear, tree, recdbl")
+                       "Algorithm for reductions.  Options are auto, linear, tree, recdbl, ring, "
+                       "rabenseifner, hierarchical, shm")
 SHMEM_INTERNAL_ENV_DEF(COLLECT_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
-                       "Algorithm for collect.  Options are auto, linear")
+                       "Algorithm for collect.  Options are auto, linear, scan, ring")
 SHMEM_INTERNAL_ENV_DEF(FCOLLECT_ALGORITHM, string, "auto", SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
-                       "Algorithm for fcollect.  Options are auto, linear, ring, recdbl")
+                       "Algorithm for fcollect.  Options are auto, linear, ring, recdbl, hierarchical")
 SHMEM_INTERNAL_ENV_DEF(BARRIERS_FLUSH, bool, false, SHMEM_INTERNAL_ENV_CAT_COLLECTIVES,
                         "Flush stdout and stderr on barrier")
 
@@ -105,8 +109,42 @@ SHMEM_INTERNAL_ENV_DEF(OFI_STX_THRESHOLD, long, 1, SHMEM_INTERNAL_ENV_CAT_TRANSP
                        "Maximum number of shared contexts per STX before allocating a new STX resource")
 SHMEM_INTERNAL_ENV_DEF(OFI_STX_ALLOCATOR, string, "round-robin", SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Algorithm for allocating STX resources to contexts")
+SHMEM_INTERNAL_ENV_DEF(OFI_STX_REBALANCE_INTERVAL, long, 0, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Quiets between checks for moving an idle context to a less loaded STX (load allocator, 0 disables)")
 SHMEM_INTERNAL_ENV_DEF(OFI_STX_DISABLE_PRIVATE, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
                        "Disallow private contexts from having exclusive STX access")
+SHMEM_INTERNAL_ENV_DEF(OFI_SCALABLE_EP, long, 0, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Transmit contexts in a scalable endpoint given to contexts before STXs (-1 for the provider maximum, 0 disables)")
+SHMEM_INTERNAL_ENV_DEF(OFI_CQ_BATCH_SIZE, long, 32, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Maximum number of completions read from a context CQ per call")
+SHMEM_INTERNAL_ENV_DEF(OFI_AGGREGATE_SIZE, size, 1024, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Flush threshold for contexts created with SHMEMX_CTX_AGGREGATE (bytes)")
+SHMEM_INTERNAL_ENV_DEF(OFI_AGGREGATE_TIMEOUT, long, 100, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Maximum age of an aggregate before the next put flushes it (usec, 0 to disable)")
+SHMEM_INTERNAL_ENV_DEF(OFI_ORDERED_SIGNAL, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Skip the put-with-signal fence when the provider orders writes after writes")
+SHMEM_INTERNAL_ENV_DEF(OFI_LAZY_CONNECT, bool, false, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Fetch peer addresses and memory keys on first communication with each PE")
+SHMEM_INTERNAL_ENV_DEF(OFI_NUM_RAILS, long, 1, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Number of OFI domains (rails) used for RMA")
+SHMEM_INTERNAL_ENV_DEF(OFI_RAIL_STRIPE_SIZE, size, 65536, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Transfers of at least this many bytes are striped across all rails")
+SHMEM_INTERNAL_ENV_DEF(OFI_GET_FRAGMENT_SIZE, size, 262144, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Fragment size of large gets (0 for the provider's maximum message size)")
+SHMEM_INTERNAL_ENV_DEF(OFI_GET_WINDOW, long, 64, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Maximum number of outstanding get fragments per context (0 for no limit)")
+SHMEM_INTERNAL_ENV_DEF(OFI_MR_CACHE_SIZE, long, 0, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Maximum number of local buffer registrations cached per context (0 disables)")
+#ifdef ENABLE_THREADS
+SHMEM_INTERNAL_ENV_DEF(OFI_PROGRESS_INTERVAL, long, 0, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Polling interval for the OFI progress thread in microseconds (0 to disable)")
+SHMEM_INTERNAL_ENV_DEF(OFI_PROGRESS_MAX_INTERVAL, long, 10000, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Longest interval the OFI progress thread backs off to when idle, in microseconds")
+SHMEM_INTERNAL_ENV_DEF(OFI_PROGRESS_CORE, long, -1, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "CPU core to pin the OFI progress thread to (-1 to leave unpinned)")
+#endif
+SHMEM_INTERNAL_ENV_DEF(OFI_PE_CNTR_TABLE_SIZE, long, 0, SHMEM_INTERNAL_ENV_CAT_TRANSPORT,
+                       "Number of per-PE completion counters used to scope fence and put-with-signal ordering (0 to disable)")
 #endif
 
 #ifdef USE_UCX
@@ -119,6 +157,9 @@ SHMEM_INTERNAL_ENV_DEF(MPI_THREAD_LEVEL, string, "MPI_THREAD_SINGLE", SHMEM_INTE
                        "Specify the MPI threading level when MPI is used as the process manager")
 #endif
 
+SHMEM_INTERNAL_ENV_DEF(RUNTIME_NODE_EXCHANGE, bool, false, SHMEM_INTERNAL_ENV_CAT_OTHER,
+                       "Exchange runtime keys through one leader PE per node and shared memory")
+
 SHMEM_INTERNAL_ENV_DEF(BACKTRACE, string, "", SHMEM_INTERNAL_ENV_CAT_OTHER,
                        "Specify the mechanism to use for backtracing on failure")
 
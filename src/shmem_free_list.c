@@ -23,6 +23,38 @@
 #include "shmem_free_list.h"
 
 
+#ifdef SHMEM_FREE_LIST_TAGGED_HEAD
+/* Check that heap, mmap, and stack addresses fit below the tag.  Addresses
+ * above 48 bits are only handed out with 5-level paging or 52-bit address
+ * spaces when the application asks for them with a hint, and tagged pointers
+ * set bits in every heap address, so these samples are representative of the
+ * elements the list will hold. */
+static int
+shmem_free_list_tag_usable(void)
+{
+    static int usable = -1;
+    void *small, *large;
+
+    if (usable >= 0) return usable;
+
+    small = malloc(sizeof(shmem_free_list_alloc_t));
+    large = malloc(1024 * 1024); /* Above the default malloc mmap threshold */
+
+    usable = (((uintptr_t) small & ~SHMEM_FREE_LIST_PTR_MASK) == 0 &&
+              ((uintptr_t) large & ~SHMEM_FREE_LIST_PTR_MASK) == 0 &&
+              ((uintptr_t) &small & ~SHMEM_FREE_LIST_PTR_MASK) == 0);
+
+    free(small);
+    free(large);
+
+    if (!usable)
+        DEBUG_STR("Addresses exceed 48 bits, free lists use a locked head");
+
+    return usable;
+}
+#endif
+
+
 shmem_free_list_t*
 shmem_free_list_init(unsigned int element_size,
                      shmem_free_list_item_init_fn_t init_fn)
@@ -33,8 +65,15 @@ shmem_free_list_init(unsigned int element_size,
 
     fl->element_size = element_size;
     fl->init_fn = init_fn;
-    fl->nalloc = 0;
+    fl->head = 0;
+    shmem_internal_cntr_write(&fl->nalloc, 0);
     SHMEM_MUTEX_INIT(fl->lock);
+#ifdef ENABLE_THREADS
+    shmem_spinlock_init(&fl->head_lock);
+#endif
+#ifdef SHMEM_FREE_LIST_TAGGED_HEAD
+    fl->tagged = shmem_free_list_tag_usable();
+#endif
     ret = shmem_free_list_more(fl);
     if (0 != ret) {
         free(fl);
@@ -58,6 +97,9 @@ shmem_free_list_destroy(shmem_free_list_t *fl)
     }
 
     SHMEM_MUTEX_DESTROY(fl->lock);
+#ifdef ENABLE_THREADS
+    shmem_spinlock_fini(&fl->head_lock);
+#endif
 }
 
 
@@ -77,6 +119,18 @@ shmem_free_list_more(shmem_free_list_t *fl)
                  num_elements * fl->element_size);
     if (NULL == buf) return 1;
 
+#ifdef SHMEM_FREE_LIST_TAGGED_HEAD
+    /* The head cannot switch to the lock while other threads use the tag, so
+     * memory that does not fit below the tag is reported as exhausted */
+    if (fl->tagged &&
+        ((uintptr_t) buf + sizeof(shmem_free_list_alloc_t) +
+         num_elements * fl->element_size - 1) & ~SHMEM_FREE_LIST_PTR_MASK) {
+        RAISE_WARN_STR("Free list memory does not fit in 48 bits");
+        free(buf);
+        return 1;
+    }
+#endif
+
     header = (shmem_free_list_alloc_t*) buf;
     first = item = (shmem_free_list_item_t*) (header + 1);
     for (i = 0 ; i < num_elements ; ++i) {
@@ -91,11 +145,15 @@ shmem_free_list_more(shmem_free_list_t *fl)
         item = next;
     }
 
-    header->next = fl->allocs;
-    fl->allocs = header;
+    /* Growth may race with other allocating threads, and callers may hold the
+     * list lock, so the allocation list is updated with a CAS.  It is only
+     * ever pushed to, so it is not subject to ABA. */
+    header->next = __atomic_load_n(&fl->allocs, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&fl->allocs, &header->next, header, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
 
-    if (NULL != last) last->next = fl->head;
-    fl->head = first;
+    shmem_free_list_push(fl, first, last);
 
     return 0;
 }
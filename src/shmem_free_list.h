@@ -19,6 +19,7 @@
 #include <stdint.h>
 
 #include "shmem_internal.h"
+#include "shmem_atomic.h"
 
 struct shmem_free_list_item_t {
     struct shmem_free_list_item_t *next;
@@ -32,15 +33,41 @@ typedef struct shmem_free_list_alloc_t shmem_free_list_alloc_t;
 
 typedef void (*shmem_free_list_item_init_fn_t)(shmem_free_list_item_t *item);
 
+/* The free list head is a Treiber stack, so shmem_free_list_alloc() and
+ * shmem_free_list_free() may be called concurrently without holding the list
+ * lock.  On x86_64 and aarch64, the upper 16 bits of the head word carry a
+ * modification tag that prevents ABA races between a popping thread reading
+ * head->next and another thread recycling head.  Elements are only released
+ * in shmem_free_list_destroy(), so reading the next pointer of a stale head is
+ * always safe.
+ *
+ * The tag requires element addresses to fit in 48 bits, which does not hold
+ * with 5-level paging, 52-bit address spaces, or tagged pointers.  This is
+ * checked when the list is created.  Lists that cannot use the tag, and all
+ * lists on other platforms, protect the head with an internal spinlock.
+ *
+ * The list lock is not needed for allocation or release; it remains available
+ * to callers that need to protect state associated with the list (e.g.
+ * draining the completion queue that returns elements). */
+#if defined(ENABLE_THREADS) && (defined(__x86_64__) || defined(__aarch64__))
+#define SHMEM_FREE_LIST_TAGGED_HEAD 1
+#define SHMEM_FREE_LIST_TAG_SHIFT   48
+#define SHMEM_FREE_LIST_PTR_MASK    ((UINT64_C(1) << SHMEM_FREE_LIST_TAG_SHIFT) - 1)
+#endif
+
 struct shmem_free_list_t {
+    uint64_t head;
+    shmem_internal_cntr_t nalloc;
     uint32_t element_size;
-    uint64_t nalloc;
 
     shmem_free_list_item_init_fn_t init_fn;
     shmem_free_list_alloc_t *allocs;
-    shmem_free_list_item_t* head;
 #ifdef ENABLE_THREADS
     shmem_internal_mutex_t lock;
+    shmem_spinlock_t head_lock;
+#endif
+#ifdef SHMEM_FREE_LIST_TAGGED_HEAD
+    int tagged;
 #endif
 };
 typedef struct shmem_free_list_t shmem_free_list_t;
@@ -51,22 +78,141 @@ void shmem_free_list_destroy(shmem_free_list_t *fl);
 int shmem_free_list_more(shmem_free_list_t *fl);
 
 
+#ifdef SHMEM_FREE_LIST_TAGGED_HEAD
+
+static inline
+shmem_free_list_item_t*
+shmem_free_list_head_ptr(uint64_t head)
+{
+    return (shmem_free_list_item_t*) (uintptr_t) (head & SHMEM_FREE_LIST_PTR_MASK);
+}
+
+
+static inline
+uint64_t
+shmem_free_list_head_make(shmem_free_list_item_t *item, uint64_t old_head)
+{
+    uint64_t tag = (old_head >> SHMEM_FREE_LIST_TAG_SHIFT) + 1;
+    return ((uint64_t) (uintptr_t) item) | (tag << SHMEM_FREE_LIST_TAG_SHIFT);
+}
+
+
+/* Push the chain first..last onto the list */
+static inline
+void
+shmem_free_list_push_tagged(shmem_free_list_t *fl, shmem_free_list_item_t *first,
+                            shmem_free_list_item_t *last)
+{
+    uint64_t old_head, new_head;
+
+    old_head = __atomic_load_n(&fl->head, __ATOMIC_RELAXED);
+    do {
+        last->next = shmem_free_list_head_ptr(old_head);
+        new_head = shmem_free_list_head_make(first, old_head);
+    } while (!__atomic_compare_exchange_n(&fl->head, &old_head, new_head, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+
+/* Pop an element from the list, returns NULL if the list is empty */
+static inline
+shmem_free_list_item_t*
+shmem_free_list_pop_tagged(shmem_free_list_t *fl)
+{
+    uint64_t old_head, new_head;
+    shmem_free_list_item_t *item, *next;
+
+    old_head = __atomic_load_n(&fl->head, __ATOMIC_ACQUIRE);
+    do {
+        item = shmem_free_list_head_ptr(old_head);
+        if (NULL == item) return NULL;
+        next = __atomic_load_n(&item->next, __ATOMIC_RELAXED);
+        new_head = shmem_free_list_head_make(next, old_head);
+    } while (!__atomic_compare_exchange_n(&fl->head, &old_head, new_head, 1,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    return item;
+}
+
+#endif /* SHMEM_FREE_LIST_TAGGED_HEAD */
+
+
+static inline
+void
+shmem_free_list_push_locked(shmem_free_list_t *fl, shmem_free_list_item_t *first,
+                            shmem_free_list_item_t *last)
+{
+#ifdef ENABLE_THREADS
+    shmem_spinlock_lock(&fl->head_lock);
+#endif
+    last->next = (shmem_free_list_item_t*) (uintptr_t) fl->head;
+    fl->head = (uint64_t) (uintptr_t) first;
+#ifdef ENABLE_THREADS
+    shmem_spinlock_unlock(&fl->head_lock);
+#endif
+}
+
+
+static inline
+shmem_free_list_item_t*
+shmem_free_list_pop_locked(shmem_free_list_t *fl)
+{
+    shmem_free_list_item_t *item;
+
+#ifdef ENABLE_THREADS
+    shmem_spinlock_lock(&fl->head_lock);
+#endif
+    item = (shmem_free_list_item_t*) (uintptr_t) fl->head;
+    if (NULL != item)
+        fl->head = (uint64_t) (uintptr_t) item->next;
+#ifdef ENABLE_THREADS
+    shmem_spinlock_unlock(&fl->head_lock);
+#endif
+
+    return item;
+}
+
+
+static inline
+void
+shmem_free_list_push(shmem_free_list_t *fl, shmem_free_list_item_t *first,
+                     shmem_free_list_item_t *last)
+{
+#ifdef SHMEM_FREE_LIST_TAGGED_HEAD
+    if (fl->tagged) {
+        shmem_free_list_push_tagged(fl, first, last);
+        return;
+    }
+#endif
+    shmem_free_list_push_locked(fl, first, last);
+}
+
+
+static inline
+shmem_free_list_item_t*
+shmem_free_list_pop(shmem_free_list_t *fl)
+{
+#ifdef SHMEM_FREE_LIST_TAGGED_HEAD
+    if (fl->tagged)
+        return shmem_free_list_pop_tagged(fl);
+#endif
+    return shmem_free_list_pop_locked(fl);
+}
+
+
 static inline
 void*
 shmem_free_list_alloc(shmem_free_list_t *fl)
 {
-    shmem_free_list_item_t *item = NULL;
+    shmem_free_list_item_t *item;
     int ret;
 
-    if (NULL == fl->head) {
+    while (NULL == (item = shmem_free_list_pop(fl))) {
         ret = shmem_free_list_more(fl);
-        if (0 != ret) return item;
+        if (0 != ret) return NULL;
     }
-    shmem_internal_assert(NULL != fl->head);
 
-    item = fl->head;
-    fl->head = item->next;
-    fl->nalloc++;
+    shmem_internal_cntr_inc(&fl->nalloc);
 
     return item;
 }
@@ -78,9 +224,30 @@ shmem_free_list_free(shmem_free_list_t *fl, void *data)
 {
     shmem_free_list_item_t *item = (shmem_free_list_item_t*) data;
 
-    item->next = fl->head;
-    fl->head = item;
-    fl->nalloc--;
+    shmem_free_list_push(fl, item, item);
+    shmem_internal_cntr_dec(&fl->nalloc);
+}
+
+
+/* Return a chain of count elements, linked through their next pointers from
+ * first to last, to the list in a single operation */
+static inline
+void
+shmem_free_list_free_chain(shmem_free_list_t *fl, void *first, void *last,
+                           uint64_t count)
+{
+    shmem_free_list_push(fl, (shmem_free_list_item_t*) first,
+                         (shmem_free_list_item_t*) last);
+    shmem_internal_cntr_sub(&fl->nalloc, count);
+}
+
+
+/* Number of elements currently allocated from the list */
+static inline
+uint64_t
+shmem_free_list_nalloc(shmem_free_list_t *fl)
+{
+    return shmem_internal_cntr_read(&fl->nalloc);
 }
 
 
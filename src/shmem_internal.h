@@ -448,7 +448,7 @@ void shmem_internal_global_exit(int status) SHMEM_ATTRIBUTE_NORETURN;
 
 int shmem_internal_symmetric_init(void);
 int shmem_internal_symmetric_fini(void);
-int shmem_internal_collectives_init(void);
+int shmem_internal_collectives_init(int enable_node_ranks);
 
 /* internal allocation, without a barrier */
 void *shmem_internal_shmalloc(size_t size);
@@ -467,6 +467,48 @@ static inline void shmem_internal_free(void *ptr)
     }
 }
 
+/* Symmetric segment IDs, used to index the transports' per-PE translation
+ * tables.  The heap is checked first, since nearly all traffic targets it. */
+#define SHMEM_INTERNAL_SEG_DATA 0
+#define SHMEM_INTERNAL_SEG_HEAP 1
+#define SHMEM_INTERNAL_NSEG     2
+
+#define SHMEM_INTERNAL_CACHELINE_SIZE 64
+
+/* Return the segment containing addr and store its offset from the local
+ * segment base.  With --enable-symmetric-heap-only, every address is assumed
+ * to be in the heap and the lookup reduces to a subtraction. */
+static inline
+int shmem_internal_seg_lookup(const void *addr, size_t *offset)
+{
+    size_t heap_off = (size_t) ((uint8_t *) addr - (uint8_t *) shmem_internal_heap_base);
+
+#ifdef ENABLE_SYMMETRIC_HEAP_ONLY
+#ifdef ENABLE_ERROR_CHECKING
+    if (heap_off >= (size_t) shmem_internal_heap_length)
+        RAISE_ERROR_MSG("address (%p) outside of symmetric heap\n", addr);
+#endif
+    *offset = heap_off;
+    return SHMEM_INTERNAL_SEG_HEAP;
+#else
+    size_t data_off;
+
+    if (heap_off < (size_t) shmem_internal_heap_length) {
+        *offset = heap_off;
+        return SHMEM_INTERNAL_SEG_HEAP;
+    }
+
+    data_off = (size_t) ((uint8_t *) addr - (uint8_t *) shmem_internal_data_base);
+    if (data_off < (size_t) shmem_internal_data_length) {
+        *offset = data_off;
+        return SHMEM_INTERNAL_SEG_DATA;
+    }
+
+    RAISE_ERROR_MSG("address (%p) outside of symmetric areas\n", addr);
+    return -1;
+#endif /* ENABLE_SYMMETRIC_HEAP_ONLY */
+}
+
 /* Query PEs reachable using shared memory */
 static inline int shmem_internal_get_shr_rank(int pe)
 {
@@ -148,6 +148,15 @@ shmem_transport_put_nbi(shmem_transport_ctx_t* ctx, void *target, const void *so
     RAISE_ERROR_STR("No path to peer");
 }
 
+static inline
+void
+shmem_transport_put_strided(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                            ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                            int pe, long *completion)
+{
+    RAISE_ERROR_STR("No path to peer");
+}
+
 static inline
 void
 shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len, int pe)
@@ -155,6 +164,15 @@ shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *source
     RAISE_ERROR_STR("No path to peer");
 }
 
+static inline
+void
+shmem_transport_get_strided(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                            ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                            int pe)
+{
+    RAISE_ERROR_STR("No path to peer");
+}
+
 static inline
 void
 shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
@@ -162,6 +180,14 @@ shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
     /* Nop */
 }
 
+static inline
+void
+shmem_transport_get_stream(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                           size_t len, int pe, shmemx_stream_fn_t callback, void *arg)
+{
+    RAISE_ERROR_STR("No path to peer");
+}
+
 
 static inline
 void
@@ -364,6 +390,12 @@ uint64_t shmem_transport_pcntr_get_completed_target(void)
     return 0;
 }
 
+static inline
+double shmem_transport_pcntr_get_cq_batch(shmem_transport_ctx_t *ctx)
+{
+    return 0.0;
+}
+
 static inline
 void shmem_transport_pcntr_get_all(shmem_transport_ctx_t *ctx, shmemx_pcntr_t *pcntr)
 {
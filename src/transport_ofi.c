@@ -36,6 +36,15 @@
 #define fnmatch(P, S, F) strcmp(P, S)
 #endif
 
+#if defined(ENABLE_THREADS) && defined(HAVE_LINUX_USERFAULTFD_H)
+#define USE_MR_CACHE_MONITOR 1
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/userfaultfd.h>
+#endif
+
 #define SHMEM_INTERNAL_INCLUDE
 #include "shmem.h"
 #include "shmem_internal.h"
@@ -72,13 +81,9 @@ struct fid_mr*                  shmem_transport_ofi_target_data_mrfd;
 #else  /* !ENABLE_MR_SCALABLE */
 struct fid_mr*                  shmem_transport_ofi_target_heap_mrfd;
 struct fid_mr*                  shmem_transport_ofi_target_data_mrfd;
-uint64_t*                       shmem_transport_ofi_target_heap_keys;
-uint64_t*                       shmem_transport_ofi_target_data_keys;
+shmem_transport_ofi_peer_mr_t*  shmem_transport_ofi_peer_mr;
 #ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-int                             shmem_transport_ofi_use_absolute_address;
-#else
-uint8_t**                       shmem_transport_ofi_target_heap_addrs;
-uint8_t**                       shmem_transport_ofi_target_data_addrs;
+static int                      shmem_transport_ofi_use_absolute_address;
 #endif /* ENABLE_REMOTE_VIRTUAL_ADDRESSING */
 #endif /* ENABLE_MR_SCALABLE */
 uint64_t                        shmem_transport_ofi_max_poll;
@@ -86,17 +91,38 @@ long                            shmem_transport_ofi_put_poll_limit;
 long                            shmem_transport_ofi_get_poll_limit;
 size_t                          shmem_transport_ofi_max_buffered_send;
 size_t                          shmem_transport_ofi_max_msg_size;
+size_t                          shmem_transport_ofi_get_frag_size;
+long                            shmem_transport_ofi_get_window;
+size_t                          shmem_transport_ofi_iov_limit;
+size_t                          shmem_transport_ofi_rma_iov_limit;
 size_t                          shmem_transport_ofi_bounce_buffer_size;
 long                            shmem_transport_ofi_max_bounce_buffers;
+int                             shmem_transport_ofi_num_bounce_classes;
+size_t                          shmem_transport_ofi_bounce_class_size[SHMEM_TRANSPORT_OFI_BB_MAX_CLASSES];
+long                            shmem_transport_ofi_cq_batch_size;
+size_t                          shmem_transport_ofi_aggr_size;
+double                          shmem_transport_ofi_aggr_timeout;
+size_t                          shmem_transport_ofi_signal_order_size;
+long                            shmem_transport_ofi_pe_cntr_mask = -1;
 size_t                          shmem_transport_ofi_addrlen;
 #ifdef ENABLE_MR_RMA_EVENT
 int                             shmem_transport_ofi_mr_rma_event;
 #endif
 fi_addr_t                       *addr_table;
+int                             shmem_transport_ofi_num_rails = 1;
+size_t                          shmem_transport_ofi_rail_stripe_size;
+shmem_transport_ofi_rail_t      *shmem_transport_ofi_rails;
+int                             shmem_transport_ofi_lazy_connect;
+uint8_t                         *shmem_transport_ofi_peer_ready;
 #ifdef ENABLE_THREADS
 shmem_internal_mutex_t          shmem_transport_ofi_lock;
+shmem_internal_mutex_t          shmem_transport_ofi_peer_lock;
 pthread_mutex_t                 shmem_transport_ofi_progress_lock = PTHREAD_MUTEX_INITIALIZER;
 #endif /* ENABLE_THREADS */
+int                             shmem_transport_ofi_progress_thread_enabled = 0;
+void*                           shmem_transport_ofi_heap_desc;
+void*                           shmem_transport_ofi_data_desc;
+long                            shmem_transport_ofi_mr_cache_size;
 
 /* Temporarily redefine SHM_INTERNAL integer types to their FI counterparts to
  * translate the DTYPE_* types (defined by autoconf according to system ABI)
@@ -354,7 +380,8 @@ uint64_t shmem_transport_ofi_max_poll = (1ULL<<30);
 
 enum stx_allocator_t {
     ROUNDROBIN = 0,
-    RANDOM
+    RANDOM,
+    LOAD
 };
 typedef enum stx_allocator_t stx_allocator_t;
 static stx_allocator_t shmem_transport_ofi_stx_allocator;
@@ -366,6 +393,11 @@ struct shmem_transport_ofi_stx_t {
     struct fid_stx*   stx;
     long              ref_cnt;
     int               is_private;
+    /* Operations credited by the contexts using this STX (updated
+     * atomically), the ops value at the last sample, and the decayed load */
+    uint64_t          ops;
+    uint64_t          mark;
+    uint64_t          load;
 };
 typedef struct shmem_transport_ofi_stx_t shmem_transport_ofi_stx_t;
 static shmem_transport_ofi_stx_t* shmem_transport_ofi_stx_pool = NULL;
@@ -378,23 +410,95 @@ struct shmem_transport_ofi_stx_kvs_t {
 typedef struct shmem_transport_ofi_stx_kvs_t shmem_transport_ofi_stx_kvs_t;
 static shmem_transport_ofi_stx_kvs_t* shmem_transport_ofi_stx_kvs = NULL;
 
+int shmem_transport_ofi_stx_load_tracking = 0;
+
+/* Scalable endpoint whose transmit contexts are each given to one context.
+ * Contexts created once all transmit contexts are in use get an endpoint on
+ * an STX instead. */
+static struct fid_ep* shmem_transport_ofi_sep = NULL;
+static long shmem_transport_ofi_sep_tx_max = 0;
+static char* shmem_transport_ofi_sep_tx_used = NULL;
+
+static inline
+int shmem_transport_ofi_sep_claim(void)
+{
+    long i;
+
+    for (i = 0; i < shmem_transport_ofi_sep_tx_max; i++) {
+        if (!shmem_transport_ofi_sep_tx_used[i]) {
+            shmem_transport_ofi_sep_tx_used[i] = 1;
+            return (int) i;
+        }
+    }
+
+    return -1;
+}
+
+static inline
+void shmem_transport_ofi_stx_get_stats(int i, shmem_transport_ofi_stx_stats_t *stats)
+{
+    stats->ref_cnt    = shmem_transport_ofi_stx_pool[i].ref_cnt;
+    stats->is_private = shmem_transport_ofi_stx_pool[i].is_private;
+    stats->ops        = __atomic_load_n(&shmem_transport_ofi_stx_pool[i].ops, __ATOMIC_RELAXED);
+    stats->load       = shmem_transport_ofi_stx_pool[i].load;
+}
+
+int shmem_transport_ofi_stx_stats(shmem_transport_ofi_stx_stats_t *stats, int nstats)
+{
+    int i;
+
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
+    for (i = 0; i < nstats && i < shmem_transport_ofi_stx_max; i++)
+        shmem_transport_ofi_stx_get_stats(i, &stats[i]);
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+
+    return (int) shmem_transport_ofi_stx_max;
+}
+
 static inline
 void shmem_transport_ofi_dump_stx(void) {
     char stx_str[256];
     int i, offset;
+    shmem_transport_ofi_stx_stats_t stats;
 
-    if (shmem_transport_ofi_stx_max == 0)
+    if (shmem_transport_ofi_stx_max == 0 || !shmem_internal_params.DEBUG)
         return;
 
-    for (i = offset = 0; i < shmem_transport_ofi_stx_max; i++)
-        offset += snprintf(stx_str+offset, 256-offset,
-                           (i == shmem_transport_ofi_stx_max-1) ? "%ld%s" : "%ld%s ",
-                           shmem_transport_ofi_stx_pool[i].ref_cnt,
-                           shmem_transport_ofi_stx_pool[i].is_private ? "P" : "S");
+    stx_str[0] = '\0';
+
+    for (i = offset = 0; i < shmem_transport_ofi_stx_max && offset < (int) sizeof(stx_str); i++) {
+        shmem_transport_ofi_stx_get_stats(i, &stats);
+
+        if (shmem_transport_ofi_stx_load_tracking)
+            offset += snprintf(stx_str+offset, sizeof(stx_str)-offset,
+                               (i == shmem_transport_ofi_stx_max-1) ? "%ld%s/%"PRIu64 : "%ld%s/%"PRIu64" ",
+                               stats.ref_cnt, stats.is_private ? "P" : "S", stats.load);
+        else
+            offset += snprintf(stx_str+offset, sizeof(stx_str)-offset,
+                               (i == shmem_transport_ofi_stx_max-1) ? "%ld%s" : "%ld%s ",
+                               stats.ref_cnt, stats.is_private ? "P" : "S");
+    }
 
     DEBUG_MSG("STX[%ld] = [ %s ]\n", shmem_transport_ofi_stx_max, stx_str);
 }
 
+/* Fold the operations credited since the last sample into each STX's load.
+ * Half of the previous load carries over, so the load tracks recent traffic.
+ * Called with shmem_transport_ofi_lock held. */
+static inline
+void shmem_transport_ofi_stx_sample_load(void)
+{
+    int i;
+
+    for (i = 0; i < shmem_transport_ofi_stx_max; i++) {
+        shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[i];
+        uint64_t ops = __atomic_load_n(&stx->ops, __ATOMIC_RELAXED);
+
+        stx->load = stx->load / 2 + (ops - stx->mark);
+        stx->mark = ops;
+    }
+}
+
 static inline
 int shmem_transport_ofi_is_private(long options) {
     if (!shmem_internal_params.OFI_STX_DISABLE_PRIVATE &&
@@ -476,6 +580,25 @@ int shmem_transport_ofi_stx_search_shared(long threshold)
                            !shmem_transport_ofi_stx_pool[stx_idx].is_private));
             }
 
+            break;
+
+        case LOAD:
+            /* Least loaded STX, breaking ties by the number of contexts */
+            for (i = 0; i < shmem_transport_ofi_stx_max; i++) {
+                shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[i];
+
+                if (stx->ref_cnt > 0 &&
+                    (stx->ref_cnt <= threshold || threshold == -1) &&
+                    !stx->is_private &&
+                    (stx_idx < 0 ||
+                     stx->load < shmem_transport_ofi_stx_pool[stx_idx].load ||
+                     (stx->load == shmem_transport_ofi_stx_pool[stx_idx].load &&
+                      stx->ref_cnt < shmem_transport_ofi_stx_pool[stx_idx].ref_cnt)))
+                {
+                    stx_idx = i;
+                }
+            }
+
             break;
         default:
             RAISE_ERROR_MSG("Invalid STX allocator (%d)\n",
@@ -490,6 +613,9 @@ int shmem_transport_ofi_stx_search_shared(long threshold)
 static inline
 void shmem_transport_ofi_stx_allocate(shmem_transport_ctx_t *ctx)
 {
+    if (shmem_transport_ofi_stx_load_tracking)
+        shmem_transport_ofi_stx_sample_load();
+
     if (shmem_transport_ofi_stx_max == 0) {
         ctx->stx_idx = -1;
     } else if (shmem_transport_ofi_is_private(ctx->options)) {
@@ -556,6 +682,10 @@ void shmem_transport_ofi_stx_allocate(shmem_transport_ctx_t *ctx)
         shmem_transport_ofi_stx_pool[ctx->stx_idx].ref_cnt++;
     }
 
+    if (ctx->stx_idx >= 0)
+        ctx->stx_check_ops = __atomic_load_n(&shmem_transport_ofi_stx_pool[ctx->stx_idx].ops,
+                                             __ATOMIC_RELAXED);
+
     shmem_transport_ofi_dump_stx();
 
     return;
@@ -604,12 +734,20 @@ int bind_enable_ep_resources(shmem_transport_ctx_t *ctx)
      * removed below.  However, there aren't currently any cases where removing
      * FI_RECV significantly improves performance or resource usage.  */
 
-    ret = fi_ep_bind(ctx->ep, &ctx->cq->fid,
-                     FI_SELECTIVE_COMPLETION | FI_TRANSMIT | FI_RECV);
-    OFI_CHECK_RETURN_STR(ret, "fi_ep_bind CQ to endpoint failed");
+    /* Transmit contexts have no receive side, and use the AV bound to the
+     * scalable endpoint */
+    if (ctx->sep_idx >= 0) {
+        ret = fi_ep_bind(ctx->ep, &ctx->cq->fid,
+                         FI_SELECTIVE_COMPLETION | FI_TRANSMIT);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind CQ to TX context failed");
+    } else {
+        ret = fi_ep_bind(ctx->ep, &ctx->cq->fid,
+                         FI_SELECTIVE_COMPLETION | FI_TRANSMIT | FI_RECV);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind CQ to endpoint failed");
 
-    ret = fi_ep_bind(ctx->ep, &shmem_transport_ofi_avfd->fid, 0);
-    OFI_CHECK_RETURN_STR(ret, "fi_ep_bind AV to endpoint failed");
+        ret = fi_ep_bind(ctx->ep, &shmem_transport_ofi_avfd->fid, 0);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind AV to endpoint failed");
+    }
 
     ret = fi_enable(ctx->ep);
     OFI_CHECK_RETURN_STR(ret, "fi_enable on endpoint failed");
@@ -617,13 +755,171 @@ int bind_enable_ep_resources(shmem_transport_ctx_t *ctx)
     return ret;
 }
 
+static inline
+void shmem_transport_ofi_set_ep_info(struct fi_info *p_info)
+{
+    p_info->ep_attr->tx_ctx_cnt = shmem_transport_ofi_stx_max > 0 ? FI_SHARED_CONTEXT : 0;
+    p_info->caps = FI_RMA | FI_WRITE | FI_READ | FI_ATOMIC;
+    p_info->tx_attr->op_flags = FI_DELIVERY_COMPLETE;
+    p_info->mode = 0;
+    p_info->tx_attr->mode = 0;
+    p_info->rx_attr->mode = 0;
+}
+
+/* Move an idle context from its shared STX to a less loaded one.  The
+ * endpoint is recreated, since an endpoint cannot be rebound to another STX.
+ * Returns nonzero if the context moved.  Called with
+ * shmem_transport_ofi_lock held. */
+static
+int shmem_transport_ofi_stx_rebalance(shmem_transport_ctx_t *ctx)
+{
+    shmem_transport_ofi_stx_t *cur = &shmem_transport_ofi_stx_pool[ctx->stx_idx];
+    uint64_t cur_ops = __atomic_load_n(&cur->ops, __ATOMIC_RELAXED);
+    uint64_t ctx_ops = ctx->stx_credited - ctx->stx_check_credited;
+    uint64_t stx_ops = cur_ops - ctx->stx_check_ops;
+    uint64_t ctx_load;
+    int best = -1, i, ret;
+
+    ctx->stx_check_ops      = cur_ops;
+    ctx->stx_check_credited = ctx->stx_credited;
+
+    if (cur->is_private || cur->ref_cnt <= 1 || stx_ops == 0)
+        return 0;
+
+    shmem_transport_ofi_stx_sample_load();
+
+    /* This context's share of the load on its STX, by its fraction of the
+     * operations the STX carried since the last check.  That share moves
+     * with the context. */
+    ctx_load = (uint64_t) ((double) cur->load * ctx_ops / stx_ops);
+
+    for (i = 0; i < shmem_transport_ofi_stx_max; i++) {
+        shmem_transport_ofi_stx_t *stx = &shmem_transport_ofi_stx_pool[i];
+
+        /* Unused STXs stay available for private contexts */
+        if (i != ctx->stx_idx && stx->ref_cnt > 0 && !stx->is_private &&
+            (best < 0 || stx->load < shmem_transport_ofi_stx_pool[best].load))
+            best = i;
+    }
+
+    /* Move only when it cuts the higher of the two loads by at least a
+     * quarter, so that contexts do not bounce between similar STXs */
+    if (best < 0 || ctx_load == 0 ||
+        4 * (cur->load - ctx_load) > 3 * cur->load ||
+        4 * (shmem_transport_ofi_stx_pool[best].load + ctx_load) > 3 * cur->load)
+        return 0;
+
+    /* Only an idle context can move; outstanding operations would be lost
+     * with the endpoint */
+    if (SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr) != fi_cntr_read(ctx->put_cntr) ||
+        SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr) != fi_cntr_read(ctx->get_cntr) ||
+        shmem_internal_cntr_read(&ctx->pending_bb_cntr) != shmem_internal_cntr_read(&ctx->completed_bb_cntr))
+        return 0;
+
+    DEBUG_MSG("id = %d, moving from STX %d (load %"PRIu64") to STX %d (load %"PRIu64")\n",
+              ctx->id, ctx->stx_idx, cur->load, best,
+              shmem_transport_ofi_stx_pool[best].load);
+
+    ret = fi_close(&ctx->ep->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Context endpoint close failed (%s)\n", fi_strerror(errno));
+
+    shmem_transport_ofi_set_ep_info(shmem_transport_ofi_info.p_info);
+    ret = fi_endpoint(shmem_transport_ofi_domainfd, shmem_transport_ofi_info.p_info,
+                      &ctx->ep, NULL);
+    OFI_CHECK_ERROR_MSG(ret, "ep creation failed (%s)\n", fi_strerror(errno));
+
+    cur->ref_cnt--;
+    shmem_transport_ofi_stx_pool[best].ref_cnt++;
+    ctx->stx_idx = best;
+    ctx->stx_check_ops = __atomic_load_n(&shmem_transport_ofi_stx_pool[best].ops,
+                                         __ATOMIC_RELAXED);
+
+    ret = bind_enable_ep_resources(ctx);
+    OFI_CHECK_ERROR_MSG(ret, "context bind/enable endpoint failed (%s)\n", fi_strerror(errno));
+
+    shmem_transport_ofi_dump_stx();
+
+    return 1;
+}
+
+void shmem_transport_ofi_stx_credit(shmem_transport_ctx_t *ctx)
+{
+    uint64_t issued, credited;
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+    issued = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr) +
+             SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr);
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+    credited = __atomic_exchange_n(&ctx->stx_credited, issued, __ATOMIC_RELAXED);
+    if (issued > credited)
+        __atomic_fetch_add(&shmem_transport_ofi_stx_pool[ctx->stx_idx].ops,
+                           issued - credited, __ATOMIC_RELAXED);
+
+    /* The endpoint may only be replaced when no other thread can be using
+     * the context */
+    if (shmem_internal_params.OFI_STX_REBALANCE_INTERVAL > 0 &&
+        (shmem_internal_thread_level <= SHMEM_THREAD_SERIALIZED ||
+         (ctx->options & (SHMEM_CTX_PRIVATE | SHMEM_CTX_SERIALIZED))) &&
+        ++ctx->stx_quiet_cnt >= shmem_internal_params.OFI_STX_REBALANCE_INTERVAL)
+    {
+        ctx->stx_quiet_cnt = 0;
+        SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
+        shmem_transport_ofi_stx_rebalance(ctx);
+        SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
+    }
+}
 
+
+/* Register a symmetric segment for remote access, and the access given in
+ * local_access, in domain, binding cntr (if not NULL) to count incoming
+ * writes */
 static inline
-int allocate_recv_cntr_mr(void)
+int register_target_mr(struct fid_domain *domain, struct fid_cntr *cntr, int rma_event,
+                       void *base, size_t len, uint64_t key, uint64_t local_access,
+                       struct fid_mr **mrfd, const char *name)
 {
-    int ret = 0;
+    int ret;
     uint64_t flags = 0;
 
+#ifdef ENABLE_MR_RMA_EVENT
+    if (cntr != NULL && rma_event)
+        flags |= FI_RMA_EVENT;
+#endif
+
+    ret = fi_mr_reg(domain, base, len, FI_REMOTE_READ | FI_REMOTE_WRITE | local_access, 0,
+                    key, flags, mrfd, NULL);
+    OFI_CHECK_RETURN_MSG(ret, "target memory (%s) registration failed\n", name);
+
+    if (cntr == NULL)
+        return 0;
+
+    /* Bind counter with target memory region for incoming messages */
+    ret = fi_mr_bind(*mrfd, &cntr->fid, FI_REMOTE_WRITE);
+    OFI_CHECK_RETURN_MSG(ret, "target CNTR binding to %s MR failed\n", name);
+
+#ifdef ENABLE_MR_RMA_EVENT
+    if (rma_event) {
+        ret = fi_mr_enable(*mrfd);
+        OFI_CHECK_RETURN_MSG(ret, "target %s MR enable failed\n", name);
+    }
+#endif /* ENABLE_MR_RMA_EVENT */
+
+    return 0;
+}
+
+/* Open the target counter of a domain and register the symmetric segments.
+ * With scalable MRs and remote virtual addressing, the whole address space is
+ * registered as heap_mr.  Otherwise, the data and heap segments are registered
+ * separately, with their segment IDs as the requested keys.  In
+ * MR_BASIC_MODE, the keys are ignored and selected by the provider. */
+static inline
+int allocate_recv_cntr_mr_domain(struct fid_domain *domain, struct fid_cntr **cntrfd,
+                                 struct fid_mr **heap_mrfd, struct fid_mr **data_mrfd)
+{
+    int ret = 0;
+    struct fid_cntr *cntr = NULL;
+
     /* ------------------------------------ */
     /* POST enable resources for to EP      */
     /* ------------------------------------ */
@@ -640,222 +936,710 @@ int allocate_recv_cntr_mr(void)
         cntr_attr.events   = FI_CNTR_EVENTS_COMP;
         cntr_attr.wait_obj = FI_WAIT_UNSPEC;
 
-        ret = fi_cntr_open(shmem_transport_ofi_domainfd, &cntr_attr,
-                           &shmem_transport_ofi_target_cntrfd, NULL);
+        ret = fi_cntr_open(domain, &cntr_attr, cntrfd, NULL);
         OFI_CHECK_RETURN_STR(ret, "target CNTR open failed");
+        cntr = *cntrfd;
+    }
+#else
+    (void) cntrfd;
+#endif
 
 #ifdef ENABLE_MR_RMA_EVENT
-        if (shmem_transport_ofi_mr_rma_event)
-            flags |= FI_RMA_EVENT;
-#endif /* ENABLE_MR_RMA_EVENT */
-    }
+    const int rma_event = shmem_transport_ofi_mr_rma_event;
+#else
+    const int rma_event = 0;
 #endif
 
 #if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
-    ret = fi_mr_reg(shmem_transport_ofi_domainfd, 0, UINT64_MAX,
-                    FI_REMOTE_READ | FI_REMOTE_WRITE, 0, 0ULL, flags,
-                    &shmem_transport_ofi_target_mrfd, NULL);
-    OFI_CHECK_RETURN_STR(ret, "target memory (all) registration failed");
+    ret = register_target_mr(domain, cntr, rma_event, 0, UINT64_MAX, 0ULL, 0,
+                             heap_mrfd, "all");
+    (void) data_mrfd;
+#else
+    /* The segments are also registered for local access, so that their
+     * descriptors can be passed with transfers from and into them */
+    ret = register_target_mr(domain, cntr, rma_event, shmem_internal_heap_base,
+                             shmem_internal_heap_length, SHMEM_INTERNAL_SEG_HEAP,
+                             FI_READ | FI_WRITE, heap_mrfd, "heap");
+    if (ret != 0) return ret;
 
-    /* Bind counter with target memory region for incoming messages */
-#if ENABLE_TARGET_CNTR
-    ret = fi_mr_bind(shmem_transport_ofi_target_mrfd,
-                     &shmem_transport_ofi_target_cntrfd->fid,
-                     FI_REMOTE_WRITE);
-    OFI_CHECK_RETURN_STR(ret, "target CNTR binding to MR failed");
+    ret = register_target_mr(domain, cntr, rma_event, shmem_internal_data_base,
+                             shmem_internal_data_length, SHMEM_INTERNAL_SEG_DATA,
+                             FI_READ | FI_WRITE, data_mrfd, "data");
+#endif
 
-#ifdef ENABLE_MR_RMA_EVENT
-    if (shmem_transport_ofi_mr_rma_event) {
-        ret = fi_mr_enable(shmem_transport_ofi_target_mrfd);
-        OFI_CHECK_RETURN_STR(ret, "target MR enable failed");
-    }
-#endif /* ENABLE_MR_RMA_EVENT */
-#endif /* ENABLE_TARGET_CNTR */
+    return ret;
+}
+
+static inline
+int allocate_recv_cntr_mr(void)
+{
+#if ENABLE_TARGET_CNTR
+    struct fid_cntr **cntrfd = &shmem_transport_ofi_target_cntrfd;
+#else
+    struct fid_cntr **cntrfd = NULL;
+#endif
 
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+    return allocate_recv_cntr_mr_domain(shmem_transport_ofi_domainfd, cntrfd,
+                                        &shmem_transport_ofi_target_mrfd, NULL);
 #else
-    /* Register separate data and heap segments using keys 0 and 1,
-     * respectively.  In MR_BASIC_MODE, the keys are ignored and selected by
-     * the provider. */
-    ret = fi_mr_reg(shmem_transport_ofi_domainfd, shmem_internal_heap_base,
-                    shmem_internal_heap_length,
-                    FI_REMOTE_READ | FI_REMOTE_WRITE, 0, 1ULL, flags,
-                    &shmem_transport_ofi_target_heap_mrfd, NULL);
-    OFI_CHECK_RETURN_STR(ret, "target memory (heap) registration failed");
-
-    ret = fi_mr_reg(shmem_transport_ofi_domainfd, shmem_internal_data_base,
-                    shmem_internal_data_length,
-                    FI_REMOTE_READ | FI_REMOTE_WRITE, 0, 0ULL, flags,
-                    &shmem_transport_ofi_target_data_mrfd, NULL);
-    OFI_CHECK_RETURN_STR(ret, "target memory (data) registration failed");
+    int ret = allocate_recv_cntr_mr_domain(shmem_transport_ofi_domainfd, cntrfd,
+                                           &shmem_transport_ofi_target_heap_mrfd,
+                                           &shmem_transport_ofi_target_data_mrfd);
+    if (ret != 0) return ret;
 
-    /* Bind counter with target memory region for incoming messages */
-#if ENABLE_TARGET_CNTR
-    ret = fi_mr_bind(shmem_transport_ofi_target_heap_mrfd,
-                     &shmem_transport_ofi_target_cntrfd->fid,
-                     FI_REMOTE_WRITE);
-    OFI_CHECK_RETURN_STR(ret, "target CNTR binding to heap MR failed");
+    shmem_transport_ofi_heap_desc = fi_mr_desc(shmem_transport_ofi_target_heap_mrfd);
+    shmem_transport_ofi_data_desc = fi_mr_desc(shmem_transport_ofi_target_data_mrfd);
+
+    return 0;
+#endif
+}
 
-    ret = fi_mr_bind(shmem_transport_ofi_target_data_mrfd,
-                     &shmem_transport_ofi_target_cntrfd->fid,
-                     FI_REMOTE_WRITE);
-    OFI_CHECK_RETURN_STR(ret, "target CNTR binding to data MR failed");
+#ifdef USE_MR_CACHE_MONITOR
+/* Local registration cache.  Each context caches the registrations of the
+ * local buffers used by its large transfers.  Entries cover disjoint,
+ * page-aligned ranges and are kept sorted by address, so a lookup is a binary
+ * search; a buffer that overlaps existing entries replaces them with one
+ * entry covering their union.  When the cache is full, the least recently
+ * used idle entry is evicted.  Registrations are closed only after a quiet on
+ * the context, since operations issued with them may still be outstanding.
+ *
+ * Entries are invalidated when their memory is unmapped, released with
+ * madvise, or remapped.  The ranges are registered with a userfaultfd in
+ * write-protect mode, without ever write-protecting a page, so the only
+ * messages are these events.  A monitor thread waits for them, and lookups
+ * also drain any that are pending before searching a cache; events are read
+ * and applied under the cache list lock, so an unmapped range can never be
+ * found in a cache once its event has been read.  Only entries are unlinked
+ * there; the registrations are closed by the context's threads, which never
+ * hold a cache lock across a libfabric call. */
+struct shmem_transport_ofi_mr_entry_t {
+    uintptr_t                           base;
+    uintptr_t                           end;
+    struct fid_mr                      *mr;
+    void                               *desc;
+    uint64_t                            last_use;
+    long                                inuse;
+    int                                 invalid;
+    shmem_transport_ofi_mr_cache_t     *cache;
+    shmem_transport_ofi_mr_entry_t     *next;
+};
 
-#ifdef ENABLE_MR_RMA_EVENT
-    if (shmem_transport_ofi_mr_rma_event) {
-        ret = fi_mr_enable(shmem_transport_ofi_target_data_mrfd);
-        OFI_CHECK_RETURN_STR(ret, "target data MR enable failed");
+struct shmem_transport_ofi_mr_cache_t {
+    pthread_mutex_t                     lock;
+    shmem_transport_ofi_mr_entry_t    **entries;
+    long                                nentries;
+    uint64_t                            tick;
+    /* Invalidated entries that are no longer in use, to be closed */
+    shmem_transport_ofi_mr_entry_t     *dead;
+    uint64_t                            hits;
+    uint64_t                            misses;
+    uint64_t                            evictions;
+    uint64_t                            invalidations;
+    shmem_transport_ofi_mr_cache_t     *next;
+};
+
+static int                              shmem_transport_ofi_uffd = -1;
+static int                              shmem_transport_ofi_mr_monitor_pipe[2] = { -1, -1 };
+static pthread_t                        shmem_transport_ofi_mr_monitor_thread;
+static pthread_mutex_t                  shmem_transport_ofi_mr_cache_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static shmem_transport_ofi_mr_cache_t  *shmem_transport_ofi_mr_cache_list = NULL;
+/* Number of invalidation events seen by the monitor */
+static uint64_t                         shmem_transport_ofi_mr_cache_epoch = 0;
+static uint64_t                         shmem_transport_ofi_mr_cache_key = SHMEM_INTERNAL_NSEG;
+static uintptr_t                        shmem_transport_ofi_page_mask;
+
+/* Index of the first entry that ends after addr */
+static inline
+long shmem_transport_ofi_mr_cache_search(shmem_transport_ofi_mr_cache_t *cache, uintptr_t addr)
+{
+    long lo = 0, hi = cache->nentries;
 
-        ret = fi_mr_enable(shmem_transport_ofi_target_heap_mrfd);
-        OFI_CHECK_RETURN_STR(ret, "target heap MR enable failed");
+    while (lo < hi) {
+        long mid = (lo + hi) / 2;
+
+        if (cache->entries[mid]->end <= addr)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-#endif /* ENABLE_MR_RMA_EVENT */
-#endif /* ENABLE_TARGET_CNTR */
-#endif
 
-    return ret;
+    return lo;
 }
 
-static
-int publish_mr_info(void)
+static inline
+void shmem_transport_ofi_mr_cache_remove(shmem_transport_ofi_mr_cache_t *cache, long i, long j)
 {
-#ifndef ENABLE_MR_SCALABLE
-    {
-        int err;
-        uint64_t heap_key, data_key;
+    memmove(&cache->entries[i], &cache->entries[j],
+            (cache->nentries - j) * sizeof(shmem_transport_ofi_mr_entry_t *));
+    cache->nentries -= j - i;
+}
 
-        if (shmem_transport_ofi_info.p_info->domain_attr->mr_mode & FI_MR_PROV_KEY) {
-            heap_key = fi_mr_key(shmem_transport_ofi_target_heap_mrfd);
-            data_key = fi_mr_key(shmem_transport_ofi_target_data_mrfd);
-        } else {
-            heap_key = 1ULL;
-            data_key = 0ULL;
-        }
+static inline
+void shmem_transport_ofi_mr_cache_close(shmem_transport_ofi_mr_entry_t *e)
+{
+    while (e != NULL) {
+        shmem_transport_ofi_mr_entry_t *next = e->next;
+        int ret = fi_close(&e->mr->fid);
+        OFI_CHECK_ERROR_MSG(ret, "Local MR close failed (%s)\n", fi_strerror(errno));
+        free(e);
+        e = next;
+    }
+}
 
-        err = shmem_runtime_put("fi_heap_key", &heap_key, sizeof(uint64_t));
-        if (err) {
-            RAISE_WARN_STR("Put of heap key to runtime KVS failed");
-            return 1;
-        }
+/* Called with the cache list lock held */
+static void shmem_transport_ofi_mr_cache_invalidate(uintptr_t start, uintptr_t end)
+{
+    shmem_transport_ofi_mr_cache_t *cache;
 
-        err = shmem_runtime_put("fi_data_key", &data_key, sizeof(uint64_t));
-        if (err) {
-            RAISE_WARN_STR("Put of data segment key to runtime KVS failed");
-            return 1;
+    __atomic_fetch_add(&shmem_transport_ofi_mr_cache_epoch, 1, __ATOMIC_ACQ_REL);
+
+    for (cache = shmem_transport_ofi_mr_cache_list; cache != NULL; cache = cache->next) {
+        long i, j;
+
+        pthread_mutex_lock(&cache->lock);
+        i = j = shmem_transport_ofi_mr_cache_search(cache, start);
+        for ( ; j < cache->nentries && cache->entries[j]->base < end; j++) {
+            shmem_transport_ofi_mr_entry_t *e = cache->entries[j];
+
+            e->invalid = 1;
+            if (e->inuse == 0) {
+                e->next = cache->dead;
+                cache->dead = e;
+            }
+            cache->invalidations++;
         }
+        shmem_transport_ofi_mr_cache_remove(cache, i, j);
+        pthread_mutex_unlock(&cache->lock);
     }
+}
 
-#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-    if (shmem_transport_ofi_info.p_info->domain_attr->mr_mode & FI_MR_VIRT_ADDR)
-        shmem_transport_ofi_use_absolute_address = 1;
-    else
-        shmem_transport_ofi_use_absolute_address = 0;
-#else /* !ENABLE_REMOTE_VIRTUAL_ADDRESSING */
-    {
-        int err;
-        void *heap_base, *data_base;
+/* Read and apply all pending userfaultfd events.  Called with the cache list
+ * lock held, the descriptor is nonblocking. */
+static void shmem_transport_ofi_mr_monitor_drain(void)
+{
+    struct uffd_msg msgs[16];
 
-        if (shmem_transport_ofi_info.p_info->domain_attr->mr_mode & FI_MR_VIRT_ADDR) {
-            heap_base = shmem_internal_heap_base;
-            data_base = shmem_internal_data_base;
-        } else {
-            heap_base = (void *) 0;
-            data_base = (void *) 0;
-        }
+    for (;;) {
+        ssize_t nread;
+        int i;
 
-        err = shmem_runtime_put("fi_heap_addr", &heap_base, sizeof(uint8_t*));
-        if (err) {
-            RAISE_WARN_STR("Put of heap address to runtime KVS failed");
-            return 1;
-        }
+        nread = read(shmem_transport_ofi_uffd, msgs, sizeof(msgs));
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            break;
 
-        err = shmem_runtime_put("fi_data_addr", &data_base, sizeof(uint8_t*));
-        if (err) {
-            RAISE_WARN_STR("Put of data segment address to runtime KVS failed");
-            return 1;
+        for (i = 0; i < (int) (nread / sizeof(struct uffd_msg)); i++) {
+            switch (msgs[i].event) {
+                case UFFD_EVENT_UNMAP:
+                case UFFD_EVENT_REMOVE:
+                    shmem_transport_ofi_mr_cache_invalidate(msgs[i].arg.remove.start,
+                                                            msgs[i].arg.remove.end);
+                    break;
+                case UFFD_EVENT_REMAP:
+                    shmem_transport_ofi_mr_cache_invalidate(msgs[i].arg.remap.from,
+                                                            msgs[i].arg.remap.from +
+                                                            msgs[i].arg.remap.len);
+                    break;
+                case UFFD_EVENT_PAGEFAULT:
+                    {
+                        /* Pages are never write-protected, but do not leave a
+                         * faulting thread blocked */
+                        struct uffdio_writeprotect wp = {
+                            .range = { .start = msgs[i].arg.pagefault.address &
+                                                ~shmem_transport_ofi_page_mask,
+                                       .len   = shmem_transport_ofi_page_mask + 1 },
+                            .mode  = 0 };
+                        ioctl(shmem_transport_ofi_uffd, UFFDIO_WRITEPROTECT, &wp);
+                    }
+                    break;
+                default:
+                    break;
+            }
         }
     }
-#endif /* ENABLE_REMOTE_VIRTUAL_ADDRESSING */
-#endif /* !ENABLE_MR_SCALABLE */
+}
 
-    return 0;
+/* Lock a cache after applying any pending invalidations, so that its entries
+ * cover memory that is still mapped */
+static inline
+void shmem_transport_ofi_mr_cache_lock(shmem_transport_ofi_mr_cache_t *cache)
+{
+    pthread_mutex_lock(&shmem_transport_ofi_mr_cache_list_lock);
+    shmem_transport_ofi_mr_monitor_drain();
+    pthread_mutex_lock(&cache->lock);
+    pthread_mutex_unlock(&shmem_transport_ofi_mr_cache_list_lock);
 }
 
-static
-int populate_mr_tables(void)
+void *shmem_transport_ofi_mr_cache_acquire(shmem_transport_ctx_t *ctx, const void *addr,
+                                           size_t len, shmem_transport_ofi_mr_entry_t **entry)
 {
-#ifndef ENABLE_MR_SCALABLE
-    {
-        int i, err;
+    shmem_transport_ofi_mr_cache_t *cache = ctx->mr_cache;
+    shmem_transport_ofi_mr_entry_t *e, *retired = NULL, *dead;
+    uintptr_t base = (uintptr_t) addr & ~shmem_transport_ofi_page_mask;
+    uintptr_t end = ((uintptr_t) addr + len + shmem_transport_ofi_page_mask) &
+                    ~shmem_transport_ofi_page_mask;
+    long i, j, k, victim = -1;
+    uint64_t epoch;
+    int ret;
 
-        shmem_transport_ofi_target_heap_keys = malloc(sizeof(uint64_t) * shmem_internal_num_pes);
-        if (NULL == shmem_transport_ofi_target_heap_keys) {
-            RAISE_WARN_STR("Out of memory allocating heap keytable");
-            return 1;
-        }
+    shmem_transport_ofi_mr_cache_lock(cache);
+    dead = cache->dead;
+    cache->dead = NULL;
+
+    i = shmem_transport_ofi_mr_cache_search(cache, base);
+    if (i < cache->nentries && cache->entries[i]->base <= base &&
+        cache->entries[i]->end >= end) {
+        e = cache->entries[i];
+        e->inuse++;
+        e->last_use = ++cache->tick;
+        cache->hits++;
+        pthread_mutex_unlock(&cache->lock);
+
+        shmem_transport_ofi_mr_cache_close(dead);
+        *entry = e;
+        return e->desc;
+    }
 
-        shmem_transport_ofi_target_data_keys = malloc(sizeof(uint64_t) * shmem_internal_num_pes);
-        if (NULL == shmem_transport_ofi_target_data_keys) {
-            RAISE_WARN_STR("Out of memory allocating heap keytable");
-            return 1;
-        }
+    cache->misses++;
 
-        /* Called after the upper layer performs the runtime exchange */
-        for (i = 0; i < shmem_internal_num_pes; i++) {
-            err = shmem_runtime_get(i, "fi_heap_key",
-                                    &shmem_transport_ofi_target_heap_keys[i],
-                                    sizeof(uint64_t));
-            if (err) {
-                RAISE_WARN_STR("Get of heap key from runtime KVS failed");
-                return 1;
-            }
-            err = shmem_runtime_get(i, "fi_data_key",
-                                    &shmem_transport_ofi_target_data_keys[i],
-                                    sizeof(uint64_t));
-            if (err) {
-                RAISE_WARN_STR("Get of data segment key from runtime KVS failed");
-                return 1;
-            }
+    /* Take over the overlapping entries, which must be idle */
+    for (j = i; j < cache->nentries && cache->entries[j]->base < end; j++) {
+        if (cache->entries[j]->inuse) {
+            pthread_mutex_unlock(&cache->lock);
+            shmem_transport_ofi_mr_cache_close(dead);
+            return NULL;
         }
+        base = MIN(base, cache->entries[j]->base);
+        end = (cache->entries[j]->end > end) ? cache->entries[j]->end : end;
     }
 
-#ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-    {
-        int i, err;
-
-        shmem_transport_ofi_target_heap_addrs = malloc(sizeof(uint8_t*) * shmem_internal_num_pes);
-        if (NULL == shmem_transport_ofi_target_heap_addrs) {
-            RAISE_WARN_STR("Out of memory allocating heap addrtable");
-            return 1;
+    if (cache->nentries - (j - i) >= shmem_transport_ofi_mr_cache_size) {
+        for (k = 0; k < cache->nentries; k++) {
+            if ((k < i || k >= j) && cache->entries[k]->inuse == 0 &&
+                (victim < 0 || cache->entries[k]->last_use < cache->entries[victim]->last_use))
+                victim = k;
         }
 
-        shmem_transport_ofi_target_data_addrs = malloc(sizeof(uint8_t*) * shmem_internal_num_pes);
-        if (NULL == shmem_transport_ofi_target_data_addrs) {
-            RAISE_WARN_STR("Out of memory allocating data addrtable");
-            return 1;
+        if (victim < 0) {
+            pthread_mutex_unlock(&cache->lock);
+            shmem_transport_ofi_mr_cache_close(dead);
+            return NULL;
         }
 
-        /* Called after the upper layer performs the runtime exchange */
-        for (i = 0; i < shmem_internal_num_pes; i++) {
-            err = shmem_runtime_get(i, "fi_heap_addr",
-                                    &shmem_transport_ofi_target_heap_addrs[i],
-                                    sizeof(uint8_t*));
-            if (err) {
-                RAISE_WARN_STR("Get of heap address from runtime KVS failed");
-                return 1;
-            }
-            err = shmem_runtime_get(i, "fi_data_addr",
-                                    &shmem_transport_ofi_target_data_addrs[i],
-                                    sizeof(uint8_t*));
-            if (err) {
-                RAISE_WARN_STR("Get of data segment address from runtime KVS failed");
-                return 1;
-            }
-        }
+        cache->evictions++;
     }
-#endif /* ENABLE_REMOTE_VIRTUAL_ADDRESSING */
-#endif /* !ENABLE_MR_SCALABLE */
 
-    return 0;
+    for (k = i; k < j; k++) {
+        cache->entries[k]->next = retired;
+        retired = cache->entries[k];
+    }
+
+    if (victim >= 0) {
+        cache->entries[victim]->next = retired;
+        retired = cache->entries[victim];
+    }
+
+    if (victim > j) {
+        shmem_transport_ofi_mr_cache_remove(cache, victim, victim + 1);
+        shmem_transport_ofi_mr_cache_remove(cache, i, j);
+    } else {
+        shmem_transport_ofi_mr_cache_remove(cache, i, j);
+        if (victim >= 0)
+            shmem_transport_ofi_mr_cache_remove(cache, victim, victim + 1);
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    shmem_transport_ofi_mr_cache_close(dead);
+
+    if (retired) {
+        shmem_transport_quiet(ctx);
+        shmem_transport_ofi_mr_cache_close(retired);
+    }
+
+    e = calloc(1, sizeof(shmem_transport_ofi_mr_entry_t));
+    if (e == NULL) {
+        RAISE_ERROR_STR("Out of memory when allocating local MR cache entry");
+    }
+
+    e->base  = base;
+    e->end   = end;
+    e->cache = cache;
+    e->inuse = 1;
+
+    /* Watch the range before registering it, so that an unmap in between is
+     * seen through the epoch */
+    epoch = __atomic_load_n(&shmem_transport_ofi_mr_cache_epoch, __ATOMIC_ACQUIRE);
+
+    struct uffdio_register reg = { .range = { .start = base, .len = end - base },
+                                   .mode  = UFFDIO_REGISTER_MODE_WP };
+    if (ioctl(shmem_transport_ofi_uffd, UFFDIO_REGISTER, &reg)) {
+        DEBUG_MSG("Not caching local buffer [%p, %p), cannot monitor it (%s)\n",
+                  (void *) base, (void *) end, strerror(errno));
+        free(e);
+        return NULL;
+    }
+
+    ret = fi_mr_reg(shmem_transport_ofi_domainfd, (void *) base, end - base,
+                    FI_READ | FI_WRITE, 0,
+                    __atomic_fetch_add(&shmem_transport_ofi_mr_cache_key, 1, __ATOMIC_RELAXED),
+                    0, &e->mr, NULL);
+    if (ret) {
+        DEBUG_MSG("Local buffer [%p, %p) registration failed (%s)\n",
+                  (void *) base, (void *) end, fi_strerror(-ret));
+        free(e);
+        return NULL;
+    }
+
+    e->desc = fi_mr_desc(e->mr);
+
+    shmem_transport_ofi_mr_cache_lock(cache);
+    e->last_use = ++cache->tick;
+    i = shmem_transport_ofi_mr_cache_search(cache, base);
+
+    /* Another thread may have cached an overlapping range, or the range may
+     * have been unmapped, while the lock was dropped.  The registration is
+     * then used for this transfer only. */
+    if (epoch != __atomic_load_n(&shmem_transport_ofi_mr_cache_epoch, __ATOMIC_ACQUIRE) ||
+        cache->nentries >= shmem_transport_ofi_mr_cache_size ||
+        (i < cache->nentries && cache->entries[i]->base < end)) {
+        e->invalid = 1;
+    } else {
+        memmove(&cache->entries[i + 1], &cache->entries[i],
+                (cache->nentries - i) * sizeof(shmem_transport_ofi_mr_entry_t *));
+        cache->entries[i] = e;
+        cache->nentries++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    *entry = e;
+    return e->desc;
+}
+
+void shmem_transport_ofi_mr_cache_release(shmem_transport_ofi_mr_entry_t *e)
+{
+    shmem_transport_ofi_mr_cache_t *cache = e->cache;
+
+    pthread_mutex_lock(&cache->lock);
+    if (--e->inuse == 0 && e->invalid) {
+        e->next = cache->dead;
+        cache->dead = e;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static
+int shmem_transport_ofi_mr_cache_create(shmem_transport_ctx_t *ctx)
+{
+    shmem_transport_ofi_mr_cache_t *cache = calloc(1, sizeof(shmem_transport_ofi_mr_cache_t));
+
+    if (cache == NULL) {
+        RAISE_ERROR_STR("Out of memory when allocating local MR cache");
+    }
+
+    cache->entries = malloc(shmem_transport_ofi_mr_cache_size * sizeof(shmem_transport_ofi_mr_entry_t *));
+    if (cache->entries == NULL) {
+        RAISE_ERROR_STR("Out of memory when allocating local MR cache");
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+
+    pthread_mutex_lock(&shmem_transport_ofi_mr_cache_list_lock);
+    cache->next = shmem_transport_ofi_mr_cache_list;
+    shmem_transport_ofi_mr_cache_list = cache;
+    pthread_mutex_unlock(&shmem_transport_ofi_mr_cache_list_lock);
+
+    ctx->mr_cache = cache;
+
+    return 0;
+}
+
+static
+void shmem_transport_ofi_mr_cache_destroy(shmem_transport_ctx_t *ctx)
+{
+    shmem_transport_ofi_mr_cache_t *cache = ctx->mr_cache, **prev;
+    long i;
+
+    pthread_mutex_lock(&shmem_transport_ofi_mr_cache_list_lock);
+    for (prev = &shmem_transport_ofi_mr_cache_list; *prev != cache; prev = &(*prev)->next)
+        ;
+    *prev = cache->next;
+    pthread_mutex_unlock(&shmem_transport_ofi_mr_cache_list_lock);
+
+    DEBUG_MSG("id = %d, local MR cache: entries = %ld, hits = %"PRIu64", misses = %"PRIu64
+              ", evictions = %"PRIu64", invalidations = %"PRIu64"\n",
+              ctx->id, cache->nentries, cache->hits, cache->misses,
+              cache->evictions, cache->invalidations);
+
+    for (i = 0; i < cache->nentries; i++) {
+        cache->entries[i]->next = cache->dead;
+        cache->dead = cache->entries[i];
+    }
+    shmem_transport_ofi_mr_cache_close(cache->dead);
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->entries);
+    free(cache);
+    ctx->mr_cache = NULL;
+}
+
+static void * shmem_transport_ofi_mr_monitor_func(void *arg)
+{
+    struct pollfd fds[2] = { { .fd = shmem_transport_ofi_uffd, .events = POLLIN },
+                             { .fd = shmem_transport_ofi_mr_monitor_pipe[0], .events = POLLIN } };
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            RAISE_WARN_MSG("Local MR monitor poll failed (%s)\n", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents)
+            break;
+
+        /* A lookup may have drained the events already */
+        pthread_mutex_lock(&shmem_transport_ofi_mr_cache_list_lock);
+        shmem_transport_ofi_mr_monitor_drain();
+        pthread_mutex_unlock(&shmem_transport_ofi_mr_cache_list_lock);
+    }
+
+    return NULL;
+}
+
+static int shmem_transport_ofi_mr_monitor_start(void)
+{
+    struct uffdio_api api = { .api      = UFFD_API,
+                              .features = UFFD_FEATURE_EVENT_UNMAP | UFFD_FEATURE_EVENT_REMOVE |
+                                          UFFD_FEATURE_EVENT_REMAP | UFFD_FEATURE_PAGEFAULT_FLAG_WP };
+    int ret;
+
+    shmem_transport_ofi_page_mask = (uintptr_t) sysconf(_SC_PAGESIZE) - 1;
+
+    shmem_transport_ofi_uffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+#ifdef UFFD_USER_MODE_ONLY
+    if (shmem_transport_ofi_uffd < 0 && errno == EPERM)
+        shmem_transport_ofi_uffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+#endif
+    if (shmem_transport_ofi_uffd < 0) {
+        RAISE_WARN_MSG("userfaultfd unavailable (%s)\n", strerror(errno));
+        return 1;
+    }
+
+    if (ioctl(shmem_transport_ofi_uffd, UFFDIO_API, &api)) {
+        RAISE_WARN_MSG("userfaultfd unmap events unsupported (%s)\n", strerror(errno));
+        goto err;
+    }
+
+    if (pipe(shmem_transport_ofi_mr_monitor_pipe)) {
+        RAISE_WARN_MSG("Local MR monitor pipe creation failed (%s)\n", strerror(errno));
+        goto err;
+    }
+
+    ret = pthread_create(&shmem_transport_ofi_mr_monitor_thread, NULL,
+                         &shmem_transport_ofi_mr_monitor_func, NULL);
+    if (ret != 0) {
+        RAISE_WARN_MSG("Local MR monitor thread creation failed (%s)\n", strerror(ret));
+        close(shmem_transport_ofi_mr_monitor_pipe[0]);
+        close(shmem_transport_ofi_mr_monitor_pipe[1]);
+        goto err;
+    }
+
+    DEBUG_MSG("Local MR cache enabled, %ld entries per context\n",
+              shmem_transport_ofi_mr_cache_size);
+
+    return 0;
+
+err:
+    close(shmem_transport_ofi_uffd);
+    shmem_transport_ofi_uffd = -1;
+    return 1;
+}
+
+static void shmem_transport_ofi_mr_monitor_stop(void)
+{
+    const char c = 0;
+    void *monitor_out;
+
+    if (write(shmem_transport_ofi_mr_monitor_pipe[1], &c, 1) != 1)
+        RAISE_WARN_MSG("Local MR monitor wakeup failed (%s)\n", strerror(errno));
+    pthread_join(shmem_transport_ofi_mr_monitor_thread, &monitor_out);
+
+    close(shmem_transport_ofi_mr_monitor_pipe[0]);
+    close(shmem_transport_ofi_mr_monitor_pipe[1]);
+    /* Closing the userfaultfd unregisters all of its ranges */
+    close(shmem_transport_ofi_uffd);
+    shmem_transport_ofi_uffd = -1;
+}
+
+#else /* !USE_MR_CACHE_MONITOR */
+
+void *shmem_transport_ofi_mr_cache_acquire(shmem_transport_ctx_t *ctx, const void *addr,
+                                           size_t len, shmem_transport_ofi_mr_entry_t **entry)
+{
+    return NULL;
+}
+
+void shmem_transport_ofi_mr_cache_release(shmem_transport_ofi_mr_entry_t *entry)
+{
+    return;
+}
+#endif /* USE_MR_CACHE_MONITOR */
+
+static
+int publish_mr_info(void)
+{
+#ifndef ENABLE_MR_SCALABLE
+    {
+        int err;
+        uint64_t heap_key, data_key;
+
+        if (shmem_transport_ofi_info.p_info->domain_attr->mr_mode & FI_MR_PROV_KEY) {
+            heap_key = fi_mr_key(shmem_transport_ofi_target_heap_mrfd);
+            data_key = fi_mr_key(shmem_transport_ofi_target_data_mrfd);
+        } else {
+            heap_key = 1ULL;
+            data_key = 0ULL;
+        }
+
+        err = shmem_runtime_put("fi_heap_key", &heap_key, sizeof(uint64_t));
+        if (err) {
+            RAISE_WARN_STR("Put of heap key to runtime KVS failed");
+            return 1;
+        }
+
+        err = shmem_runtime_put("fi_data_key", &data_key, sizeof(uint64_t));
+        if (err) {
+            RAISE_WARN_STR("Put of data segment key to runtime KVS failed");
+            return 1;
+        }
+    }
+
+#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
+    if (shmem_transport_ofi_info.p_info->domain_attr->mr_mode & FI_MR_VIRT_ADDR)
+        shmem_transport_ofi_use_absolute_address = 1;
+    else
+        shmem_transport_ofi_use_absolute_address = 0;
+#else /* !ENABLE_REMOTE_VIRTUAL_ADDRESSING */
+    {
+        int err;
+        void *heap_base, *data_base;
+
+        if (shmem_transport_ofi_info.p_info->domain_attr->mr_mode & FI_MR_VIRT_ADDR) {
+            heap_base = shmem_internal_heap_base;
+            data_base = shmem_internal_data_base;
+        } else {
+            heap_base = (void *) 0;
+            data_base = (void *) 0;
+        }
+
+        err = shmem_runtime_put("fi_heap_addr", &heap_base, sizeof(uint8_t*));
+        if (err) {
+            RAISE_WARN_STR("Put of heap address to runtime KVS failed");
+            return 1;
+        }
+
+        err = shmem_runtime_put("fi_data_addr", &data_base, sizeof(uint8_t*));
+        if (err) {
+            RAISE_WARN_STR("Put of data segment address to runtime KVS failed");
+            return 1;
+        }
+    }
+#endif /* ENABLE_REMOTE_VIRTUAL_ADDRESSING */
+#endif /* !ENABLE_MR_SCALABLE */
+
+    return 0;
+}
+
+/* Fetch the memory registration keys and base addresses of one PE from the
+ * runtime KVS */
+static
+int fetch_mr_info(int pe)
+{
+#ifndef ENABLE_MR_SCALABLE
+    shmem_transport_ofi_peer_mr_t *peer_mr = &shmem_transport_ofi_peer_mr[pe];
+
+    {
+        int err;
+
+        err = shmem_runtime_get(pe, "fi_heap_key",
+                                &peer_mr->key[SHMEM_INTERNAL_SEG_HEAP],
+                                sizeof(uint64_t));
+        if (err) {
+            RAISE_WARN_STR("Get of heap key from runtime KVS failed");
+            return 1;
+        }
+        err = shmem_runtime_get(pe, "fi_data_key",
+                                &peer_mr->key[SHMEM_INTERNAL_SEG_DATA],
+                                sizeof(uint64_t));
+        if (err) {
+            RAISE_WARN_STR("Get of data segment key from runtime KVS failed");
+            return 1;
+        }
+    }
+
+#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
+    if (shmem_transport_ofi_use_absolute_address) {
+        peer_mr->base[SHMEM_INTERNAL_SEG_HEAP] = shmem_internal_heap_base;
+        peer_mr->base[SHMEM_INTERNAL_SEG_DATA] = shmem_internal_data_base;
+    } else {
+        peer_mr->base[SHMEM_INTERNAL_SEG_HEAP] = NULL;
+        peer_mr->base[SHMEM_INTERNAL_SEG_DATA] = NULL;
+    }
+#else
+    {
+        int err;
+
+        err = shmem_runtime_get(pe, "fi_heap_addr",
+                                &peer_mr->base[SHMEM_INTERNAL_SEG_HEAP],
+                                sizeof(uint8_t*));
+        if (err) {
+            RAISE_WARN_STR("Get of heap address from runtime KVS failed");
+            return 1;
+        }
+        err = shmem_runtime_get(pe, "fi_data_addr",
+                                &peer_mr->base[SHMEM_INTERNAL_SEG_DATA],
+                                sizeof(uint8_t*));
+        if (err) {
+            RAISE_WARN_STR("Get of data segment address from runtime KVS failed");
+            return 1;
+        }
+    }
+#endif /* ENABLE_REMOTE_VIRTUAL_ADDRESSING */
+#endif /* !ENABLE_MR_SCALABLE */
+
+    return 0;
+}
+
+static
+int populate_mr_tables(void)
+{
+#ifndef ENABLE_MR_SCALABLE
+    int ret;
+
+    /* Two entries share a cache line; keep them from straddling one */
+    ret = posix_memalign((void **) &shmem_transport_ofi_peer_mr,
+                         SHMEM_INTERNAL_CACHELINE_SIZE,
+                         sizeof(shmem_transport_ofi_peer_mr_t) * shmem_internal_num_pes);
+    if (ret != 0) {
+        RAISE_WARN_STR("Out of memory allocating MR translation table");
+        return 1;
+    }
+
+    /* With lazy connection, entries are fetched on first use of each PE */
+    if (!shmem_transport_ofi_lazy_connect) {
+        int i;
+
+        /* Called after the upper layer performs the runtime exchange */
+        for (i = 0; i < shmem_internal_num_pes; i++) {
+            if (fetch_mr_info(i))
+                return 1;
+        }
+    }
+#endif /* !ENABLE_MR_SCALABLE */
+
+    return 0;
 }
 
 /* SOFT_SUPPORT will not produce warning or error */
@@ -1023,57 +1807,411 @@ int publish_av_info(struct fabric_info *info)
     char   epname[128];
     size_t epnamelen = sizeof(epname);
 
-    ret = fi_getname((fid_t)shmem_transport_ofi_target_ep, epname, &epnamelen);
-    if (ret != 0 || (epnamelen > sizeof(epname))) {
-        RAISE_WARN_STR("fi_getname failed");
-        return ret;
-    }
+    ret = fi_getname((fid_t)shmem_transport_ofi_target_ep, epname, &epnamelen);
+    if (ret != 0 || (epnamelen > sizeof(epname))) {
+        RAISE_WARN_STR("fi_getname failed");
+        return ret;
+    }
+
+    ret = shmem_runtime_put("fi_epname", epname, epnamelen);
+    OFI_CHECK_RETURN_STR(ret, "shmem_runtime_put fi_epname failed");
+
+    /* Note: we assume that the length of an address is the same for all
+     * endpoints.  This is safe for most HPC systems, but could be incorrect in
+     * a heterogeneous context. */
+    shmem_transport_ofi_addrlen = epnamelen;
+
+    return ret;
+}
+
+/* Fetch the address of one PE from the runtime KVS and insert it into the AV */
+static inline
+int fetch_av_info(int pe)
+{
+    int  ret;
+    char addr[128];
+
+    ret = shmem_runtime_get(pe, "fi_epname", addr, shmem_transport_ofi_addrlen);
+    if (ret != 0) {
+        RAISE_WARN_STR("Runtime get of 'fi_epname' failed");
+        return ret;
+    }
+
+    ret = fi_av_insert(shmem_transport_ofi_avfd, addr, 1, &addr_table[pe], 0, NULL);
+    if (ret != 1) {
+        RAISE_WARN_MSG("av insert for PE %d failed (%d)\n", pe, ret);
+        return 1;
+    }
+
+    return 0;
+}
+
+static inline
+int populate_av(void)
+{
+    int    i, ret, err = 0;
+    char   *alladdrs = NULL;
+
+    /* Addresses are inserted in the order that PEs are first used, so an
+     * address table is needed even with FI_AV_TABLE */
+    if (shmem_transport_ofi_lazy_connect) {
+        if (addr_table == NULL) {
+            addr_table = malloc(shmem_internal_num_pes * sizeof(fi_addr_t));
+            if (addr_table == NULL) {
+                RAISE_WARN_STR("Out of memory allocating address table");
+                return 1;
+            }
+        }
+
+        for (i = 0; i < shmem_internal_num_pes; i++)
+            addr_table[i] = FI_ADDR_NOTAVAIL;
+
+        shmem_transport_ofi_peer_ready = calloc(shmem_internal_num_pes, sizeof(uint8_t));
+        if (shmem_transport_ofi_peer_ready == NULL) {
+            RAISE_WARN_STR("Out of memory allocating peer table");
+            return 1;
+        }
+
+        return 0;
+    }
+
+    alladdrs = malloc(shmem_internal_num_pes * shmem_transport_ofi_addrlen);
+    if (alladdrs == NULL) {
+        RAISE_WARN_STR("Out of memory allocating 'alladdrs'");
+        return 1;
+    }
+
+    for (i = 0; i < shmem_internal_num_pes; i++) {
+        char *addr_ptr = alladdrs + i * shmem_transport_ofi_addrlen;
+        err = shmem_runtime_get(i, "fi_epname", addr_ptr, shmem_transport_ofi_addrlen);
+        if (err != 0) {
+            RAISE_ERROR_STR("Runtime get of 'fi_epname' failed");
+        }
+    }
+
+    ret = fi_av_insert(shmem_transport_ofi_avfd,
+                       alladdrs,
+                       shmem_internal_num_pes,
+                       addr_table,
+                       0,
+                       NULL);
+    if (ret != shmem_internal_num_pes) {
+        RAISE_WARN_STR("av insert failed");
+        return ret;
+    }
+
+    free(alladdrs);
+
+    return 0;
+}
+
+/* Choose the fabric info of each additional rail.  A rail uses the first
+ * domain of the primary provider and address format that is not already in
+ * use, or another instance of the primary domain when there is none left. */
+static
+int query_for_rails(struct fabric_info *info)
+{
+    struct fi_info *cur;
+    int r, i;
+
+    shmem_transport_ofi_rails = calloc(shmem_transport_ofi_num_rails,
+                                       sizeof(shmem_transport_ofi_rail_t));
+    if (shmem_transport_ofi_rails == NULL) {
+        RAISE_WARN_STR("Out of memory allocating rail table");
+        return 1;
+    }
+
+    for (r = 1; r < shmem_transport_ofi_num_rails; r++) {
+        shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[r];
+        struct fi_info *pick = NULL;
+
+        for (cur = info->fabrics; cur != NULL && pick == NULL; cur = cur->next) {
+            if (strcmp(cur->fabric_attr->prov_name, info->p_info->fabric_attr->prov_name) ||
+                cur->addr_format != info->p_info->addr_format ||
+                !strcmp(cur->domain_attr->name, info->p_info->domain_attr->name))
+                continue;
+
+            for (i = 1; i < r; i++)
+                if (!strcmp(shmem_transport_ofi_rails[i].info->domain_attr->name,
+                            cur->domain_attr->name))
+                    break;
+
+            if (i == r)
+                pick = cur;
+        }
+
+        if (pick == NULL)
+            pick = info->p_info;
+
+        rail->info = fi_dupinfo(pick);
+        if (rail->info == NULL) {
+            RAISE_WARN_STR("Out of memory duplicating rail fabric info");
+            return 1;
+        }
+
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+        rail->info->domain_attr->mr_key_size = 0;
+#else
+        if (rail->info->domain_attr->mr_mode & FI_MR_PROV_KEY)
+            rail->info->domain_attr->mr_key_size = 1;
+        else
+            rail->info->domain_attr->mr_key_size = 0;
+#endif
+
+        rail->max_msg_size = rail->info->ep_attr->max_msg_size > 0 ?
+                             rail->info->ep_attr->max_msg_size :
+                             shmem_transport_ofi_max_msg_size;
+
+        DEBUG_MSG("OFI rail %d: fabric: %s, domain: %s%s\n", r,
+                  rail->info->fabric_attr->name, rail->info->domain_attr->name,
+                  pick == info->p_info ? " (shared with rail 0)" : "");
+    }
+
+    return 0;
+}
+
+/* Open the domain of an additional rail, with its address vector and target
+ * endpoint, and register the symmetric segments with it */
+static
+int allocate_rail_resources(shmem_transport_ofi_rail_t *rail)
+{
+    int ret, i;
+    struct fi_av_attr av_attr = {0};
+    struct fi_cq_attr cq_attr = {0};
+    struct fi_info *info = rail->info;
+
+    ret = fi_fabric(info->fabric_attr, &rail->fabric, NULL);
+    OFI_CHECK_RETURN_STR(ret, "rail fabric initialization failed");
+
+    ret = fi_domain(rail->fabric, info, &rail->domain, NULL);
+    OFI_CHECK_RETURN_STR(ret, "rail domain initialization failed");
+
+#ifdef USE_AV_MAP
+    av_attr.type = FI_AV_MAP;
+#else
+    av_attr.type = FI_AV_TABLE;
+#endif
+    ret = fi_av_open(rail->domain, &av_attr, &rail->av, NULL);
+    OFI_CHECK_RETURN_STR(ret, "rail AV creation failed");
+
+    /* Peers may be inserted out of order, so the table is always used */
+    rail->addr_table = malloc(shmem_internal_num_pes * sizeof(fi_addr_t));
+    if (rail->addr_table == NULL) {
+        RAISE_WARN_STR("Out of memory allocating rail address table");
+        return 1;
+    }
+    for (i = 0; i < shmem_internal_num_pes; i++)
+        rail->addr_table[i] = FI_ADDR_NOTAVAIL;
+
+    info->ep_attr->tx_ctx_cnt = 0;
+    info->caps = FI_RMA | FI_REMOTE_READ | FI_REMOTE_WRITE;
+#if ENABLE_TARGET_CNTR
+    info->caps |= FI_RMA_EVENT;
+#endif
+    info->tx_attr->op_flags = 0;
+    info->mode = 0;
+    info->tx_attr->mode = 0;
+    info->rx_attr->mode = 0;
+
+    ret = fi_endpoint(rail->domain, info, &rail->target_ep, NULL);
+    OFI_CHECK_RETURN_MSG(ret, "rail target endpoint creation failed (%s)\n", fi_strerror(errno));
+
+    ret = fi_ep_bind(rail->target_ep, &rail->av->fid, 0);
+    OFI_CHECK_RETURN_STR(ret, "fi_ep_bind AV to rail target endpoint failed");
+
+#if ENABLE_TARGET_CNTR
+    struct fid_cntr **cntrfd = &rail->target_cntr;
+#else
+    struct fid_cntr **cntrfd = NULL;
+#endif
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+    ret = allocate_recv_cntr_mr_domain(rail->domain, cntrfd, &rail->mr, NULL);
+#else
+    ret = allocate_recv_cntr_mr_domain(rail->domain, cntrfd, &rail->heap_mr, &rail->data_mr);
+#endif
+    if (ret != 0) return ret;
+
+    ret = fi_cq_open(rail->domain, &cq_attr, &rail->target_cq, NULL);
+    OFI_CHECK_RETURN_MSG(ret, "rail cq_open failed (%s)\n", fi_strerror(errno));
+
+    ret = fi_ep_bind(rail->target_ep, &rail->target_cq->fid, FI_RECV);
+    OFI_CHECK_RETURN_STR(ret, "fi_ep_bind CQ to rail target endpoint failed");
+
+    ret = fi_enable(rail->target_ep);
+    OFI_CHECK_RETURN_STR(ret, "fi_enable on rail target endpoint failed");
+
+#ifndef ENABLE_MR_SCALABLE
+    ret = posix_memalign((void **) &rail->peer_mr, SHMEM_INTERNAL_CACHELINE_SIZE,
+                         sizeof(shmem_transport_ofi_peer_mr_t) * shmem_internal_num_pes);
+    if (ret != 0) {
+        RAISE_WARN_STR("Out of memory allocating rail MR translation table");
+        return 1;
+    }
+#endif
+
+    return 0;
+}
+
+/* Publish the target endpoint address (and, without scalable MRs, the keys
+ * and segment addresses) of each additional rail.  Entries are named after
+ * the rail 0 ones, with the rail number appended. */
+static
+int publish_rail_info(void)
+{
+    int r, ret;
+    char name[32];
+
+    for (r = 1; r < shmem_transport_ofi_num_rails; r++) {
+        shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[r];
+        char epname[128];
+        size_t epnamelen = sizeof(epname);
+
+        ret = fi_getname((fid_t) rail->target_ep, epname, &epnamelen);
+        if (ret != 0 || epnamelen > sizeof(epname)) {
+            RAISE_WARN_STR("fi_getname failed for rail target endpoint");
+            return 1;
+        }
+        rail->addrlen = epnamelen;
+
+        snprintf(name, sizeof(name), "fi_epname_%d", r);
+        ret = shmem_runtime_put(name, epname, epnamelen);
+        OFI_CHECK_RETURN_MSG(ret, "shmem_runtime_put %s failed\n", name);
+
+#ifndef ENABLE_MR_SCALABLE
+        uint64_t keys[SHMEM_INTERNAL_NSEG];
+        uint8_t *bases[SHMEM_INTERNAL_NSEG];
+
+        if (rail->info->domain_attr->mr_mode & FI_MR_PROV_KEY) {
+            keys[SHMEM_INTERNAL_SEG_HEAP] = fi_mr_key(rail->heap_mr);
+            keys[SHMEM_INTERNAL_SEG_DATA] = fi_mr_key(rail->data_mr);
+        } else {
+            keys[SHMEM_INTERNAL_SEG_HEAP] = SHMEM_INTERNAL_SEG_HEAP;
+            keys[SHMEM_INTERNAL_SEG_DATA] = SHMEM_INTERNAL_SEG_DATA;
+        }
+
+        if (rail->info->domain_attr->mr_mode & FI_MR_VIRT_ADDR) {
+            bases[SHMEM_INTERNAL_SEG_HEAP] = shmem_internal_heap_base;
+            bases[SHMEM_INTERNAL_SEG_DATA] = shmem_internal_data_base;
+        } else {
+            bases[SHMEM_INTERNAL_SEG_HEAP] = NULL;
+            bases[SHMEM_INTERNAL_SEG_DATA] = NULL;
+        }
+
+        snprintf(name, sizeof(name), "fi_keys_%d", r);
+        ret = shmem_runtime_put(name, keys, sizeof(keys));
+        OFI_CHECK_RETURN_MSG(ret, "shmem_runtime_put %s failed\n", name);
+
+        snprintf(name, sizeof(name), "fi_addrs_%d", r);
+        ret = shmem_runtime_put(name, bases, sizeof(bases));
+        OFI_CHECK_RETURN_MSG(ret, "shmem_runtime_put %s failed\n", name);
+#endif
+    }
+
+    return 0;
+}
+
+/* Fetch the rail addresses (and keys) of one PE from the runtime KVS */
+static
+int fetch_rail_info(int pe)
+{
+    int r, ret;
+    char name[32];
+
+    for (r = 1; r < shmem_transport_ofi_num_rails; r++) {
+        shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[r];
+        char addr[128];
+
+        snprintf(name, sizeof(name), "fi_epname_%d", r);
+        ret = shmem_runtime_get(pe, name, addr, rail->addrlen);
+        OFI_CHECK_RETURN_MSG(ret, "Runtime get of '%s' failed\n", name);
+
+        ret = fi_av_insert(rail->av, addr, 1, &rail->addr_table[pe], 0, NULL);
+        if (ret != 1) {
+            RAISE_WARN_MSG("rail %d av insert for PE %d failed (%d)\n", r, pe, ret);
+            return 1;
+        }
+
+#ifndef ENABLE_MR_SCALABLE
+        snprintf(name, sizeof(name), "fi_keys_%d", r);
+        ret = shmem_runtime_get(pe, name, rail->peer_mr[pe].key,
+                                sizeof(rail->peer_mr[pe].key));
+        OFI_CHECK_RETURN_MSG(ret, "Runtime get of '%s' failed\n", name);
+
+        snprintf(name, sizeof(name), "fi_addrs_%d", r);
+        ret = shmem_runtime_get(pe, name, rail->peer_mr[pe].base,
+                                sizeof(rail->peer_mr[pe].base));
+        OFI_CHECK_RETURN_MSG(ret, "Runtime get of '%s' failed\n", name);
+
+#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
+        /* Local and remote segments are at the same address */
+        if (rail->info->domain_attr->mr_mode & FI_MR_VIRT_ADDR) {
+            rail->peer_mr[pe].base[SHMEM_INTERNAL_SEG_HEAP] = shmem_internal_heap_base;
+            rail->peer_mr[pe].base[SHMEM_INTERNAL_SEG_DATA] = shmem_internal_data_base;
+        }
+#endif
+#endif
+    }
+
+    return 0;
+}
+
+static
+void free_rail_resources(shmem_transport_ofi_rail_t *rail)
+{
+    int ret;
+
+    ret = fi_close(&rail->target_ep->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Rail target endpoint close failed (%s)\n", fi_strerror(errno));
+
+    ret = fi_close(&rail->target_cq->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Rail target CQ close failed (%s)\n", fi_strerror(errno));
+
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+    ret = fi_close(&rail->mr->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Rail MR close failed (%s)\n", fi_strerror(errno));
+#else
+    ret = fi_close(&rail->heap_mr->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Rail heap MR close failed (%s)\n", fi_strerror(errno));
+
+    ret = fi_close(&rail->data_mr->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Rail data MR close failed (%s)\n", fi_strerror(errno));
+#endif
+
+#if ENABLE_TARGET_CNTR
+    ret = fi_close(&rail->target_cntr->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Rail target CT close failed (%s)\n", fi_strerror(errno));
+#endif
+
+    ret = fi_close(&rail->av->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Rail AV close failed (%s)\n", fi_strerror(errno));
 
-    ret = shmem_runtime_put("fi_epname", epname, epnamelen);
-    OFI_CHECK_RETURN_STR(ret, "shmem_runtime_put fi_epname failed");
+    ret = fi_close(&rail->domain->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Rail domain close failed (%s)\n", fi_strerror(errno));
 
-    /* Note: we assume that the length of an address is the same for all
-     * endpoints.  This is safe for most HPC systems, but could be incorrect in
-     * a heterogeneous context. */
-    shmem_transport_ofi_addrlen = epnamelen;
+    ret = fi_close(&rail->fabric->fid);
+    OFI_CHECK_ERROR_MSG(ret, "Rail fabric close failed (%s)\n", fi_strerror(errno));
 
-    return ret;
+    free(rail->addr_table);
+#ifndef ENABLE_MR_SCALABLE
+    free(rail->peer_mr);
+#endif
+    fi_freeinfo(rail->info);
 }
 
-static inline
-int populate_av(void)
+/* Slow path of shmem_transport_ofi_peer_check(), taken on the first
+ * communication with a PE when peers are connected lazily */
+void shmem_transport_ofi_peer_connect(int pe)
 {
-    int    i, ret, err = 0;
-    char   *alladdrs = NULL;
-
-    alladdrs = malloc(shmem_internal_num_pes * shmem_transport_ofi_addrlen);
-    if (alladdrs == NULL) {
-        RAISE_WARN_STR("Out of memory allocating 'alladdrs'");
-        return 1;
-    }
+    SHMEM_MUTEX_LOCK(shmem_transport_ofi_peer_lock);
 
-    for (i = 0; i < shmem_internal_num_pes; i++) {
-        char *addr_ptr = alladdrs + i * shmem_transport_ofi_addrlen;
-        err = shmem_runtime_get(i, "fi_epname", addr_ptr, shmem_transport_ofi_addrlen);
-        if (err != 0) {
-            RAISE_ERROR_STR("Runtime get of 'fi_epname' failed");
-        }
-    }
+    if (!shmem_transport_ofi_peer_ready[pe]) {
+        if (fetch_mr_info(pe) || fetch_av_info(pe) || fetch_rail_info(pe))
+            RAISE_ERROR_MSG("Connection setup for PE %d failed\n", pe);
 
-    ret = fi_av_insert(shmem_transport_ofi_avfd,
-                       alladdrs,
-                       shmem_internal_num_pes,
-                       addr_table,
-                       0,
-                       NULL);
-    if (ret != shmem_internal_num_pes) {
-        RAISE_WARN_STR("av insert failed");
-        return ret;
+        __atomic_store_n(&shmem_transport_ofi_peer_ready[pe], 1, __ATOMIC_RELEASE);
     }
 
-    free(alladdrs);
-
-    return 0;
+    SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_peer_lock);
 }
 
 static inline
@@ -1170,7 +2308,10 @@ int query_for_fabric(struct fabric_info *info)
                                       at least 1 byte */
 #endif
 #ifdef ENABLE_THREADS
-    if (shmem_internal_thread_level == SHMEM_THREAD_MULTIPLE) {
+    /* The progress thread reads the target CQ and counter concurrently with
+     * the application, so it needs the same support as THREAD_MULTIPLE */
+    if (shmem_internal_thread_level == SHMEM_THREAD_MULTIPLE ||
+        shmem_internal_params.OFI_PROGRESS_INTERVAL > 0) {
 #ifdef USE_THREAD_COMPLETION
         domain_attr.threading = FI_THREAD_COMPLETION;
 #else
@@ -1237,11 +2378,45 @@ int query_for_fabric(struct fabric_info *info)
         return 1;
     }
 
+    if (shmem_internal_params.OFI_GET_FRAGMENT_SIZE > 0 &&
+        shmem_internal_params.OFI_GET_FRAGMENT_SIZE < shmem_transport_ofi_max_msg_size)
+        shmem_transport_ofi_get_frag_size = shmem_internal_params.OFI_GET_FRAGMENT_SIZE;
+    else
+        shmem_transport_ofi_get_frag_size = shmem_transport_ofi_max_msg_size;
+
+    if (shmem_internal_params.OFI_GET_WINDOW < 0) {
+        RAISE_WARN_MSG("Ignoring invalid OFI_GET_WINDOW value '%ld'\n",
+                       shmem_internal_params.OFI_GET_WINDOW);
+        shmem_transport_ofi_get_window = 0;
+    } else {
+        shmem_transport_ofi_get_window = shmem_internal_params.OFI_GET_WINDOW;
+    }
+
     /* Check if the domain supports STXs */
     if (info->p_info->domain_attr->max_ep_stx_ctx == 0) {
         shmem_transport_ofi_stx_max = 0;
     }
 
+    /* Check if the domain supports scalable endpoints */
+    if (shmem_transport_ofi_sep_tx_max != 0) {
+        long max_tx_ctx = (long) info->p_info->domain_attr->max_ep_tx_ctx;
+
+        if (max_tx_ctx <= 1) {
+            if (shmem_internal_my_pe == 0)
+                RAISE_WARN_MSG("OFI provider supports %ld TX contexts per endpoint, "
+                               "disabling SHMEM_OFI_SCALABLE_EP\n", max_tx_ctx);
+            shmem_transport_ofi_sep_tx_max = 0;
+        } else if (shmem_transport_ofi_sep_tx_max < 0) {
+            shmem_transport_ofi_sep_tx_max = max_tx_ctx;
+        } else if (shmem_transport_ofi_sep_tx_max > max_tx_ctx) {
+            if (shmem_internal_my_pe == 0)
+                RAISE_WARN_MSG("OFI provider supports %ld TX contexts per endpoint, "
+                               "reducing SHMEM_OFI_SCALABLE_EP from %ld\n", max_tx_ctx,
+                               shmem_transport_ofi_sep_tx_max);
+            shmem_transport_ofi_sep_tx_max = max_tx_ctx;
+        }
+    }
+
 #if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
     /* Only use a single MR, no keys required */
     info->p_info->domain_attr->mr_key_size = 0;
@@ -1256,12 +2431,35 @@ int query_for_fabric(struct fabric_info *info)
 
     shmem_internal_assertp(info->p_info->tx_attr->inject_size >= shmem_transport_ofi_max_buffered_send);
     shmem_transport_ofi_max_buffered_send = info->p_info->tx_attr->inject_size;
+    shmem_transport_ofi_iov_limit = MIN(info->p_info->tx_attr->iov_limit,
+                                        SHMEM_TRANSPORT_OFI_MAX_IOV);
+    if (shmem_transport_ofi_iov_limit == 0)
+        shmem_transport_ofi_iov_limit = 1;
+    shmem_transport_ofi_rma_iov_limit = MIN(info->p_info->tx_attr->rma_iov_limit,
+                                            SHMEM_TRANSPORT_OFI_MAX_IOV);
+    if (shmem_transport_ofi_rma_iov_limit == 0)
+        shmem_transport_ofi_rma_iov_limit = 1;
+
+    shmem_transport_ofi_lazy_connect = shmem_internal_params.OFI_LAZY_CONNECT;
+
+    /* Put-with-signal may drop the fence between the data and the signal
+     * only for writes the provider places in order (FI_ORDER_WAW covers RMA
+     * and atomic writes).  The endpoint is opened from this info, so the
+     * reported ordering is what the endpoint provides. */
+    shmem_transport_ofi_signal_order_size = 0;
+    if (shmem_internal_params.OFI_ORDERED_SIGNAL) {
+        if (info->p_info->tx_attr->msg_order & FI_ORDER_WAW)
+            shmem_transport_ofi_signal_order_size = info->p_info->ep_attr->max_order_waw_size;
+        else if (shmem_internal_my_pe == 0)
+            RAISE_WARN_STR("OFI provider does not order write after write, "
+                           "ignoring SHMEM_OFI_ORDERED_SIGNAL");
+    }
 #ifdef ENABLE_MR_RMA_EVENT
     shmem_transport_ofi_mr_rma_event = (info->p_info->domain_attr->mr_mode & FI_MR_RMA_EVENT) != 0;
 #endif
 
     DEBUG_MSG("OFI provider: %s, fabric: %s, domain: %s, mr_mode: 0x%x\n"
-              RAISE_PE_PREFIX "max_inject: %zu, max_msg: %zu, stx: %s, stx_max: %ld\n",
+              RAISE_PE_PREFIX "max_inject: %zu, max_msg: %zu, stx: %s, stx_max: %ld, sep_tx_max: %ld\n",
               info->p_info->fabric_attr->prov_name,
               info->p_info->fabric_attr->name, info->p_info->domain_attr->name,
               info->p_info->domain_attr->mr_mode,
@@ -1269,7 +2467,7 @@ int query_for_fabric(struct fabric_info *info)
               shmem_transport_ofi_max_buffered_send,
               shmem_transport_ofi_max_msg_size,
               info->p_info->domain_attr->max_ep_stx_ctx == 0 ? "no" : "yes",
-              shmem_transport_ofi_stx_max);
+              shmem_transport_ofi_stx_max, shmem_transport_ofi_sep_tx_max);
 
     return ret;
 }
@@ -1316,6 +2514,101 @@ static int shmem_transport_ofi_target_ep_init(void)
     return 0;
 }
 
+/* Open the endpoint, counters, and CQ of a context on each additional rail.
+ * Rail endpoints carry only RMA, so they do not use STXs. */
+static int shmem_transport_ofi_ctx_init_rails(shmem_transport_ctx_t *ctx)
+{
+    int r, ret;
+    struct fi_cntr_attr cntr_attr = {0};
+    struct fi_cq_attr cq_attr = {0};
+
+    cntr_attr.events   = FI_CNTR_EVENTS_COMP;
+    cntr_attr.wait_obj = FI_WAIT_NONE;
+    cq_attr.format     = FI_CQ_FORMAT_CONTEXT;
+
+    ctx->rails = calloc(shmem_transport_ofi_num_rails, sizeof(shmem_transport_ofi_ctx_rail_t));
+    if (ctx->rails == NULL) {
+        RAISE_WARN_STR("Out of memory allocating context rails");
+        return 1;
+    }
+
+    for (r = 1; r < shmem_transport_ofi_num_rails; r++) {
+        shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[r];
+        shmem_transport_ofi_ctx_rail_t *crail = &ctx->rails[r];
+        struct fi_info *info = rail->info;
+
+        ret = fi_cntr_open(rail->domain, &cntr_attr, &crail->put_cntr, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail put_cntr creation failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_cntr_open(rail->domain, &cntr_attr, &crail->get_cntr, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail get_cntr creation failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_cq_open(rail->domain, &cq_attr, &crail->cq, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail cq_open failed (%s)\n", fi_strerror(errno));
+
+        info->ep_attr->tx_ctx_cnt = 0;
+        info->caps = FI_RMA | FI_WRITE | FI_READ;
+        info->tx_attr->op_flags = FI_DELIVERY_COMPLETE;
+        info->mode = 0;
+        info->tx_attr->mode = 0;
+        info->rx_attr->mode = 0;
+
+        ret = fi_endpoint(rail->domain, info, &crail->ep, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "rail ep creation failed (%s)\n", fi_strerror(errno));
+
+        ret = fi_ep_bind(crail->ep, &crail->put_cntr->fid, FI_WRITE);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind put CNTR to rail endpoint failed");
+
+        ret = fi_ep_bind(crail->ep, &crail->get_cntr->fid, FI_READ);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind get CNTR to rail endpoint failed");
+
+        ret = fi_ep_bind(crail->ep, &crail->cq->fid,
+                         FI_SELECTIVE_COMPLETION | FI_TRANSMIT | FI_RECV);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind CQ to rail endpoint failed");
+
+        ret = fi_ep_bind(crail->ep, &rail->av->fid, 0);
+        OFI_CHECK_RETURN_STR(ret, "fi_ep_bind AV to rail endpoint failed");
+
+        ret = fi_enable(crail->ep);
+        OFI_CHECK_RETURN_STR(ret, "fi_enable on rail endpoint failed");
+    }
+
+    return 0;
+}
+
+/* Open the scalable endpoint.  Its transmit contexts are opened, bound, and
+ * enabled as contexts claim them. */
+static int shmem_transport_ofi_sep_init(void)
+{
+    int ret;
+    struct fi_info *p_info = shmem_transport_ofi_info.p_info;
+    size_t rx_ctx_cnt = p_info->ep_attr->rx_ctx_cnt;
+
+    shmem_transport_ofi_sep_tx_used = calloc(shmem_transport_ofi_sep_tx_max, sizeof(char));
+    if (shmem_transport_ofi_sep_tx_used == NULL) {
+        RAISE_ERROR_STR("Out of memory when allocating OFI TX context table");
+    }
+
+    shmem_transport_ofi_set_ep_info(p_info);
+    p_info->ep_attr->tx_ctx_cnt = shmem_transport_ofi_sep_tx_max;
+    p_info->ep_attr->rx_ctx_cnt = 0;
+
+    ret = fi_scalable_ep(shmem_transport_ofi_domainfd, p_info,
+                         &shmem_transport_ofi_sep, NULL);
+    p_info->ep_attr->rx_ctx_cnt = rx_ctx_cnt;
+    OFI_CHECK_RETURN_MSG(ret, "scalable ep creation failed (%s)\n", fi_strerror(errno));
+
+    ret = fi_scalable_ep_bind(shmem_transport_ofi_sep, &shmem_transport_ofi_avfd->fid, 0);
+    OFI_CHECK_RETURN_STR(ret, "fi_scalable_ep_bind AV to scalable endpoint failed");
+
+    ret = fi_enable(shmem_transport_ofi_sep);
+    OFI_CHECK_RETURN_STR(ret, "fi_enable on scalable endpoint failed");
+
+    DEBUG_MSG("Scalable endpoint with %ld TX contexts\n", shmem_transport_ofi_sep_tx_max);
+
+    return 0;
+}
+
 static int shmem_transport_ofi_ctx_init(shmem_transport_ctx_t *ctx, int id)
 {
     int ret = 0;
@@ -1345,14 +2638,10 @@ static int shmem_transport_ofi_ctx_init(shmem_transport_ctx_t *ctx, int id)
 
     struct fabric_info* info = &shmem_transport_ofi_info;
 
-    info->p_info->ep_attr->tx_ctx_cnt = shmem_transport_ofi_stx_max > 0 ? FI_SHARED_CONTEXT : 0;
-    info->p_info->caps = FI_RMA | FI_WRITE | FI_READ | FI_ATOMIC;
-    info->p_info->tx_attr->op_flags = FI_DELIVERY_COMPLETE;
-    info->p_info->mode = 0;
-    info->p_info->tx_attr->mode = 0;
-    info->p_info->rx_attr->mode = 0;
+    shmem_transport_ofi_set_ep_info(info->p_info);
 
     ctx->id = id;
+    ctx->sep_idx = -1;
 #ifdef USE_CTX_LOCK
     SHMEM_MUTEX_INIT(ctx->lock);
 #endif
@@ -1371,36 +2660,113 @@ static int shmem_transport_ofi_ctx_init(shmem_transport_ctx_t *ctx, int id)
     }
     OFI_CHECK_RETURN_MSG(ret, "cq_open failed (%s)\n", fi_strerror(errno));
 
-    ret = fi_endpoint(shmem_transport_ofi_domainfd,
-                      info->p_info, &ctx->ep, NULL);
-    OFI_CHECK_RETURN_MSG(ret, "ep creation failed (%s)\n", fi_strerror(errno));
-
-    /* TODO: Fill in TX attr */
-
-    /* Allocate STX from the pool */
     if (shmem_internal_thread_level > SHMEM_THREAD_FUNNELED &&
         shmem_transport_ofi_is_private(ctx->options)) {
             ctx->tid = shmem_transport_ofi_gettid();
     }
-    shmem_transport_ofi_stx_allocate(ctx);
+
+    /* Use a transmit context of the scalable endpoint when one is free */
+    ctx->sep_idx = shmem_transport_ofi_sep_claim();
+
+    if (ctx->sep_idx >= 0) {
+        ctx->stx_idx = -1;
+
+        ret = fi_tx_context(shmem_transport_ofi_sep, ctx->sep_idx,
+                            info->p_info->tx_attr, &ctx->ep, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "TX context creation failed (%s)\n", fi_strerror(errno));
+    } else {
+        ret = fi_endpoint(shmem_transport_ofi_domainfd,
+                          info->p_info, &ctx->ep, NULL);
+        OFI_CHECK_RETURN_MSG(ret, "ep creation failed (%s)\n", fi_strerror(errno));
+
+        /* TODO: Fill in TX attr */
+
+        /* Allocate STX from the pool */
+        shmem_transport_ofi_stx_allocate(ctx);
+    }
 
     ret = bind_enable_ep_resources(ctx);
     OFI_CHECK_RETURN_MSG(ret, "context bind/enable endpoint failed (%s)\n", fi_strerror(errno));
 
+    /* Aggregates are staged in bounce buffers */
+    if (ctx->options & SHMEMX_CTX_AGGREGATE)
+        ctx->options |= SHMEMX_CTX_BOUNCE_BUFFER;
+
     if (ctx->options & SHMEMX_CTX_BOUNCE_BUFFER &&
         shmem_transport_ofi_bounce_buffer_size > 0 &&
         shmem_transport_ofi_max_bounce_buffers > 0)
     {
-        ctx->bounce_buffers =
-            shmem_free_list_init(sizeof(shmem_transport_ofi_bounce_buffer_t) +
-                                 shmem_transport_ofi_bounce_buffer_size,
-                                 init_bounce_buffer);
+        const uint64_t budget = (uint64_t) shmem_transport_ofi_max_bounce_buffers *
+                                shmem_transport_ofi_bounce_buffer_size;
+        int i;
+
+        ctx->bounce_buffers = calloc(shmem_transport_ofi_num_bounce_classes,
+                                     sizeof(shmem_transport_ofi_bounce_pool_t));
+        if (ctx->bounce_buffers == NULL) {
+            RAISE_ERROR_STR("Out of memory when allocating OFI bounce buffer pools");
+        }
+
+        for (i = 0; i < shmem_transport_ofi_num_bounce_classes; i++) {
+            shmem_transport_ofi_bounce_pool_t *pool = &ctx->bounce_buffers[i];
+
+            pool->size      = shmem_transport_ofi_bounce_class_size[i];
+            pool->max_limit = budget / pool->size;
+            pool->limit     = budget / shmem_transport_ofi_num_bounce_classes / pool->size;
+            if (pool->limit == 0)
+                pool->limit = 1;
+            pool->fl = shmem_free_list_init(sizeof(shmem_transport_ofi_bounce_buffer_t) +
+                                            pool->size, init_bounce_buffer);
+            if (pool->fl == NULL) {
+                RAISE_ERROR_STR("Out of memory when allocating OFI bounce buffers");
+            }
+        }
     }
     else {
         ctx->options &= ~SHMEMX_CTX_BOUNCE_BUFFER;
         ctx->bounce_buffers = NULL;
     }
 
+    if (shmem_transport_ofi_pe_cntr_mask >= 0) {
+        ctx->pe_cntr = calloc(shmem_transport_ofi_pe_cntr_mask + 1,
+                              sizeof(shmem_transport_ofi_pe_cntr_t));
+        if (ctx->pe_cntr == NULL) {
+            RAISE_ERROR_STR("Out of memory when allocating OFI per-PE counters");
+        }
+    }
+
+    /* Streamed gets use the CQ on every context */
+    ctx->cq_ring = malloc(shmem_transport_ofi_cq_batch_size * sizeof(struct fi_cq_entry));
+    if (ctx->cq_ring == NULL) {
+        RAISE_ERROR_STR("Out of memory when allocating OFI CQ ring");
+    }
+    SHMEM_MUTEX_INIT(ctx->bb_lock);
+
+    /* At least two bounce buffers are needed so that an open aggregate cannot
+     * starve other bounce buffered operations */
+    if (ctx->options & SHMEMX_CTX_AGGREGATE) {
+        if (ctx->bounce_buffers == NULL || shmem_transport_ofi_aggr_size == 0 ||
+            shmem_transport_ofi_max_bounce_buffers < 2) {
+            DEBUG_MSG("Context %d: bounce buffering unavailable, disabling put aggregation\n", id);
+            ctx->options &= ~SHMEMX_CTX_AGGREGATE;
+        } else {
+#if defined(ENABLE_THREADS) && !defined(USE_CTX_LOCK)
+            SHMEM_MUTEX_INIT(ctx->aggr.lock);
+#endif
+        }
+    }
+
+    if (shmem_transport_ofi_num_rails > 1) {
+        ret = shmem_transport_ofi_ctx_init_rails(ctx);
+        if (ret != 0) return ret;
+    }
+
+#ifdef USE_MR_CACHE_MONITOR
+    if (shmem_transport_ofi_mr_cache_size > 0) {
+        ret = shmem_transport_ofi_mr_cache_create(ctx);
+        if (ret != 0) return ret;
+    }
+#endif
+
     return 0;
 }
 
@@ -1410,6 +2776,7 @@ int shmem_transport_init(void)
     int ret = 0;
 
     SHMEM_MUTEX_INIT(shmem_transport_ofi_lock);
+    SHMEM_MUTEX_INIT(shmem_transport_ofi_peer_lock);
 
     shmem_transport_ofi_info.npes = shmem_runtime_get_size();
 
@@ -1449,9 +2816,36 @@ int shmem_transport_init(void)
     }
     shmem_transport_ofi_stx_threshold = shmem_internal_params.OFI_STX_THRESHOLD;
 
+    if (shmem_internal_params.OFI_SCALABLE_EP < -1) {
+        RAISE_ERROR_MSG("Invalid OFI_SCALABLE_EP value '%ld'\n",
+                        shmem_internal_params.OFI_SCALABLE_EP);
+    }
+    shmem_transport_ofi_sep_tx_max = shmem_internal_params.OFI_SCALABLE_EP;
+
+    if (shmem_internal_params.OFI_NUM_RAILS < 1 ||
+        shmem_internal_params.OFI_NUM_RAILS > SHMEM_TRANSPORT_OFI_MAX_RAILS) {
+        RAISE_ERROR_MSG("Invalid OFI_NUM_RAILS value '%ld' (must be 1 to %d)\n",
+                        shmem_internal_params.OFI_NUM_RAILS, SHMEM_TRANSPORT_OFI_MAX_RAILS);
+    }
+    shmem_transport_ofi_num_rails = shmem_internal_params.OFI_NUM_RAILS;
+
+    /* Each rail receives at least a cache line of a striped transfer */
+    shmem_transport_ofi_rail_stripe_size =
+        MAX(shmem_internal_params.OFI_RAIL_STRIPE_SIZE,
+            (size_t) shmem_transport_ofi_num_rails * SHMEM_INTERNAL_CACHELINE_SIZE);
+
+    if (shmem_internal_params.OFI_MR_CACHE_SIZE < 0) {
+        RAISE_ERROR_MSG("Invalid OFI_MR_CACHE_SIZE value '%ld'\n",
+                        shmem_internal_params.OFI_MR_CACHE_SIZE);
+    }
+    shmem_transport_ofi_mr_cache_size = shmem_internal_params.OFI_MR_CACHE_SIZE;
+
     ret = query_for_fabric(&shmem_transport_ofi_info);
     if (ret != 0) return ret;
 
+    ret = query_for_rails(&shmem_transport_ofi_info);
+    if (ret != 0) return ret;
+
     ret = allocate_fabric_resources(&shmem_transport_ofi_info);
     if (ret != 0) return ret;
 
@@ -1462,6 +2856,9 @@ int shmem_transport_init(void)
     } else if (0 == strcmp(type, "random")) {
         shmem_transport_ofi_stx_allocator = RANDOM;
         shmem_transport_ofi_stx_rand_init();
+    } else if (0 == strcmp(type, "load")) {
+        shmem_transport_ofi_stx_allocator = LOAD;
+        shmem_transport_ofi_stx_load_tracking = 1;
     } else {
         RAISE_WARN_MSG("Ignoring bad STX share algorithm '%s', using 'round-robin'\n", type);
         shmem_transport_ofi_stx_allocator = ROUNDROBIN;
@@ -1481,6 +2878,55 @@ int shmem_transport_init(void)
         shmem_transport_ofi_max_bounce_buffers = shmem_internal_params.MAX_BOUNCE_BUFFERS;
     }
 
+    /* Per-PE completion tracking identifies operations by their completion
+     * context, and is not needed when communication is ordered */
+#if WANT_TOTAL_DATA_ORDERING == 0
+    if (shmem_internal_params.OFI_PE_CNTR_TABLE_SIZE > 0) {
+        if (shmem_transport_ofi_info.p_info->mode & FI_CONTEXT) {
+            DEBUG_STR("OFI provider requires FI_CONTEXT; disabling per-PE counters");
+        } else {
+            long size = 1;
+
+            /* Round up to a power of two, with no more slots than PEs */
+            while (size < shmem_internal_params.OFI_PE_CNTR_TABLE_SIZE &&
+                   size < shmem_transport_ofi_info.npes)
+                size <<= 1;
+
+            shmem_transport_ofi_pe_cntr_mask = size - 1;
+        }
+    } else if (shmem_internal_params.OFI_PE_CNTR_TABLE_SIZE < 0) {
+        RAISE_WARN_MSG("Ignoring invalid per-PE counter table size (%ld)\n",
+                       shmem_internal_params.OFI_PE_CNTR_TABLE_SIZE);
+    }
+#endif
+
+    if (shmem_internal_params.OFI_CQ_BATCH_SIZE > 0) {
+        shmem_transport_ofi_cq_batch_size = shmem_internal_params.OFI_CQ_BATCH_SIZE;
+    } else {
+        RAISE_WARN_MSG("Ignoring invalid CQ batch size (%ld), using 1\n",
+                       shmem_internal_params.OFI_CQ_BATCH_SIZE);
+        shmem_transport_ofi_cq_batch_size = 1;
+    }
+
+    shmem_transport_ofi_aggr_size = MIN(shmem_internal_params.OFI_AGGREGATE_SIZE,
+                                        shmem_transport_ofi_bounce_buffer_size);
+    shmem_transport_ofi_aggr_timeout = shmem_internal_params.OFI_AGGREGATE_TIMEOUT / 1.0e6;
+
+    /* Size classes for the bounce buffer pools, the largest class is always
+     * the bounce buffer size */
+    shmem_transport_ofi_num_bounce_classes = 0;
+    if (shmem_transport_ofi_bounce_buffer_size > 0) {
+        size_t size = SHMEM_TRANSPORT_OFI_BB_MIN_SIZE;
+
+        while (size < shmem_transport_ofi_bounce_buffer_size &&
+               shmem_transport_ofi_num_bounce_classes < SHMEM_TRANSPORT_OFI_BB_MAX_CLASSES - 1) {
+            shmem_transport_ofi_bounce_class_size[shmem_transport_ofi_num_bounce_classes++] = size;
+            size *= SHMEM_TRANSPORT_OFI_BB_CLASS_FACTOR;
+        }
+        shmem_transport_ofi_bounce_class_size[shmem_transport_ofi_num_bounce_classes++] =
+            shmem_transport_ofi_bounce_buffer_size;
+    }
+
     shmem_transport_ofi_put_poll_limit = shmem_internal_params.OFI_TX_POLL_LIMIT;
     shmem_transport_ofi_get_poll_limit = shmem_internal_params.OFI_RX_POLL_LIMIT;
 
@@ -1507,9 +2953,116 @@ int shmem_transport_init(void)
     ret = publish_av_info(&shmem_transport_ofi_info);
     if (ret != 0) return ret;
 
+    for (int r = 1; r < shmem_transport_ofi_num_rails; r++) {
+        ret = allocate_rail_resources(&shmem_transport_ofi_rails[r]);
+        if (ret != 0) return ret;
+    }
+
+    ret = publish_rail_info();
+    if (ret != 0) return ret;
+
+    return 0;
+}
+
+#ifdef ENABLE_THREADS
+static pthread_t shmem_transport_ofi_progress_thread;
+static int shmem_transport_ofi_progress_thread_running = 1;
+
+/* Drives target-side progress while the application is not calling into the
+ * library.  The polling interval doubles, up to OFI_PROGRESS_MAX_INTERVAL,
+ * each time a poll finds no incoming operations, and returns to
+ * OFI_PROGRESS_INTERVAL as soon as one does. */
+static void * shmem_transport_ofi_progress_thread_func(void *arg)
+{
+    long min_interval = shmem_internal_params.OFI_PROGRESS_INTERVAL;
+    long max_interval = shmem_internal_params.OFI_PROGRESS_MAX_INTERVAL;
+    long interval = min_interval;
+#if ENABLE_TARGET_CNTR
+    uint64_t last_target = 0;
+#endif
+
+    if (max_interval < min_interval)
+        max_interval = min_interval;
+
+    while (__atomic_load_n(&shmem_transport_ofi_progress_thread_running, __ATOMIC_ACQUIRE)) {
+        int active = 0;
+
+        shmem_transport_probe();
+
+#if ENABLE_TARGET_CNTR
+        if (0 == pthread_mutex_trylock(&shmem_transport_ofi_progress_lock)) {
+            uint64_t cnt = fi_cntr_read(shmem_transport_ofi_target_cntrfd);
+            pthread_mutex_unlock(&shmem_transport_ofi_progress_lock);
+
+            if (cnt != last_target) {
+                last_target = cnt;
+                active = 1;
+            }
+        }
+#endif
+
+        if (active)
+            interval = min_interval;
+        else if (interval < max_interval)
+            interval = (interval * 2 < max_interval) ? interval * 2 : max_interval;
+
+        usleep(interval);
+    }
+
+    return NULL;
+}
+
+
+static int shmem_transport_ofi_progress_thread_start(void)
+{
+    int ret;
+
+    shmem_transport_ofi_progress_thread_enabled = 1;
+
+    ret = pthread_create(&shmem_transport_ofi_progress_thread, NULL,
+                         &shmem_transport_ofi_progress_thread_func, NULL);
+    if (ret != 0) {
+        shmem_transport_ofi_progress_thread_enabled = 0;
+        RETURN_ERROR_MSG("Progress thread creation failed (%s)\n", strerror(ret));
+        return ret;
+    }
+
+    if (shmem_internal_params.OFI_PROGRESS_CORE >= 0) {
+#ifdef HAVE_SCHED_GETAFFINITY
+        cpu_set_t cpuset;
+
+        CPU_ZERO(&cpuset);
+        CPU_SET(shmem_internal_params.OFI_PROGRESS_CORE, &cpuset);
+        ret = pthread_setaffinity_np(shmem_transport_ofi_progress_thread,
+                                     sizeof(cpu_set_t), &cpuset);
+        if (ret != 0)
+            RAISE_WARN_MSG("Could not pin progress thread to core %ld (%s)\n",
+                           shmem_internal_params.OFI_PROGRESS_CORE, strerror(ret));
+#else
+        RAISE_WARN_STR("Progress thread pinning is not supported on this platform");
+#endif
+    }
+
+    DEBUG_MSG("Progress thread started (interval %ld-%ld usec, core %ld)\n",
+              shmem_internal_params.OFI_PROGRESS_INTERVAL,
+              shmem_internal_params.OFI_PROGRESS_MAX_INTERVAL,
+              shmem_internal_params.OFI_PROGRESS_CORE);
+
     return 0;
 }
 
+
+static void shmem_transport_ofi_progress_thread_stop(void)
+{
+    void *progress_out;
+
+    __atomic_store_n(&shmem_transport_ofi_progress_thread_running, 0, __ATOMIC_RELEASE);
+    pthread_join(shmem_transport_ofi_progress_thread, &progress_out);
+    shmem_transport_ofi_progress_thread_enabled = 0;
+}
+#endif /* ENABLE_THREADS */
+
+
 int shmem_transport_startup(void)
 {
     int ret;
@@ -1572,10 +3125,31 @@ int shmem_transport_startup(void)
         OFI_CHECK_RETURN_MSG(ret, "STX context creation failed (%s)\n", fi_strerror(ret));
         shmem_transport_ofi_stx_pool[i].ref_cnt = 0;
         shmem_transport_ofi_stx_pool[i].is_private = 0;
+        shmem_transport_ofi_stx_pool[i].ops = 0;
+        shmem_transport_ofi_stx_pool[i].mark = 0;
+        shmem_transport_ofi_stx_pool[i].load = 0;
+    }
+
+    if (shmem_transport_ofi_sep_tx_max > 0) {
+        ret = shmem_transport_ofi_sep_init();
+        if (ret != 0) return ret;
     }
 
     shmem_transport_ctx_default.team = &shmem_internal_team_world;
 
+    /* The registration cache is only safe while unmapped memory is detected */
+    if (shmem_transport_ofi_mr_cache_size > 0) {
+#ifdef USE_MR_CACHE_MONITOR
+        if (shmem_transport_ofi_mr_monitor_start() != 0) {
+            RAISE_WARN_STR("Cannot monitor unmapped memory, disabling local MR cache");
+            shmem_transport_ofi_mr_cache_size = 0;
+        }
+#else
+        RAISE_WARN_STR("Local MR cache requires thread and userfaultfd support, disabling it");
+        shmem_transport_ofi_mr_cache_size = 0;
+#endif
+    }
+
     ret = shmem_transport_ofi_ctx_init(&shmem_transport_ctx_default, SHMEM_TRANSPORT_CTX_DEFAULT_ID);
     if (ret != 0) return ret;
 
@@ -1588,9 +3162,100 @@ int shmem_transport_startup(void)
     ret = populate_av();
     if (ret != 0) return ret;
 
+    if (!shmem_transport_ofi_lazy_connect) {
+        for (i = 0; i < shmem_internal_num_pes; i++) {
+            ret = fetch_rail_info(i);
+            if (ret != 0) return ret;
+        }
+    }
+
+#ifdef ENABLE_THREADS
+    if (shmem_internal_params.OFI_PROGRESS_INTERVAL > 0) {
+        ret = shmem_transport_ofi_progress_thread_start();
+        if (ret != 0) return ret;
+    }
+#endif
+
     return 0;
 }
 
+void shmem_transport_get_stream(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                                size_t len, int pe, shmemx_stream_fn_t callback, void *arg)
+{
+    shmem_transport_ofi_get_frag_t window[SHMEM_TRANSPORT_OFI_MAX_GET_WINDOW];
+    const size_t frag_size = shmem_transport_ofi_get_frag_size;
+    const size_t nfrags = (len + frag_size - 1) / frag_size;
+    size_t nwin = (size_t) shmem_transport_ofi_get_window;
+    size_t issued = 0, delivered = 0;
+    uint64_t dst = (uint64_t) pe;
+    uint64_t key;
+    uint8_t *addr;
+    shmem_transport_ofi_mr_entry_t *entry;
+    void *desc;
+
+    if (nwin == 0 || nwin > SHMEM_TRANSPORT_OFI_MAX_GET_WINDOW)
+        nwin = SHMEM_TRANSPORT_OFI_MAX_GET_WINDOW;
+
+    shmem_transport_ofi_get_mr(source, pe, &addr, &key);
+    desc = shmem_transport_ofi_local_desc(ctx, target, len, &entry);
+
+    while (delivered < nfrags) {
+        /* Keep the window full */
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        for ( ; issued < nfrags && issued - delivered < nwin; issued++) {
+            shmem_transport_ofi_get_frag_t *frag = &window[issued % nwin];
+            const size_t off = issued * frag_size;
+            uint64_t polled = 0;
+            int ret;
+
+            frag->frag.mytype = SHMEM_TRANSPORT_OFI_TYPE_GET;
+            frag->done = 0;
+
+            const struct iovec      msg_iov = { .iov_base = (uint8_t *) target + off,
+                                                .iov_len  = MIN(frag_size, len - off) };
+            const struct fi_rma_iov rma_iov = { .addr = (uint64_t) (addr + off),
+                                                .len  = msg_iov.iov_len,
+                                                .key  = key };
+            const struct fi_msg_rma msg     = {
+                                                .msg_iov       = &msg_iov,
+                                                .desc          = &desc,
+                                                .iov_count     = 1,
+                                                .addr          = GET_DEST(dst),
+                                                .rma_iov       = &rma_iov,
+                                                .rma_iov_count = 1,
+                                                .context       = frag,
+                                                .data          = 0
+                                              };
+
+            SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+            do {
+                ret = fi_readmsg(ctx->ep, &msg, FI_COMPLETION);
+            } while (try_again(ctx, ret, &polled));
+        }
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+        /* Wait for the oldest fragment and hand it over */
+        shmem_transport_ofi_get_frag_t *head = &window[delivered % nwin];
+
+        while (!__atomic_load_n(&head->done, __ATOMIC_ACQUIRE)) {
+            SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
+            shmem_transport_ofi_drain_cq(ctx);
+            SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
+
+            if (!__atomic_load_n(&head->done, __ATOMIC_ACQUIRE)) {
+                shmem_transport_probe();
+                SPINLOCK_BODY();
+            }
+        }
+
+        callback((uint8_t *) target + delivered * frag_size,
+                 MIN(frag_size, len - delivered * frag_size), arg);
+        delivered++;
+    }
+
+    shmem_transport_ofi_local_desc_release(entry);
+}
+
 int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx)
 {
     int ret;
@@ -1633,8 +3298,13 @@ int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options,
     shmem_internal_cntr_write(&ctxp->pending_put_cntr, 0);
     shmem_internal_cntr_write(&ctxp->pending_get_cntr, 0);
 #endif
+    shmem_internal_cntr_write(&ctxp->pending_bb_cntr, 0);
+    shmem_internal_cntr_write(&ctxp->completed_bb_cntr, 0);
+    shmem_internal_cntr_write(&ctxp->cq_batch_cntr, 0);
+    shmem_internal_cntr_write(&ctxp->cq_entry_cntr, 0);
 
     ctxp->stx_idx = -1;
+    ctxp->sep_idx = -1;
     ctxp->options = options;
 
     ctxp->team = team;
@@ -1662,12 +3332,11 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
 
     if(shmem_internal_params.DEBUG) {
         SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-        if (ctx->bounce_buffers) SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
-        DEBUG_MSG("id = %d, options = %#0lx, stx_idx = %d\n"
+        DEBUG_MSG("id = %d, options = %#0lx, stx_idx = %d, sep_idx = %d\n"
                   RAISE_PE_PREFIX "pending_put_cntr = %9"PRIu64", completed_put_cntr = %9"PRIu64"\n"
                   RAISE_PE_PREFIX "pending_get_cntr = %9"PRIu64", completed_get_cntr = %9"PRIu64"\n"
                   RAISE_PE_PREFIX "pending_bb_cntr  = %9"PRIu64", completed_bb_cntr  = %9"PRIu64"\n",
-                  ctx->id, (unsigned long) ctx->options, ctx->stx_idx,
+                  ctx->id, (unsigned long) ctx->options, ctx->stx_idx, ctx->sep_idx,
                   shmem_internal_my_pe,
                   SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr),
                   ctx->put_cntr ? fi_cntr_read(ctx->put_cntr) : 0,
@@ -1675,9 +3344,9 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
                   SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr),
                   ctx->get_cntr ? fi_cntr_read(ctx->get_cntr) : 0,
                   shmem_internal_my_pe,
-                  ctx->pending_bb_cntr, ctx->completed_bb_cntr
+                  shmem_internal_cntr_read(&ctx->pending_bb_cntr),
+                  shmem_internal_cntr_read(&ctx->completed_bb_cntr)
                  );
-        if (ctx->bounce_buffers) SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
         SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
     }
 
@@ -1687,7 +3356,48 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
     }
 
     if (ctx->bounce_buffers) {
-        shmem_free_list_destroy(ctx->bounce_buffers);
+        int i;
+
+        for (i = 0; i < shmem_transport_ofi_num_bounce_classes; i++) {
+            shmem_transport_ofi_bounce_pool_t *pool = &ctx->bounce_buffers[i];
+
+            DEBUG_MSG("id = %d, bounce class %d: size = %zu, limit = %"PRIu64
+                      ", hwm = %"PRIu64", grown = %"PRIu64", stalls = %"PRIu64"\n",
+                      ctx->id, i, pool->size, pool->limit, pool->hwm,
+                      pool->grow_cnt, pool->stall_cnt);
+            shmem_free_list_destroy(pool->fl);
+        }
+        if (ctx->options & SHMEMX_CTX_AGGREGATE) {
+            shmem_internal_assert(ctx->aggr.buff == NULL);
+            DEBUG_MSG("id = %d, aggregated puts = %"PRIu64", aggregate flushes = %"PRIu64"\n",
+                      ctx->id, ctx->aggr.put_cnt, ctx->aggr.flush_cnt);
+#if defined(ENABLE_THREADS) && !defined(USE_CTX_LOCK)
+            SHMEM_MUTEX_DESTROY(ctx->aggr.lock);
+#endif
+        }
+        free(ctx->bounce_buffers);
+    }
+
+    if (ctx->pe_cntr) {
+        DEBUG_MSG("id = %d, fence waits on per-PE counters = %"PRIu64"\n",
+                  ctx->id, ctx->pe_fence_wait_cnt);
+        free(ctx->pe_cntr);
+    }
+
+    if (ctx->cq_ring) {
+        free(ctx->cq_ring);
+        SHMEM_MUTEX_DESTROY(ctx->bb_lock);
+    }
+
+#ifdef USE_MR_CACHE_MONITOR
+    if (ctx->mr_cache)
+        shmem_transport_ofi_mr_cache_destroy(ctx);
+#endif
+
+    if (ctx->sep_idx >= 0) {
+        SHMEM_MUTEX_LOCK(shmem_transport_ofi_lock);
+        shmem_transport_ofi_sep_tx_used[ctx->sep_idx] = 0;
+        SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
     }
 
     if (ctx->stx_idx >= 0) {
@@ -1718,6 +3428,30 @@ void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
         SHMEM_MUTEX_UNLOCK(shmem_transport_ofi_lock);
     }
 
+    if (ctx->rails) {
+        for (int r = 1; r < shmem_transport_ofi_num_rails; r++) {
+            shmem_transport_ofi_ctx_rail_t *crail = &ctx->rails[r];
+
+            if (crail->ep) {
+                ret = fi_close(&crail->ep->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context rail endpoint close failed (%s)\n", fi_strerror(errno));
+            }
+            if (crail->put_cntr) {
+                ret = fi_close(&crail->put_cntr->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context rail put CNTR close failed (%s)\n", fi_strerror(errno));
+            }
+            if (crail->get_cntr) {
+                ret = fi_close(&crail->get_cntr->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context rail get CNTR close failed (%s)\n", fi_strerror(errno));
+            }
+            if (crail->cq) {
+                ret = fi_close(&crail->cq->fid);
+                OFI_CHECK_ERROR_MSG(ret, "Context rail CQ close failed (%s)\n", fi_strerror(errno));
+            }
+        }
+        free(ctx->rails);
+    }
+
     if (ctx->put_cntr) {
         ret = fi_close(&ctx->put_cntr->fid);
         OFI_CHECK_ERROR_MSG(ret, "Context put CNTR close failed (%s)\n", fi_strerror(errno));
@@ -1754,11 +3488,21 @@ int shmem_transport_fini(void)
     shmem_transport_ofi_stx_kvs_t* e;
     int stx_len = 0;
 
+#ifdef ENABLE_THREADS
+    if (shmem_transport_ofi_progress_thread_enabled)
+        shmem_transport_ofi_progress_thread_stop();
+#endif
+
     /* The default context is not inserted into the list of contexts on
      * SHMEM_TEAM_WORLD, so it must be destroyed here */
     shmem_transport_quiet(&shmem_transport_ctx_default);
     shmem_transport_ctx_destroy(&shmem_transport_ctx_default);
 
+#ifdef USE_MR_CACHE_MONITOR
+    if (shmem_transport_ofi_mr_cache_size > 0)
+        shmem_transport_ofi_mr_monitor_stop();
+#endif
+
     for (e = shmem_transport_ofi_stx_kvs; e != NULL; ) {
         shmem_transport_ofi_stx_kvs_t *last = e;
         stx_len++;
@@ -1780,6 +3524,16 @@ int shmem_transport_fini(void)
     }
     if (shmem_transport_ofi_stx_pool) free(shmem_transport_ofi_stx_pool);
 
+    if (shmem_transport_ofi_sep) {
+        ret = fi_close(&shmem_transport_ofi_sep->fid);
+        OFI_CHECK_ERROR_MSG(ret, "Scalable endpoint close failed (%s)\n", fi_strerror(errno));
+        free(shmem_transport_ofi_sep_tx_used);
+    }
+
+    for (int r = 1; r < shmem_transport_ofi_num_rails; r++)
+        free_rail_resources(&shmem_transport_ofi_rails[r]);
+    free(shmem_transport_ofi_rails);
+
     ret = fi_close(&shmem_transport_ofi_target_ep->fid);
     OFI_CHECK_ERROR_MSG(ret, "Target endpoint close failed (%s)\n", fi_strerror(errno));
 
@@ -1811,13 +3565,16 @@ int shmem_transport_fini(void)
     ret = fi_close(&shmem_transport_ofi_fabfd->fid);
     OFI_CHECK_ERROR_MSG(ret, "Fabric close failed (%s)\n", fi_strerror(errno));
 
-#ifdef USE_AV_MAP
     free(addr_table);
+    free(shmem_transport_ofi_peer_ready);
+#ifndef ENABLE_MR_SCALABLE
+    free(shmem_transport_ofi_peer_mr);
 #endif
 
     fi_freeinfo(shmem_transport_ofi_info.fabrics);
 
     SHMEM_MUTEX_DESTROY(shmem_transport_ofi_lock);
+    SHMEM_MUTEX_DESTROY(shmem_transport_ofi_peer_lock);
 
     return 0;
 }
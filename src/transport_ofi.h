@@ -47,24 +47,42 @@ extern struct fid_cntr*                 shmem_transport_ofi_target_cntrfd;
 extern struct fid_cq*                   shmem_transport_ofi_target_cq;
 #endif
 #ifndef ENABLE_MR_SCALABLE
-extern uint64_t*                        shmem_transport_ofi_target_heap_keys;
-extern uint64_t*                        shmem_transport_ofi_target_data_keys;
-#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-extern int                              shmem_transport_ofi_use_absolute_address;
-#else
-extern uint8_t**                        shmem_transport_ofi_target_heap_addrs;
-extern uint8_t**                        shmem_transport_ofi_target_data_addrs;
-#endif /* ENABLE_REMOTE_VIRTUAL_ADDRESSING */
+/* Per-PE remote memory translation, indexed by symmetric segment ID.  The
+ * target address of an access is base[seg] + offset, where base is the remote
+ * segment address, the local segment address (FI_MR_VIRT_ADDR with remote
+ * virtual addressing), or zero (offset-based MRs). */
+typedef struct shmem_transport_ofi_peer_mr_t {
+    uint64_t  key[SHMEM_INTERNAL_NSEG];
+    uint8_t  *base[SHMEM_INTERNAL_NSEG];
+} shmem_transport_ofi_peer_mr_t;
+
+extern shmem_transport_ofi_peer_mr_t*   shmem_transport_ofi_peer_mr;
 #endif /* ENABLE_MR_SCALABLE */
 extern uint64_t                         shmem_transport_ofi_max_poll;
 extern long                             shmem_transport_ofi_put_poll_limit;
 extern long                             shmem_transport_ofi_get_poll_limit;
 extern size_t                           shmem_transport_ofi_max_buffered_send;
 extern size_t                           shmem_transport_ofi_max_msg_size;
+extern size_t                           shmem_transport_ofi_get_frag_size;
+extern long                             shmem_transport_ofi_get_window;
+extern size_t                           shmem_transport_ofi_iov_limit;
+extern size_t                           shmem_transport_ofi_rma_iov_limit;
 extern size_t                           shmem_transport_ofi_bounce_buffer_size;
 extern long                             shmem_transport_ofi_max_bounce_buffers;
+extern int                              shmem_transport_ofi_num_bounce_classes;
+extern size_t                           shmem_transport_ofi_bounce_class_size[];
+extern long                             shmem_transport_ofi_cq_batch_size;
+extern size_t                           shmem_transport_ofi_aggr_size;
+extern double                           shmem_transport_ofi_aggr_timeout;
+extern size_t                           shmem_transport_ofi_signal_order_size;
+extern long                             shmem_transport_ofi_pe_cntr_mask;
+extern uint8_t*                         shmem_transport_ofi_peer_ready;
 
 extern pthread_mutex_t                  shmem_transport_ofi_progress_lock;
+extern int                              shmem_transport_ofi_progress_thread_enabled;
+extern void*                            shmem_transport_ofi_heap_desc;
+extern void*                            shmem_transport_ofi_data_desc;
+extern long                             shmem_transport_ofi_mr_cache_size;
 
 #ifndef MIN
 #define MIN(a,b) (((a)<(b))?(a):(b))
@@ -118,30 +136,35 @@ extern pthread_mutex_t                  shmem_transport_ofi_progress_lock;
     } while (0)
 
 
+void shmem_transport_ofi_peer_connect(int pe);
+
+/* With SHMEM_OFI_LAZY_CONNECT, the address and memory keys of a PE are fetched
+ * from the runtime on the first communication with it.  Every operation looks
+ * up the target's memory region before it is issued, so the check is made
+ * there. */
+static inline
+void shmem_transport_ofi_peer_check(int pe)
+{
+    if (shmem_transport_ofi_peer_ready != NULL &&
+        !__atomic_load_n(&shmem_transport_ofi_peer_ready[pe], __ATOMIC_ACQUIRE))
+        shmem_transport_ofi_peer_connect(pe);
+}
+
 #ifdef ENABLE_MR_SCALABLE
 static inline
 void shmem_transport_ofi_get_mr(const void *addr, int dest_pe,
                                 uint8_t **mr_addr, uint64_t *key) {
+    shmem_transport_ofi_peer_check(dest_pe);
+
 #ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
     *key = 0;
     *mr_addr = (uint8_t*) addr;
 #else
-    if ((void*) addr >= shmem_internal_data_base &&
-        (uint8_t*) addr < (uint8_t*) shmem_internal_data_base + shmem_internal_data_length) {
-
-        *key = 0;
-        *mr_addr = (uint8_t*) ((uint8_t *) addr - (uint8_t *) shmem_internal_data_base);
+    size_t offset;
 
-    } else if ((void*) addr >= shmem_internal_heap_base &&
-               (uint8_t*) addr < (uint8_t*) shmem_internal_heap_base + shmem_internal_heap_length) {
-
-        *key = 1;
-        *mr_addr = (uint8_t*) ((uint8_t *) addr - (uint8_t *) shmem_internal_heap_base);
-    } else {
-        *key = 0;
-        *mr_addr = NULL;
-        RAISE_ERROR_MSG("address (%p) outside of symmetric areas\n", addr);
-    }
+    /* Segments are registered with the segment ID as the requested key */
+    *key = shmem_internal_seg_lookup(addr, &offset);
+    *mr_addr = (uint8_t*) offset;
 #endif /* ENABLE_REMOTE_VIRTUAL_ADDRESSING */
 
 }
@@ -150,39 +173,17 @@ void shmem_transport_ofi_get_mr(const void *addr, int dest_pe,
 static inline
 void shmem_transport_ofi_get_mr(const void *addr, int dest_pe,
                                 uint8_t **mr_addr, uint64_t *key) {
-    if ((void*) addr >= shmem_internal_data_base &&
-        (uint8_t*) addr < (uint8_t*) shmem_internal_data_base + shmem_internal_data_length) {
-        *key = shmem_transport_ofi_target_data_keys[dest_pe];
-#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-        if (shmem_transport_ofi_use_absolute_address)
-            *mr_addr = (uint8_t *) addr;
-        else
-            *mr_addr = (void *) ((uint8_t *) addr - (uint8_t *) shmem_internal_data_base);
-#else
-        *mr_addr = shmem_transport_ofi_target_data_addrs[dest_pe] +
-            ((uint8_t *) addr - (uint8_t *) shmem_internal_data_base);
-#endif
-    }
+    const shmem_transport_ofi_peer_mr_t *peer_mr;
+    size_t offset;
+    int seg;
 
-    else if ((void*) addr >= shmem_internal_heap_base &&
-             (uint8_t*) addr < (uint8_t*) shmem_internal_heap_base + shmem_internal_heap_length) {
-        *key = shmem_transport_ofi_target_heap_keys[dest_pe];
-#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-        if (shmem_transport_ofi_use_absolute_address)
-            *mr_addr = (uint8_t *) addr;
-        else
-            *mr_addr = (void *) ((uint8_t *) addr - (uint8_t *) shmem_internal_heap_base);
-#else
-        *mr_addr = shmem_transport_ofi_target_heap_addrs[dest_pe] +
-            ((uint8_t *) addr - (uint8_t *) shmem_internal_heap_base);
-#endif
-    }
+    shmem_transport_ofi_peer_check(dest_pe);
 
-    else {
-        *key = -1;
-        *mr_addr = NULL;
-        RAISE_ERROR_MSG("address (%p) outside of symmetric areas\n", addr);
-    }
+    seg = shmem_internal_seg_lookup(addr, &offset);
+    peer_mr = &shmem_transport_ofi_peer_mr[dest_pe];
+
+    *key = peer_mr->key[seg];
+    *mr_addr = peer_mr->base[seg] + offset;
 }
 #endif
 
@@ -204,6 +205,8 @@ typedef enum fi_op       shm_internal_op_t;
 
 #define SHMEM_TRANSPORT_OFI_TYPE_BOUNCE 0x01
 #define SHMEM_TRANSPORT_OFI_TYPE_LONG   0x02
+#define SHMEM_TRANSPORT_OFI_TYPE_GET    0x04
+#define SHMEM_TRANSPORT_OFI_TYPE_PUT    0x08
 
 
 extern fi_addr_t *addr_table;
@@ -211,17 +214,45 @@ extern fi_addr_t *addr_table;
 #ifdef USE_AV_MAP
 #define GET_DEST(dest) ((fi_addr_t)(addr_table[(dest)]))
 #else
-#define GET_DEST(dest) ((fi_addr_t)(dest))
+/* Lazily connected peers are inserted out of order and need the table */
+#define GET_DEST(dest) (addr_table ? addr_table[(dest)] : (fi_addr_t)(dest))
 #endif
 
 
 struct shmem_transport_ofi_frag_t {
     shmem_free_list_item_t item;
     uint8_t mytype;
+    uint8_t bb_class;
+    /* Slot in the per-PE counter table, or -1 if untracked */
+    int pe_slot;
 };
 
 typedef struct shmem_transport_ofi_frag_t shmem_transport_ofi_frag_t;
 
+/* Per-PE completion tracking.  When SHMEM_OFI_PE_CNTR_TABLE_SIZE is nonzero,
+ * destination PEs are hashed into a table of counters and every operation
+ * completed by the put counter also requests a CQ entry that identifies its
+ * slot.  A fence records the number of operations issued to each slot instead
+ * of waiting for all outstanding operations, and the next operation to a PE
+ * waits only until its slot has caught up with that count.  PEs that share a
+ * slot are ordered together. */
+struct shmem_transport_ofi_pe_cntr_t {
+    shmem_internal_cntr_t           issued;
+    shmem_internal_cntr_t           completed;
+    /* Issued count recorded by the last fence */
+    uint64_t                        fence;
+};
+
+typedef struct shmem_transport_ofi_pe_cntr_t shmem_transport_ofi_pe_cntr_t;
+
+/* Completion contexts of tracked operations that have no bounce buffer carry
+ * their slot with the low bit set, which no frag pointer has */
+#define SHMEM_TRANSPORT_OFI_PE_CNTR_CTX(slot)                                   \
+    ((slot) < 0 ? NULL : (void *) ((((uintptr_t) (slot)) << 1) | 1))
+#define SHMEM_TRANSPORT_OFI_PE_CNTR_IS_CTX(ptr) (((uintptr_t) (ptr)) & 1)
+#define SHMEM_TRANSPORT_OFI_PE_CNTR_SLOT(ptr) ((int) (((uintptr_t) (ptr)) >> 1))
+#define SHMEM_TRANSPORT_OFI_PE_CNTR_FLAGS(slot) ((slot) < 0 ? 0 : FI_COMPLETION)
+
 struct shmem_transport_ofi_bounce_buffer_t {
     shmem_transport_ofi_frag_t frag;
     uint8_t data[];
@@ -229,8 +260,150 @@ struct shmem_transport_ofi_bounce_buffer_t {
 
 typedef struct shmem_transport_ofi_bounce_buffer_t shmem_transport_ofi_bounce_buffer_t;
 
+/* Completion object of a streamed get fragment, set by the CQ drain */
+struct shmem_transport_ofi_get_frag_t {
+    shmem_transport_ofi_frag_t frag;
+    int done;
+};
+
+typedef struct shmem_transport_ofi_get_frag_t shmem_transport_ofi_get_frag_t;
+
+/* Completion object of the writes of an unpacked strided put, counted down by
+ * the CQ drain */
+struct shmem_transport_ofi_put_frag_t {
+    shmem_transport_ofi_frag_t frag;
+    uint64_t pending;
+};
+
+typedef struct shmem_transport_ofi_put_frag_t shmem_transport_ofi_put_frag_t;
+
+/* Upper bound on the number of streamed get fragments in flight */
+#define SHMEM_TRANSPORT_OFI_MAX_GET_WINDOW 64
+
+/* Bounce buffers are drawn from size-classed pools.  Class sizes start at
+ * SHMEM_TRANSPORT_OFI_BB_MIN_SIZE and grow by SHMEM_TRANSPORT_OFI_BB_CLASS_FACTOR
+ * up to the bounce buffer size.  The context's byte budget is
+ * SHMEM_MAX_BOUNCE_BUFFERS full-sized buffers, and each class starts with an
+ * equal share of it; when a class saturates, its limit is doubled as long as
+ * the context's in-flight bytes stay within the budget. */
+#define SHMEM_TRANSPORT_OFI_BB_MIN_SIZE     256
+#define SHMEM_TRANSPORT_OFI_BB_CLASS_FACTOR 8
+#define SHMEM_TRANSPORT_OFI_BB_MAX_CLASSES  8
+
+/* Upper bound on the number of local or remote iovs in a single vectored RMA
+ * operation; the provider's iov_limit and rma_iov_limit are clamped to it. */
+#define SHMEM_TRANSPORT_OFI_MAX_IOV 8
+
+struct shmem_transport_ofi_bounce_pool_t {
+    shmem_free_list_t              *fl;
+    size_t                          size;
+    /* Limit is raised under the BB lock and read without it */
+    uint64_t                        limit;
+    uint64_t                        max_limit;
+    /* Statistics */
+    uint64_t                        hwm;
+    uint64_t                        grow_cnt;
+    uint64_t                        stall_cnt;
+};
+
+typedef struct shmem_transport_ofi_bounce_pool_t shmem_transport_ofi_bounce_pool_t;
+
+/* Write-combining state for SHMEMX_CTX_AGGREGATE contexts.  Small puts to the
+ * same PE and memory region are packed into a bounce buffer and issued as a
+ * single fi_writemsg() with one RMA iov per contiguous run of target
+ * addresses.  The aggregate is flushed on fence and quiet, when it reaches
+ * SHMEM_OFI_AGGREGATE_SIZE bytes or runs out of RMA iovs, when a put targets a
+ * different PE or region, and when a put arrives after the aggregate has been
+ * open for longer than SHMEM_OFI_AGGREGATE_TIMEOUT. */
+
+struct shmem_transport_ofi_aggr_t {
+    shmem_transport_ofi_bounce_buffer_t *buff;
+    int                             pe;
+    uint64_t                        key;
+    size_t                          len;
+    size_t                          niov;
+    struct fi_rma_iov               rma_iov[SHMEM_TRANSPORT_OFI_MAX_IOV];
+    double                          start;
+    /* Statistics */
+    uint64_t                        put_cnt;
+    uint64_t                        flush_cnt;
+#if defined(ENABLE_THREADS) && !defined(USE_CTX_LOCK)
+    shmem_internal_mutex_t          lock;
+#endif
+};
+
+typedef struct shmem_transport_ofi_aggr_t shmem_transport_ofi_aggr_t;
+
+/* Multi-rail.  With SHMEM_OFI_NUM_RAILS greater than one, additional domains
+ * ("rails") are opened alongside the primary one, each with its own target
+ * endpoint, memory registrations, and address vector, and every context gets
+ * a transmit endpoint on each of them.  The primary domain is rail 0 and
+ * carries all atomics and all injected, bounce buffered, aggregated, strided,
+ * and signaling puts.  Other RMA transfers are assigned a rail by hashing the
+ * destination PE, and transfers of at least SHMEM_OFI_RAIL_STRIPE_SIZE bytes
+ * are split evenly across all rails.  Operations on the additional rails are
+ * completed by quiet, and fence waits for them, since the rails are not
+ * ordered with respect to one another. */
+#define SHMEM_TRANSPORT_OFI_MAX_RAILS 8
+
+struct shmem_transport_ofi_rail_t {
+    struct fi_info                 *info;
+    struct fid_fabric              *fabric;
+    struct fid_domain              *domain;
+    struct fid_av                  *av;
+    struct fid_ep                  *target_ep;
+    struct fid_cq                  *target_cq;
+#if ENABLE_TARGET_CNTR
+    struct fid_cntr                *target_cntr;
+#endif
+#if defined(ENABLE_MR_SCALABLE) && defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+    struct fid_mr                  *mr;
+#else
+    struct fid_mr                  *heap_mr;
+    struct fid_mr                  *data_mr;
+#endif
+#ifndef ENABLE_MR_SCALABLE
+    shmem_transport_ofi_peer_mr_t  *peer_mr;
+#endif
+    fi_addr_t                      *addr_table;
+    size_t                          addrlen;
+    size_t                          max_msg_size;
+};
+
+typedef struct shmem_transport_ofi_rail_t shmem_transport_ofi_rail_t;
+
+/* Transmit resources of a context on an additional rail */
+struct shmem_transport_ofi_ctx_rail_t {
+    struct fid_ep*                  ep;
+    struct fid_cntr*                put_cntr;
+    struct fid_cntr*                get_cntr;
+    struct fid_cq*                  cq;
+#ifdef USE_CTX_LOCK
+    uint64_t                        pending_put_cntr;
+    uint64_t                        pending_get_cntr;
+#else
+    shmem_internal_cntr_t           pending_put_cntr;
+    shmem_internal_cntr_t           pending_get_cntr;
+#endif
+};
+
+typedef struct shmem_transport_ofi_ctx_rail_t shmem_transport_ofi_ctx_rail_t;
+
+/* Rail tables are indexed by rail number; entry 0 is unused, since the
+ * primary domain's resources are kept in the existing globals and context
+ * fields */
+extern int                              shmem_transport_ofi_num_rails;
+extern size_t                           shmem_transport_ofi_rail_stripe_size;
+extern shmem_transport_ofi_rail_t      *shmem_transport_ofi_rails;
+
 typedef int shmem_transport_ct_t;
 
+/* Per-context cache of local buffer registrations */
+struct shmem_transport_ofi_mr_cache_t;
+struct shmem_transport_ofi_mr_entry_t;
+typedef struct shmem_transport_ofi_mr_cache_t shmem_transport_ofi_mr_cache_t;
+typedef struct shmem_transport_ofi_mr_entry_t shmem_transport_ofi_mr_entry_t;
+
 enum shmem_internal_tid_t { tid_is_pid_t, tid_is_uint64_t };
 struct shmem_internal_tid
 {
@@ -260,20 +433,100 @@ struct shmem_transport_ctx_t {
     shmem_internal_cntr_t           pending_put_cntr;
     shmem_internal_cntr_t           pending_get_cntr;
 #endif
-    /* These counters are protected by the BB lock */
-    uint64_t                        pending_bb_cntr;
-    uint64_t                        completed_bb_cntr;
-    shmem_free_list_t              *bounce_buffers;
+    /* Bounce buffers are allocated and released lock-free; the BB lock only
+     * serializes draining of the CQ */
+    shmem_internal_cntr_t           pending_bb_cntr;
+    shmem_internal_cntr_t           completed_bb_cntr;
+    shmem_transport_ofi_bounce_pool_t *bounce_buffers;
+    struct fi_cq_entry             *cq_ring;
+    /* Number of non-empty CQ reads and entries they returned */
+    shmem_internal_cntr_t           cq_batch_cntr;
+    shmem_internal_cntr_t           cq_entry_cntr;
+#ifdef ENABLE_THREADS
+    shmem_internal_mutex_t          bb_lock;
+#endif
+    shmem_transport_ofi_aggr_t      aggr;
+    shmem_transport_ofi_pe_cntr_t  *pe_cntr;
+    uint64_t                        pe_fence_wait_cnt;
     int                             stx_idx;
+    /* Transmit context of the scalable endpoint, -1 when using an STX */
+    int                             sep_idx;
+    /* Operations already credited to the STX, quiets since the last
+     * rebalancing check, and the STX's and this context's operation counts
+     * at that check (load STX allocator only) */
+    uint64_t                        stx_credited;
+    long                            stx_quiet_cnt;
+    uint64_t                        stx_check_ops;
+    uint64_t                        stx_check_credited;
     struct shmem_internal_tid       tid;
     struct shmem_internal_team_t   *team;
+    /* Endpoints on the additional rails, NULL with a single rail */
+    shmem_transport_ofi_ctx_rail_t *rails;
+    /* Local registrations, NULL when the registration cache is disabled */
+    shmem_transport_ofi_mr_cache_t *mr_cache;
 };
 
 typedef struct shmem_transport_ctx_t shmem_transport_ctx_t;
 extern shmem_transport_ctx_t shmem_transport_ctx_default;
 
+/* Occupancy of one STX.  ops counts the operations issued through the STX, as
+ * credited by its contexts when they quiet, and load is the decayed count
+ * used by the load-aware allocator. */
+struct shmem_transport_ofi_stx_stats_t {
+    long                            ref_cnt;
+    int                             is_private;
+    uint64_t                        ops;
+    uint64_t                        load;
+};
+
+typedef struct shmem_transport_ofi_stx_stats_t shmem_transport_ofi_stx_stats_t;
+
+/* Fill in up to nstats entries and return the number of STXs */
+int shmem_transport_ofi_stx_stats(shmem_transport_ofi_stx_stats_t *stats, int nstats);
+
+extern int shmem_transport_ofi_stx_load_tracking;
+void shmem_transport_ofi_stx_credit(shmem_transport_ctx_t *ctx);
+
 extern struct fid_ep* shmem_transport_ofi_target_ep;
 
+void *shmem_transport_ofi_mr_cache_acquire(shmem_transport_ctx_t *ctx, const void *addr,
+                                           size_t len, shmem_transport_ofi_mr_entry_t **entry);
+void shmem_transport_ofi_mr_cache_release(shmem_transport_ofi_mr_entry_t *entry);
+
+/* Return the descriptor for a local buffer used by a transfer that bypasses
+ * the bounce buffers, or NULL when none is available.  The symmetric
+ * segments are registered for local access at startup; other buffers use the
+ * context's registration cache, which holds *entry until it is released with
+ * shmem_transport_ofi_local_desc_release() after the transfer is issued. */
+static inline
+void *shmem_transport_ofi_local_desc(shmem_transport_ctx_t *ctx, const void *addr,
+                                     size_t len, shmem_transport_ofi_mr_entry_t **entry)
+{
+    *entry = NULL;
+
+#if !defined(ENABLE_MR_SCALABLE) || !defined(ENABLE_REMOTE_VIRTUAL_ADDRESSING)
+    if ((size_t) ((uint8_t *) addr - (uint8_t *) shmem_internal_heap_base) <
+        (size_t) shmem_internal_heap_length)
+        return shmem_transport_ofi_heap_desc;
+
+    if ((size_t) ((uint8_t *) addr - (uint8_t *) shmem_internal_data_base) <
+        (size_t) shmem_internal_data_length)
+        return shmem_transport_ofi_data_desc;
+#endif
+
+    if (ctx->mr_cache == NULL || len <= shmem_transport_ofi_bounce_buffer_size)
+        return NULL;
+
+    return shmem_transport_ofi_mr_cache_acquire(ctx, addr, len, entry);
+}
+
+static inline
+void shmem_transport_ofi_local_desc_release(shmem_transport_ofi_mr_entry_t *entry)
+{
+    if (entry)
+        shmem_transport_ofi_mr_cache_release(entry);
+}
+
 #ifdef USE_CTX_LOCK
 #define SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx)                                       \
     do {                                                                        \
@@ -299,32 +552,79 @@ extern struct fid_ep* shmem_transport_ofi_target_ep;
 
 #define SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx)                                    \
     do {                                                                        \
-        shmem_internal_assert(ctx->bounce_buffers != NULL);                     \
+        shmem_internal_assert((ctx)->cq_ring != NULL);                          \
         if (!((ctx)->options & (SHMEM_CTX_PRIVATE | SHMEM_CTX_SERIALIZED)))     \
-            shmem_free_list_lock(ctx->bounce_buffers);                          \
+            SHMEM_MUTEX_LOCK((ctx)->bb_lock);                                   \
     } while (0)
 
 #define SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx)                                  \
     do {                                                                        \
         if (!((ctx)->options & (SHMEM_CTX_PRIVATE | SHMEM_CTX_SERIALIZED)))     \
-            shmem_free_list_unlock(ctx->bounce_buffers);                        \
+            SHMEM_MUTEX_UNLOCK((ctx)->bb_lock);                                 \
+    } while (0)
+
+#ifdef USE_CTX_LOCK
+/* Aggregation state is protected by the ctx lock */
+#define SHMEM_TRANSPORT_OFI_CTX_AGGR_LOCK(ctx)
+#define SHMEM_TRANSPORT_OFI_CTX_AGGR_UNLOCK(ctx)
+#else
+#define SHMEM_TRANSPORT_OFI_CTX_AGGR_LOCK(ctx)                                  \
+    do {                                                                        \
+        if (!((ctx)->options & (SHMEM_CTX_PRIVATE | SHMEM_CTX_SERIALIZED)))     \
+            SHMEM_MUTEX_LOCK((ctx)->aggr.lock);                                 \
+    } while (0)
+
+#define SHMEM_TRANSPORT_OFI_CTX_AGGR_UNLOCK(ctx)                                \
+    do {                                                                        \
+        if (!((ctx)->options & (SHMEM_CTX_PRIVATE | SHMEM_CTX_SERIALIZED)))     \
+            SHMEM_MUTEX_UNLOCK((ctx)->aggr.lock);                               \
     } while (0)
+#endif /* USE_CTX_LOCK */
+
+/* The target CQ is accessed under the progress lock when completion-level
+ * threading is used or when the progress thread is running */
+static inline
+int shmem_transport_ofi_target_trylock(void)
+{
+#if defined(USE_THREAD_COMPLETION)
+    return pthread_mutex_trylock(&shmem_transport_ofi_progress_lock);
+#elif defined(ENABLE_THREADS)
+    if (!shmem_transport_ofi_progress_thread_enabled)
+        return 0;
+    return pthread_mutex_trylock(&shmem_transport_ofi_progress_lock);
+#else
+    return 0;
+#endif
+}
+
+static inline
+void shmem_transport_ofi_target_unlock(void)
+{
+#if defined(USE_THREAD_COMPLETION)
+    pthread_mutex_unlock(&shmem_transport_ofi_progress_lock);
+#elif defined(ENABLE_THREADS)
+    if (shmem_transport_ofi_progress_thread_enabled)
+        pthread_mutex_unlock(&shmem_transport_ofi_progress_lock);
+#endif
+}
 
 static inline
 void shmem_transport_probe(void)
 {
 #if defined(ENABLE_MANUAL_PROGRESS)
-#  ifdef USE_THREAD_COMPLETION
-    if (0 == pthread_mutex_trylock(&shmem_transport_ofi_progress_lock)) {
-#  endif
+    if (0 == shmem_transport_ofi_target_trylock()) {
         struct fi_cq_entry buf;
+        int r;
         int ret = fi_cq_read(shmem_transport_ofi_target_cq, &buf, 1);
         if (ret == 1)
             RAISE_WARN_STR("Unexpected event");
-#  ifdef USE_THREAD_COMPLETION
-        pthread_mutex_unlock(&shmem_transport_ofi_progress_lock);
+        for (r = 1; r < shmem_transport_ofi_num_rails; r++) {
+            ret = fi_cq_read(shmem_transport_ofi_rails[r].target_cq, &buf, 1);
+            if (ret == 1)
+                RAISE_WARN_STR("Unexpected event");
+        }
+        shmem_transport_ofi_target_unlock();
     }
-#  endif
 #endif
 
     return;
@@ -341,30 +641,80 @@ extern size_t SHMEM_Dtsize[FI_DATATYPE_LAST];
 
 static inline void shmem_transport_get_wait(shmem_transport_ctx_t* ctx);
 
-/* Drain all available events from the CQ.  Note, ctx->bounce_buffers must be
- * locked before calling this routine */
+/* Drain all available events from the CQ.  Completions are read in batches of
+ * up to shmem_transport_ofi_cq_batch_size entries into the context's CQ ring,
+ * and the bounce buffers of each batch are returned to their pools with a
+ * single operation per size class.  Completions of tracked operations are
+ * credited to their slot in the per-PE counter table, and streamed get
+ * fragments are marked done.  Note, the BB lock must be held before calling
+ * this routine */
 static inline
 void shmem_transport_ofi_drain_cq(shmem_transport_ctx_t *ctx)
 {
     ssize_t ret = 0;
-    struct fi_cq_entry buf;
+    shmem_free_list_item_t *first[SHMEM_TRANSPORT_OFI_BB_MAX_CLASSES];
+    shmem_free_list_item_t *last[SHMEM_TRANSPORT_OFI_BB_MAX_CLASSES];
+    uint64_t count[SHMEM_TRANSPORT_OFI_BB_MAX_CLASSES];
+    uint64_t nbb;
+    ssize_t i;
+    int c;
 
     for (;;) {
-        ret = fi_cq_read(ctx->cq, (void *)&buf, 1);
+        ret = fi_cq_read(ctx->cq, (void *)ctx->cq_ring,
+                         shmem_transport_ofi_cq_batch_size);
 
         if (ret == -FI_EAGAIN) break; /* No events */
 
-        else if (ret == 1) {
-            shmem_transport_ofi_frag_t *frag =
-                (shmem_transport_ofi_frag_t *) buf.op_context;
+        else if (ret > 0) {
+            for (c = 0; c < shmem_transport_ofi_num_bounce_classes; c++)
+                count[c] = 0;
+            nbb = 0;
 
-            if (SHMEM_TRANSPORT_OFI_TYPE_BOUNCE == frag->mytype) {
-                shmem_free_list_free(ctx->bounce_buffers,
-                                     (shmem_transport_ofi_bounce_buffer_t *) frag);
-                ctx->completed_bb_cntr++;
-            } else {
-                RAISE_ERROR_STR("Unrecognized completion object");
+            for (i = 0; i < ret; i++) {
+                void *op_context = ctx->cq_ring[i].op_context;
+                shmem_transport_ofi_frag_t *frag;
+
+                if (SHMEM_TRANSPORT_OFI_PE_CNTR_IS_CTX(op_context)) {
+                    shmem_internal_cntr_inc(&ctx->pe_cntr[SHMEM_TRANSPORT_OFI_PE_CNTR_SLOT(op_context)].completed);
+                    continue;
+                }
+
+                frag = (shmem_transport_ofi_frag_t *) op_context;
+
+                if (SHMEM_TRANSPORT_OFI_TYPE_BOUNCE == frag->mytype) {
+                    if (frag->pe_slot >= 0)
+                        shmem_internal_cntr_inc(&ctx->pe_cntr[frag->pe_slot].completed);
+                    c = frag->bb_class;
+                    frag->item.next = count[c] ? first[c] : NULL;
+                    if (count[c] == 0) last[c] = &frag->item;
+                    first[c] = &frag->item;
+                    count[c]++;
+                    nbb++;
+                } else if (SHMEM_TRANSPORT_OFI_TYPE_GET == frag->mytype) {
+                    __atomic_store_n(&((shmem_transport_ofi_get_frag_t *) frag)->done, 1,
+                                     __ATOMIC_RELEASE);
+                } else if (SHMEM_TRANSPORT_OFI_TYPE_PUT == frag->mytype) {
+                    if (frag->pe_slot >= 0)
+                        shmem_internal_cntr_inc(&ctx->pe_cntr[frag->pe_slot].completed);
+                    __atomic_fetch_sub(&((shmem_transport_ofi_put_frag_t *) frag)->pending, 1,
+                                       __ATOMIC_RELEASE);
+                } else {
+                    RAISE_ERROR_STR("Unrecognized completion object");
+                }
             }
+
+            for (c = 0; c < shmem_transport_ofi_num_bounce_classes; c++) {
+                if (count[c])
+                    shmem_free_list_free_chain(ctx->bounce_buffers[c].fl,
+                                               first[c], last[c], count[c]);
+            }
+
+            shmem_internal_cntr_add(&ctx->completed_bb_cntr, nbb);
+            shmem_internal_cntr_inc(&ctx->cq_batch_cntr);
+            shmem_internal_cntr_add(&ctx->cq_entry_cntr, ret);
+
+            /* A short read means the CQ was empty */
+            if (ret < shmem_transport_ofi_cq_batch_size) break;
         }
 
         else if (ret < 0) {
@@ -377,49 +727,354 @@ void shmem_transport_ofi_drain_cq(shmem_transport_ctx_t *ctx)
     }
 }
 
+/* Total number of bounce buffers in flight, across all classes */
 static inline
-shmem_transport_ofi_bounce_buffer_t * create_bounce_buffer(shmem_transport_ctx_t *ctx,
-                                                           const void *source,
-                                                           const size_t len)
+uint64_t shmem_transport_ofi_bounce_nalloc(shmem_transport_ctx_t *ctx)
 {
-    shmem_transport_ofi_bounce_buffer_t *buff;
+    uint64_t nalloc = 0;
+    int i;
 
-    SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
+    for (i = 0; i < shmem_transport_ofi_num_bounce_classes; i++)
+        nalloc += shmem_free_list_nalloc(ctx->bounce_buffers[i].fl);
 
-    shmem_internal_assert(shmem_transport_ofi_max_bounce_buffers > 0);
+    return nalloc;
+}
 
-    while (ctx->bounce_buffers->nalloc >= (uint64_t) shmem_transport_ofi_max_bounce_buffers) {
-        shmem_transport_ofi_drain_cq(ctx);
+/* Try to raise the limit of a saturated bounce buffer class.  Returns 1 if the
+ * limit was raised.  Note, the BB lock must be held before calling this
+ * routine */
+static inline
+int shmem_transport_ofi_bounce_grow(shmem_transport_ctx_t *ctx,
+                                    shmem_transport_ofi_bounce_pool_t *pool)
+{
+    const uint64_t budget = (uint64_t) shmem_transport_ofi_max_bounce_buffers *
+                            shmem_transport_ofi_bounce_buffer_size;
+    uint64_t inflight = 0, limit;
+    int i;
+
+    if (pool->limit >= pool->max_limit)
+        return 0;
+
+    for (i = 0; i < shmem_transport_ofi_num_bounce_classes; i++)
+        inflight += shmem_free_list_nalloc(ctx->bounce_buffers[i].fl) *
+                    ctx->bounce_buffers[i].size;
+
+    if (inflight + pool->size > budget)
+        return 0;
+
+    limit = MIN(pool->limit * 2, pool->max_limit);
+    __atomic_store_n(&pool->limit, limit, __ATOMIC_RELAXED);
+    pool->grow_cnt++;
+
+    return 1;
+}
+
+/* Pick the smallest bounce buffer class that can hold len bytes */
+static inline
+shmem_transport_ofi_bounce_pool_t *
+shmem_transport_ofi_bounce_pool(shmem_transport_ctx_t *ctx, size_t len)
+{
+    int i = 0;
+
+    while (len > ctx->bounce_buffers[i].size) {
+        i++;
+        shmem_internal_assert(i < shmem_transport_ofi_num_bounce_classes);
     }
 
-    buff = (shmem_transport_ofi_bounce_buffer_t*) shmem_free_list_alloc(ctx->bounce_buffers);
-    ctx->pending_bb_cntr++;
+    return &ctx->bounce_buffers[i];
+}
 
-    SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
+static inline
+shmem_transport_ofi_bounce_buffer_t * alloc_bounce_buffer(shmem_transport_ctx_t *ctx,
+                                                          const size_t len)
+{
+    shmem_transport_ofi_bounce_buffer_t *buff;
+    shmem_transport_ofi_bounce_pool_t *pool;
+    uint64_t nalloc, hwm;
+
+    shmem_internal_assert(ctx->bounce_buffers != NULL);
+    shmem_internal_assert(shmem_transport_ofi_max_bounce_buffers > 0);
+
+    pool = shmem_transport_ofi_bounce_pool(ctx, len);
+
+    /* The fast path allocates without taking the BB lock.  Concurrent
+     * allocators may overshoot the limit by at most one buffer per thread. */
+    if (shmem_free_list_nalloc(pool->fl) >= __atomic_load_n(&pool->limit, __ATOMIC_RELAXED)) {
+        int stalled = 0;
+
+        SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
+        while (shmem_free_list_nalloc(pool->fl) >= pool->limit) {
+            if (shmem_transport_ofi_bounce_grow(ctx, pool))
+                break;
+            stalled = 1;
+            shmem_transport_ofi_drain_cq(ctx);
+        }
+        pool->stall_cnt += stalled;
+        SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
+    }
+
+    buff = (shmem_transport_ofi_bounce_buffer_t*) shmem_free_list_alloc(pool->fl);
+    shmem_internal_cntr_inc(&ctx->pending_bb_cntr);
 
     if (NULL == buff)
         RAISE_ERROR_STR("Bounce buffer allocation failed");
 
     shmem_internal_assert(buff->frag.mytype == SHMEM_TRANSPORT_OFI_TYPE_BOUNCE);
+    buff->frag.bb_class = (uint8_t) (pool - ctx->bounce_buffers);
+    buff->frag.pe_slot  = -1;
+
+    nalloc = shmem_free_list_nalloc(pool->fl);
+    hwm = __atomic_load_n(&pool->hwm, __ATOMIC_RELAXED);
+    while (nalloc > hwm &&
+           !__atomic_compare_exchange_n(&pool->hwm, &hwm, nalloc, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    return buff;
+}
+
+static inline
+shmem_transport_ofi_bounce_buffer_t * create_bounce_buffer(shmem_transport_ctx_t *ctx,
+                                                           const void *source,
+                                                           const size_t len)
+{
+    shmem_transport_ofi_bounce_buffer_t *buff = alloc_bounce_buffer(ctx, len);
 
     memcpy(buff->data, source, len);
 
     return buff;
 }
 
+/* Wait for the operations ordered by a fence ahead of later operations to
+ * the PEs of the given slot to complete.  Note, the ctx lock must be held
+ * before calling this routine */
+static inline
+void shmem_transport_ofi_pe_wait(shmem_transport_ctx_t *ctx, int slot)
+{
+    shmem_transport_ofi_pe_cntr_t *c = &ctx->pe_cntr[slot];
+
+    if (shmem_internal_cntr_read(&c->completed) < __atomic_load_n(&c->fence, __ATOMIC_ACQUIRE)) {
+        long poll_count = 0;
+
+        SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
+        for (;;) {
+            uint64_t cnt = fi_cntr_read(ctx->put_cntr);
+
+            shmem_transport_ofi_drain_cq(ctx);
+            if (shmem_internal_cntr_read(&c->completed) >= __atomic_load_n(&c->fence, __ATOMIC_ACQUIRE))
+                break;
+
+            /* Sleep until the next completion, unless every issued operation
+             * has already been counted and the missing completions are CQ
+             * entries that trail their counter updates */
+            if ((poll_count < shmem_transport_ofi_put_poll_limit ||
+                 shmem_transport_ofi_put_poll_limit < 0) ||
+                cnt >= SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr)) {
+                SPINLOCK_BODY();
+                poll_count++;
+            } else {
+                ssize_t ret = fi_cntr_wait(ctx->put_cntr, cnt + 1, -1);
+                OFI_CTX_CHECK_ERROR(ctx, ret);
+            }
+        }
+        ctx->pe_fence_wait_cnt++;
+        SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
+    }
+}
+
+/* Account for an operation to pe in the per-PE counter table, first waiting
+ * for the operations ordered ahead of it by a fence to complete.  Returns the
+ * slot for the operation's completion context, or -1 if the context does not
+ * track completions per PE.  Note, the ctx lock must be held before calling
+ * this routine, and the operation must not yet be counted in
+ * pending_put_cntr */
+static inline
+int shmem_transport_ofi_pe_issue(shmem_transport_ctx_t *ctx, int pe)
+{
+    int slot;
+
+    if (ctx->pe_cntr == NULL)
+        return -1;
+
+    slot = pe & shmem_transport_ofi_pe_cntr_mask;
+    shmem_transport_ofi_pe_wait(ctx, slot);
+    shmem_internal_cntr_inc(&ctx->pe_cntr[slot].issued);
+
+    return slot;
+}
+
+static inline int try_again(shmem_transport_ctx_t *ctx, const int ret, uint64_t *polled);
+
+/* Issue the pending aggregate, if any.  Note, the ctx and aggregation locks
+ * must be held before calling this routine */
+static inline
+void shmem_transport_ofi_aggr_flush(shmem_transport_ctx_t *ctx)
+{
+    shmem_transport_ofi_aggr_t *aggr = &ctx->aggr;
+    uint64_t dst = (uint64_t) aggr->pe;
+    uint64_t polled = 0;
+    int ret = 0;
+
+    if (aggr->buff == NULL)
+        return;
+
+    aggr->buff->frag.pe_slot = shmem_transport_ofi_pe_issue(ctx, aggr->pe);
+    SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+
+    const struct iovec      msg_iov = { .iov_base = aggr->buff->data, .iov_len = aggr->len };
+    const struct fi_msg_rma msg     = {
+                                        .msg_iov       = &msg_iov,
+                                        .desc          = NULL,
+                                        .iov_count     = 1,
+                                        .addr          = GET_DEST(dst),
+                                        .rma_iov       = aggr->rma_iov,
+                                        .rma_iov_count = aggr->niov,
+                                        .context       = aggr->buff,
+                                        .data          = 0
+                                      };
+    do {
+        ret = fi_writemsg(ctx->ep, &msg, FI_COMPLETION | FI_DELIVERY_COMPLETE);
+    } while (try_again(ctx, ret, &polled));
+
+    aggr->flush_cnt++;
+    aggr->buff = NULL;
+    aggr->len  = 0;
+    aggr->niov = 0;
+}
+
+static inline
+void shmem_transport_ofi_aggr_flush_locked(shmem_transport_ctx_t *ctx)
+{
+    SHMEM_TRANSPORT_OFI_CTX_AGGR_LOCK(ctx);
+    shmem_transport_ofi_aggr_flush(ctx);
+    SHMEM_TRANSPORT_OFI_CTX_AGGR_UNLOCK(ctx);
+}
+
+/* Append a small put to the context's aggregate.  Note, the ctx lock must be
+ * held before calling this routine */
+static inline
+void shmem_transport_ofi_aggr_put(shmem_transport_ctx_t *ctx, uint8_t *addr,
+                                  uint64_t key, const void *source, size_t len,
+                                  int pe)
+{
+    shmem_transport_ofi_aggr_t *aggr = &ctx->aggr;
+    struct fi_rma_iov *last;
+    size_t i;
+
+    SHMEM_TRANSPORT_OFI_CTX_AGGR_LOCK(ctx);
+
+    if (aggr->buff != NULL) {
+        int flush = aggr->pe != pe || aggr->key != key ||
+                    aggr->len + len > shmem_transport_ofi_aggr_size;
+
+        last = &aggr->rma_iov[aggr->niov - 1];
+
+        /* Puts that extend the last run are always combined.  Otherwise the
+         * put needs a new iov and must not overlap any pending run, since the
+         * provider may apply the iovs in any order. */
+        if (!flush && last->addr + last->len != (uint64_t) addr) {
+            if (aggr->niov >= shmem_transport_ofi_rma_iov_limit)
+                flush = 1;
+            for (i = 0; !flush && i < aggr->niov; i++) {
+                if ((uint64_t) addr < aggr->rma_iov[i].addr + aggr->rma_iov[i].len &&
+                    aggr->rma_iov[i].addr < (uint64_t) addr + len)
+                    flush = 1;
+            }
+        }
+
+        if (!flush && shmem_transport_ofi_aggr_timeout > 0 &&
+            shmem_internal_wtime() - aggr->start > shmem_transport_ofi_aggr_timeout)
+            flush = 1;
+
+        if (flush)
+            shmem_transport_ofi_aggr_flush(ctx);
+    }
+
+    if (aggr->buff == NULL) {
+        aggr->buff  = alloc_bounce_buffer(ctx, shmem_transport_ofi_aggr_size);
+        aggr->pe    = pe;
+        aggr->key   = key;
+        if (shmem_transport_ofi_aggr_timeout > 0)
+            aggr->start = shmem_internal_wtime();
+    }
+
+    memcpy(aggr->buff->data + aggr->len, source, len);
+
+    last = aggr->niov ? &aggr->rma_iov[aggr->niov - 1] : NULL;
+    if (last != NULL && last->addr + last->len == (uint64_t) addr) {
+        last->len += len;
+    } else {
+        aggr->rma_iov[aggr->niov].addr = (uint64_t) addr;
+        aggr->rma_iov[aggr->niov].len  = len;
+        aggr->rma_iov[aggr->niov].key  = key;
+        aggr->niov++;
+    }
+    aggr->len += len;
+    aggr->put_cnt++;
+
+    if (aggr->len == shmem_transport_ofi_aggr_size)
+        shmem_transport_ofi_aggr_flush(ctx);
+
+    SHMEM_TRANSPORT_OFI_CTX_AGGR_UNLOCK(ctx);
+}
+
+/* Wait for the puts (or, if get is set, the gets) issued on the context's
+ * additional rails to complete.  Note, the ctx lock must be held before
+ * calling this routine */
+static inline
+void shmem_transport_ofi_rail_wait(shmem_transport_ctx_t *ctx, int get)
+{
+    uint64_t success, fail, cnt;
+    int r;
+
+    for (r = 1; r < shmem_transport_ofi_num_rails; r++) {
+        shmem_transport_ofi_ctx_rail_t *cr = &ctx->rails[r];
+        struct fid_cntr *cntr = get ? cr->get_cntr : cr->put_cntr;
+
+        for (;;) {
+            success = fi_cntr_read(cntr);
+            fail = fi_cntr_readerr(cntr);
+            cnt = get ? SHMEM_TRANSPORT_OFI_CNTR_READ(&cr->pending_get_cntr) :
+                        SHMEM_TRANSPORT_OFI_CNTR_READ(&cr->pending_put_cntr);
+
+            if (fail)
+                RAISE_ERROR_MSG("Operations completed in error on rail %d (%" PRIu64 ")\n",
+                                r, fail);
+            if (success >= cnt)
+                break;
+
+            shmem_transport_probe();
+            SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+            SPINLOCK_BODY();
+            SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        }
+    }
+}
+
 static inline
 void shmem_transport_put_quiet(shmem_transport_ctx_t* ctx)
 {
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
 
+    if (ctx->options & SHMEMX_CTX_AGGREGATE)
+        shmem_transport_ofi_aggr_flush_locked(ctx);
+
+    if (ctx->rails)
+        shmem_transport_ofi_rail_wait(ctx, 0);
+
     /* Wait for bounce buffered operations to complete */
     if (ctx->bounce_buffers) {
         SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
 
-        while (ctx->bounce_buffers->nalloc > 0) {
+        while (shmem_transport_ofi_bounce_nalloc(ctx) > 0) {
             shmem_transport_ofi_drain_cq(ctx);
         }
 
+        SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
+    } else if (ctx->pe_cntr) {
+        /* Credit completed operations so that the CQ does not fill up */
+        SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
+        shmem_transport_ofi_drain_cq(ctx);
         SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
     }
 
@@ -472,17 +1127,67 @@ int shmem_transport_quiet(shmem_transport_ctx_t* ctx)
     shmem_transport_put_quiet(ctx);
     shmem_transport_get_wait(ctx);
 
+    if (shmem_transport_ofi_stx_load_tracking && ctx->stx_idx >= 0)
+        shmem_transport_ofi_stx_credit(ctx);
+
     return 0;
 }
 
 
+/* Order the operations already issued to pe, or to all PEs if pe is -1, ahead
+ * of any later operation to the same PE.  Rather than waiting here, the issued
+ * count of each slot is recorded and later operations wait in
+ * shmem_transport_ofi_pe_issue(). */
+static inline
+void shmem_transport_ofi_pe_fence(shmem_transport_ctx_t *ctx, int pe)
+{
+    long i;
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+
+    if (ctx->options & SHMEMX_CTX_AGGREGATE)
+        shmem_transport_ofi_aggr_flush_locked(ctx);
+
+    if (pe >= 0) {
+        i = pe & shmem_transport_ofi_pe_cntr_mask;
+        __atomic_store_n(&ctx->pe_cntr[i].fence,
+                         shmem_internal_cntr_read(&ctx->pe_cntr[i].issued),
+                         __ATOMIC_RELEASE);
+    } else {
+        for (i = 0; i <= shmem_transport_ofi_pe_cntr_mask; i++)
+            __atomic_store_n(&ctx->pe_cntr[i].fence,
+                             shmem_internal_cntr_read(&ctx->pe_cntr[i].issued),
+                             __ATOMIC_RELEASE);
+    }
+
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+}
+
 static inline
 int shmem_transport_fence(shmem_transport_ctx_t* ctx)
 {
+    /* The rails are not ordered with respect to each other, so puts issued on
+     * the additional rails are always completed */
+    if (ctx->rails) {
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        shmem_transport_ofi_rail_wait(ctx, 0);
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+    }
+
 #if WANT_TOTAL_DATA_ORDERING == 0
     /* Communication is unordered; must wait for puts and buffered (injected)
-     * non-fetching atomics to be completed in order to ensure ordering. */
-    shmem_transport_put_quiet(ctx);
+     * non-fetching atomics to be completed in order to ensure ordering.  With
+     * per-PE tracking, the wait is deferred to the next operation to each PE. */
+    if (ctx->pe_cntr)
+        shmem_transport_ofi_pe_fence(ctx, -1);
+    else
+        shmem_transport_put_quiet(ctx);
+#else
+    if (ctx->options & SHMEMX_CTX_AGGREGATE) {
+        SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        shmem_transport_ofi_aggr_flush_locked(ctx);
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+    }
 #endif
     /* Complete fetching ops; needed to support nonblocking fetch-atomics */
     shmem_transport_get_wait(ctx);
@@ -499,7 +1204,7 @@ int try_again(shmem_transport_ctx_t *ctx, const int ret, uint64_t *polled) {
 
     if (ret) {
         if (ret == -FI_EAGAIN) {
-            if (ctx->bounce_buffers) {
+            if (ctx->bounce_buffers || ctx->pe_cntr) {
                 SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
                 shmem_transport_ofi_drain_cq(ctx);
                 SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
@@ -517,26 +1222,160 @@ int try_again(shmem_transport_ctx_t *ctx, const int ret, uint64_t *polled) {
                 }
             }
 
-            shmem_transport_probe();
+            shmem_transport_probe();
+
+            (*polled)++;
+
+            if ((*polled) <= shmem_transport_ofi_max_poll) {
+                return 1;
+            }
+            else {
+                RAISE_ERROR_MSG("Operation retry limit exceeded (%" PRIu64 ")\n",
+                                shmem_transport_ofi_max_poll);
+            }
+        }
+        else {
+            OFI_CTX_CHECK_ERROR(ctx, (ssize_t) ret);
+        }
+    }
+
+    return 0;
+}
+
+
+/* try_again() for an operation on an additional rail */
+static inline
+int shmem_transport_ofi_rail_try_again(shmem_transport_ofi_ctx_rail_t *cr, const int ret,
+                                       uint64_t *polled) {
+    if (ret == -FI_EAGAIN) {
+        struct fi_cq_err_entry e = {0};
+        ssize_t err_ret = fi_cq_readerr(cr->cq, (void *)&e, 0);
+
+        if (err_ret == 1) {
+            const char *errmsg = fi_cq_strerror(cr->cq, e.prov_errno,
+                                                e.err_data, NULL, 0);
+            RAISE_ERROR_MSG("Error in operation: %s\n", errmsg);
+        } else if (err_ret && err_ret != -FI_EAGAIN) {
+            RAISE_ERROR_MSG("Error reading from CQ (%zd)\n", err_ret);
+        }
+
+        shmem_transport_probe();
+
+        (*polled)++;
+        if ((*polled) > shmem_transport_ofi_max_poll)
+            RAISE_ERROR_MSG("Operation retry limit exceeded (%" PRIu64 ")\n",
+                            shmem_transport_ofi_max_poll);
+        return 1;
+    } else if (ret) {
+        RAISE_ERROR_MSG("OFI error %d: %s\n", ret, fi_strerror(-ret));
+    }
+
+    return 0;
+}
+
+/* Translate addr for dest_pe on an additional rail.  Requested keys and
+ * offsets are the same on every rail with scalable MRs; otherwise each rail
+ * has its own table. */
+static inline
+void shmem_transport_ofi_rail_get_mr(const void *addr, int dest_pe, int rail,
+                                     uint8_t **mr_addr, uint64_t *key) {
+#ifdef ENABLE_MR_SCALABLE
+    shmem_transport_ofi_get_mr(addr, dest_pe, mr_addr, key);
+#else
+    const shmem_transport_ofi_peer_mr_t *peer_mr;
+    size_t offset;
+    int seg;
+
+    shmem_transport_ofi_peer_check(dest_pe);
+
+    seg = shmem_internal_seg_lookup(addr, &offset);
+    peer_mr = &shmem_transport_ofi_rails[rail].peer_mr[dest_pe];
+
+    *key = peer_mr->key[seg];
+    *mr_addr = peer_mr->base[seg] + offset;
+#endif
+}
+
+/* Write or read len bytes at pe over additional rail r.  Completion is by
+ * quiet or get_wait.  Note, the ctx lock must be held before calling this
+ * routine */
+static inline
+void shmem_transport_ofi_rail_rma(shmem_transport_ctx_t *ctx, int r, int get,
+                                  void *local, const void *remote, size_t len, int pe)
+{
+    shmem_transport_ofi_ctx_rail_t *cr = &ctx->rails[r];
+    const shmem_transport_ofi_rail_t *rail = &shmem_transport_ofi_rails[r];
+    uint8_t *addr;
+    uint64_t key, polled;
+    size_t off, frag_len;
+    int ret;
+
+    shmem_transport_ofi_rail_get_mr(remote, pe, r, &addr, &key);
 
-            (*polled)++;
+    for (off = 0; off < len; off += frag_len) {
+        frag_len = MIN(rail->max_msg_size, len - off);
+        polled = 0;
 
-            if ((*polled) <= shmem_transport_ofi_max_poll) {
-                return 1;
-            }
-            else {
-                RAISE_ERROR_MSG("Operation retry limit exceeded (%" PRIu64 ")\n",
-                                shmem_transport_ofi_max_poll);
-            }
+        if (get) {
+            SHMEM_TRANSPORT_OFI_CNTR_INC(&cr->pending_get_cntr);
+            do {
+                ret = fi_read(cr->ep, (uint8_t *) local + off, frag_len, NULL,
+                              rail->addr_table[pe], (uint64_t) (addr + off), key, NULL);
+            } while (shmem_transport_ofi_rail_try_again(cr, ret, &polled));
+        } else {
+            SHMEM_TRANSPORT_OFI_CNTR_INC(&cr->pending_put_cntr);
+            do {
+                ret = fi_write(cr->ep, (uint8_t *) local + off, frag_len, NULL,
+                               rail->addr_table[pe], (uint64_t) (addr + off), key, NULL);
+            } while (shmem_transport_ofi_rail_try_again(cr, ret, &polled));
         }
-        else {
-            OFI_CTX_CHECK_ERROR(ctx, (ssize_t) ret);
+    }
+}
+
+/* Issue the parts of a transfer that are assigned to the additional rails.
+ * Returns the number of leading bytes left for rail 0, which the caller
+ * issues on the context's own endpoint. */
+static inline
+size_t shmem_transport_ofi_rail_issue(shmem_transport_ctx_t *ctx, int get, void *local,
+                                      const void *remote, size_t len, int pe)
+{
+    const int nrails = shmem_transport_ofi_num_rails;
+    size_t chunk, off;
+    int r;
+
+    if (ctx->rails == NULL)
+        return len;
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+
+    /* Puts on the additional rails are not tracked in the per-PE table, but
+     * must still wait for the rail 0 operations fenced ahead of them.  They
+     * need not be counted there, since fence waits for the rails directly. */
+    if (!get && ctx->pe_cntr)
+        shmem_transport_ofi_pe_wait(ctx, pe & shmem_transport_ofi_pe_cntr_mask);
+
+    if (len < shmem_transport_ofi_rail_stripe_size) {
+        r = pe % nrails;
+        if (r != 0) {
+            shmem_transport_ofi_rail_rma(ctx, r, get, local, remote, len, pe);
+            len = 0;
         }
+    } else {
+        /* Cache line sized stripes, rail 0 takes the first one */
+        chunk = (len / nrails + SHMEM_INTERNAL_CACHELINE_SIZE - 1) &
+                ~((size_t) SHMEM_INTERNAL_CACHELINE_SIZE - 1);
+
+        for (r = 1, off = chunk; r < nrails && off < len; r++, off += chunk)
+            shmem_transport_ofi_rail_rma(ctx, r, get, (uint8_t *) local + off,
+                                         (const uint8_t *) remote + off,
+                                         MIN(chunk, len - off), pe);
+        len = MIN(chunk, len);
     }
 
-    return 0;
-}
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 
+    return len;
+}
 
 static inline
 void shmem_transport_put_scalar(shmem_transport_ctx_t* ctx, void *target, const
@@ -547,24 +1386,52 @@ void shmem_transport_put_scalar(shmem_transport_ctx_t* ctx, void *target, const
     uint64_t polled = 0;
     uint64_t key;
     uint8_t *addr;
+    int slot;
 
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
     shmem_internal_assert(len <= shmem_transport_ofi_max_buffered_send);
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+
+    if (ctx->options & SHMEMX_CTX_AGGREGATE) {
+        shmem_transport_ofi_aggr_put(ctx, addr, key, source, len, pe);
+        SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+        return;
+    }
+
+    slot = shmem_transport_ofi_pe_issue(ctx, pe);
     SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
 
-    do {
+    if (slot < 0) {
+        do {
 
-        ret = fi_inject_write(ctx->ep,
-                              source,
-                              len,
-                              GET_DEST(dst),
-                              (uint64_t) addr,
-                              key);
+            ret = fi_inject_write(ctx->ep,
+                                  source,
+                                  len,
+                                  GET_DEST(dst),
+                                  (uint64_t) addr,
+                                  key);
 
-    } while (try_again(ctx, ret, &polled));
+        } while (try_again(ctx, ret, &polled));
+    } else {
+        /* fi_inject_write() cannot generate a completion */
+        const struct iovec      msg_iov = { .iov_base = (void *) source, .iov_len = len };
+        const struct fi_rma_iov rma_iov = { .addr = (uint64_t) addr, .len = len, .key = key };
+        const struct fi_msg_rma msg     = {
+                                            .msg_iov       = &msg_iov,
+                                            .desc          = NULL,
+                                            .iov_count     = 1,
+                                            .addr          = GET_DEST(dst),
+                                            .rma_iov       = &rma_iov,
+                                            .rma_iov_count = 1,
+                                            .context       = SHMEM_TRANSPORT_OFI_PE_CNTR_CTX(slot),
+                                            .data          = 0
+                                          };
+        do {
+            ret = fi_writemsg(ctx->ep, &msg, FI_INJECT | FI_COMPLETION | FI_DELIVERY_COMPLETE);
+        } while (try_again(ctx, ret, &polled));
+    }
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 }
 
@@ -583,6 +1450,9 @@ void shmem_transport_ofi_put_large(shmem_transport_ctx_t* ctx, void *target, con
     uint8_t *frag_source = (uint8_t *) source;
     uint64_t frag_target = (uint64_t) addr;
     size_t frag_len = len;
+    int slot;
+    shmem_transport_ofi_mr_entry_t *entry;
+    void *desc = shmem_transport_ofi_local_desc(ctx, source, len, &entry);
 
     /* operation generates counting events and must be completed by
      * quiet. */
@@ -592,19 +1462,52 @@ void shmem_transport_ofi_put_large(shmem_transport_ctx_t* ctx, void *target, con
                        (size_t) (((uint8_t *) source) + len - frag_source));
         polled = 0;
 
+        slot = shmem_transport_ofi_pe_issue(ctx, pe);
         SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
 
-        do {
-            ret = fi_write(ctx->ep,
-                           frag_source, frag_len, NULL,
-                           GET_DEST(dst), frag_target,
-                           key, NULL);
-        } while (try_again(ctx, ret, &polled));
+        if (slot < 0) {
+            do {
+                ret = fi_write(ctx->ep,
+                               frag_source, frag_len, desc,
+                               GET_DEST(dst), frag_target,
+                               key, NULL);
+            } while (try_again(ctx, ret, &polled));
+        } else {
+            const struct iovec      msg_iov = { .iov_base = frag_source, .iov_len = frag_len };
+            const struct fi_rma_iov rma_iov = { .addr = frag_target, .len = frag_len, .key = key };
+            const struct fi_msg_rma msg     = {
+                                                .msg_iov       = &msg_iov,
+                                                .desc          = &desc,
+                                                .iov_count     = 1,
+                                                .addr          = GET_DEST(dst),
+                                                .rma_iov       = &rma_iov,
+                                                .rma_iov_count = 1,
+                                                .context       = SHMEM_TRANSPORT_OFI_PE_CNTR_CTX(slot),
+                                                .data          = 0
+                                              };
+            do {
+                ret = fi_writemsg(ctx->ep, &msg, FI_COMPLETION | FI_DELIVERY_COMPLETE);
+            } while (try_again(ctx, ret, &polled));
+        }
 
         frag_source += frag_len;
         frag_target += frag_len;
     }
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+    shmem_transport_ofi_local_desc_release(entry);
+}
+
+/* Put that is written directly from the source buffer, spread over the
+ * rails */
+static inline
+void shmem_transport_ofi_put_bulk(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                                  size_t len, int pe)
+{
+    len = shmem_transport_ofi_rail_issue(ctx, 0, (void *) source, target, len, pe);
+
+    if (len > 0)
+        shmem_transport_ofi_put_large(ctx, target, source, len, pe);
 }
 
 static inline
@@ -626,11 +1529,12 @@ void shmem_transport_put_nb(shmem_transport_ctx_t* ctx, void *target, const void
     } else if (len <= shmem_transport_ofi_bounce_buffer_size && ctx->bounce_buffers) {
 
         SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
         shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
         shmem_transport_ofi_bounce_buffer_t *buff =
             create_bounce_buffer(ctx, source, len);
+        buff->frag.pe_slot = shmem_transport_ofi_pe_issue(ctx, pe);
+        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
         polled = 0;
 
         const struct iovec      msg_iov = { .iov_base = buff->data, .iov_len = len };
@@ -651,7 +1555,7 @@ void shmem_transport_put_nb(shmem_transport_ctx_t* ctx, void *target, const void
         SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 
     } else {
-        shmem_transport_ofi_put_large(ctx, target, source,len, pe);
+        shmem_transport_ofi_put_bulk(ctx, target, source, len, pe);
         (*completion)++;
     }
 }
@@ -665,6 +1569,7 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
     uint64_t polled = 0;
     uint64_t key;
     uint8_t *addr;
+    int slot;
 
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
@@ -672,6 +1577,7 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
         uint8_t *src_buf = (uint8_t *) source;
 
         SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+        slot = shmem_transport_ofi_pe_issue(ctx, pe);
         SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
 
         const struct iovec msg_iov = {
@@ -690,12 +1596,14 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
                                         .addr = GET_DEST(dst),
                                         .rma_iov = &rma_iov,
                                         .rma_iov_count = 1,
-                                        .context = src_buf,
+                                        .context = slot < 0 ? (void *) src_buf :
+                                                   SHMEM_TRANSPORT_OFI_PE_CNTR_CTX(slot),
                                         .data = 0
                                       };
 
         do {
-            ret = fi_writemsg(ctx->ep, &msg, FI_DELIVERY_COMPLETE | FI_INJECT);
+            ret = fi_writemsg(ctx->ep, &msg, FI_DELIVERY_COMPLETE | FI_INJECT |
+                                             SHMEM_TRANSPORT_OFI_PE_CNTR_FLAGS(slot));
         } while (try_again(ctx, ret, &polled));
 
         SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
@@ -736,14 +1644,17 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
             rma_iov.addr = frag_target;
             rma_iov.len = frag_len;
 
+            slot = shmem_transport_ofi_pe_issue(ctx, pe);
+            SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+
             msg.msg_iov = &msg_iov;
             msg.rma_iov = &rma_iov;
-            msg.context = frag_source;
-
-            SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+            msg.context = slot < 0 ? (void *) frag_source :
+                          SHMEM_TRANSPORT_OFI_PE_CNTR_CTX(slot);
 
             do {
-                ret = fi_writemsg(ctx->ep, &msg, FI_DELIVERY_COMPLETE);
+                ret = fi_writemsg(ctx->ep, &msg, FI_DELIVERY_COMPLETE |
+                                                 SHMEM_TRANSPORT_OFI_PE_CNTR_FLAGS(slot));
             } while (try_again(ctx, ret, &polled));
 
             frag_source += frag_len;
@@ -753,13 +1664,21 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
     }
 
     uint64_t flags_signal = FI_DELIVERY_COMPLETE | FI_INJECT;
+    /* When the provider places writes of this size in order, the signal
+     * cannot overtake the data and no fence is needed */
+    if (len > shmem_transport_ofi_signal_order_size) {
 #ifndef USE_FI_FENCE /* FI_FENCE is not enabled by user. Using transport layer fence instead */
-    shmem_transport_fence(ctx);
+        /* Only the put to this PE needs to be ordered ahead of the signal */
+        if (ctx->pe_cntr)
+            shmem_transport_ofi_pe_fence(ctx, pe);
+        else
+            shmem_transport_fence(ctx);
 #else
-    /* FI_FENCE assures completion of one or more (for fragmentation) prior puts through
-     * signal delivery */
-    flags_signal |= FI_FENCE;
-#endif 
+        /* FI_FENCE assures completion of one or more (for fragmentation) prior puts through
+         * signal delivery */
+        flags_signal |= FI_FENCE;
+#endif
+    }
 
     /* Transmit the signal */
     shmem_transport_ofi_get_mr(sig_addr, pe, &addr, &key);
@@ -768,7 +1687,9 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
     int atomic_op = (sig_op == SHMEM_SIGNAL_ADD) ? FI_SUM : FI_ATOMIC_WRITE;
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+    slot = shmem_transport_ofi_pe_issue(ctx, pe);
     SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+    flags_signal |= SHMEM_TRANSPORT_OFI_PE_CNTR_FLAGS(slot);
 
     const struct fi_ioc msg_iov_signal = {
                                           .addr = (uint8_t *) &signal,
@@ -788,7 +1709,8 @@ void shmem_transport_put_signal_nbi(shmem_transport_ctx_t* ctx, void *target, co
                                            .rma_iov_count = 1,
                                            .datatype = FI_UINT64,
                                            .op = atomic_op,
-                                           .context = (uint8_t *) &signal,
+                                           .context = slot < 0 ? (void *) &signal :
+                                                      SHMEM_TRANSPORT_OFI_PE_CNTR_CTX(slot),
                                            .data = 0
                                          };
 
@@ -821,11 +1743,177 @@ void shmem_transport_put_nbi(shmem_transport_ctx_t* ctx, void *target, const voi
 
     } else {
 
-        shmem_transport_ofi_put_large(ctx, target, source, len, pe);
+        shmem_transport_ofi_put_bulk(ctx, target, source, len, pe);
+    }
+}
+
+/* Strided put of nblocks blocks of bsize bytes; the target and source strides
+ * are given in bytes.  Blocks are gathered into as few fi_writemsg() calls as
+ * the iov limits allow, with adjacent blocks merged into a single iov.  When
+ * the context has bounce buffers, the source blocks are packed into a bounce
+ * buffer so that only the target side needs an iov per run.  Otherwise the
+ * blocks are written directly from the source buffer, and this call waits for
+ * the completions of its own writes, rather than for every put on the context
+ * in put_wait, before the source buffer is released to the caller. */
+static inline
+void shmem_transport_put_strided(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                                 ptrdiff_t tst, ptrdiff_t sst, size_t bsize,
+                                 size_t nblocks, int pe, long *completion)
+{
+    int ret = 0;
+    uint64_t dst = (uint64_t) pe;
+    uint64_t polled;
+    uint64_t key;
+    uint8_t *addr;
+    const uint8_t *src = (const uint8_t *) source;
+    size_t i, n, max_len, max_iov, max_rma_iov;
+    int slot;
+    struct iovec msg_iov[SHMEM_TRANSPORT_OFI_MAX_IOV];
+    struct fi_rma_iov rma_iov[SHMEM_TRANSPORT_OFI_MAX_IOV];
+    const int pack = ctx->bounce_buffers != NULL &&
+                     bsize <= shmem_transport_ofi_bounce_buffer_size;
+    shmem_transport_ofi_put_frag_t wait;
+
+    shmem_internal_assert(completion != NULL);
+
+    if (bsize > shmem_transport_ofi_max_msg_size) {
+        for (i = 0; i < nblocks; i++)
+            shmem_transport_put_nb(ctx, (uint8_t *) target + (ptrdiff_t) i * tst,
+                                   src + (ptrdiff_t) i * sst, bsize, pe, completion);
+        return;
+    }
+
+    shmem_transport_ofi_get_mr(target, pe, &addr, &key);
+
+    max_len     = pack ? shmem_transport_ofi_bounce_buffer_size : shmem_transport_ofi_max_msg_size;
+    max_iov     = pack ? 1 : shmem_transport_ofi_iov_limit;
+    max_rma_iov = shmem_transport_ofi_rma_iov_limit;
+
+    wait.frag.mytype = SHMEM_TRANSPORT_OFI_TYPE_PUT;
+    wait.frag.pe_slot = -1;
+    wait.pending = 0;
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+    while (nblocks > 0) {
+        shmem_transport_ofi_bounce_buffer_t *buff = NULL;
+        size_t niov = 0, nrma_iov = 0, len = 0;
+
+        for (n = 0; n < nblocks && len + bsize <= max_len; n++) {
+            uint64_t t = (uint64_t) (addr + (ptrdiff_t) n * tst);
+            const uint8_t *s = src + (ptrdiff_t) n * sst;
+            int t_ext = nrma_iov > 0 &&
+                        rma_iov[nrma_iov-1].addr + rma_iov[nrma_iov-1].len == t;
+            int s_ext = pack || (niov > 0 &&
+                        (uint8_t *) msg_iov[niov-1].iov_base + msg_iov[niov-1].iov_len == s);
+
+            if ((!t_ext && nrma_iov == max_rma_iov) || (!s_ext && niov == max_iov))
+                break;
+
+            if (t_ext) {
+                rma_iov[nrma_iov-1].len += bsize;
+            } else {
+                rma_iov[nrma_iov].addr = t;
+                rma_iov[nrma_iov].len  = bsize;
+                rma_iov[nrma_iov].key  = key;
+                nrma_iov++;
+            }
+
+            if (pack) {
+                niov = 1;
+            } else if (s_ext) {
+                msg_iov[niov-1].iov_len += bsize;
+            } else {
+                msg_iov[niov].iov_base = (void *) s;
+                msg_iov[niov].iov_len  = bsize;
+                niov++;
+            }
+            len += bsize;
+        }
+
+        slot = shmem_transport_ofi_pe_issue(ctx, pe);
+        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
+
+        if (pack) {
+            buff = alloc_bounce_buffer(ctx, len);
+            buff->frag.pe_slot = slot;
+            for (i = 0; i < n; i++)
+                memcpy(buff->data + i * bsize, src + (ptrdiff_t) i * sst, bsize);
+            msg_iov[0].iov_base = buff->data;
+            msg_iov[0].iov_len  = len;
+        } else {
+            wait.frag.pe_slot = slot;
+            __atomic_fetch_add(&wait.pending, 1, __ATOMIC_RELAXED);
+        }
+
+        const struct fi_msg_rma msg = {
+                                        .msg_iov       = msg_iov,
+                                        .desc          = NULL,
+                                        .iov_count     = niov,
+                                        .addr          = GET_DEST(dst),
+                                        .rma_iov       = rma_iov,
+                                        .rma_iov_count = nrma_iov,
+                                        .context       = pack ? (void *) buff : (void *) &wait,
+                                        .data          = 0
+                                      };
+
+        polled = 0;
+        do {
+            ret = fi_writemsg(ctx->ep, &msg, FI_COMPLETION | FI_DELIVERY_COMPLETE);
+        } while (try_again(ctx, ret, &polled));
+
+        addr    += (ptrdiff_t) n * tst;
+        src     += (ptrdiff_t) n * sst;
+        nblocks -= n;
+    }
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+    while (__atomic_load_n(&wait.pending, __ATOMIC_ACQUIRE) > 0) {
+        SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
+        shmem_transport_ofi_drain_cq(ctx);
+        SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
+
+        if (__atomic_load_n(&wait.pending, __ATOMIC_ACQUIRE) > 0) {
+            shmem_transport_probe();
+            SPINLOCK_BODY();
+        }
     }
 }
 
 
+/* Limit the number of gets in flight on ctx to the get window, so that the
+ * fragments of a large get are pipelined rather than all queued at once.
+ * Note, the ctx lock must be held before calling this routine */
+static inline
+void shmem_transport_ofi_get_window_wait(shmem_transport_ctx_t *ctx)
+{
+    const uint64_t window = (uint64_t) shmem_transport_ofi_get_window;
+    uint64_t pending = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_get_cntr);
+    uint64_t fail;
+    long poll_count = 0;
+
+    if (window == 0 || pending < window)
+        return;
+
+    while (fi_cntr_read(ctx->get_cntr) + window <= pending) {
+        fail = fi_cntr_readerr(ctx->get_cntr);
+        if (fail)
+            RAISE_ERROR_MSG("Operations completed in error (%" PRIu64 ")\n", fail);
+
+        /* Same polling policy as get_wait */
+        if (poll_count < shmem_transport_ofi_get_poll_limit ||
+            shmem_transport_ofi_get_poll_limit < 0) {
+            shmem_transport_probe();
+            SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+            SPINLOCK_BODY();
+            SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+            poll_count++;
+        } else {
+            ssize_t ret = fi_cntr_wait(ctx->get_cntr, pending - window + 1, -1);
+            OFI_CTX_CHECK_ERROR(ctx, ret);
+        }
+    }
+}
+
 static inline
 void shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len, int pe)
 {
@@ -834,18 +1922,27 @@ void shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *s
     uint64_t polled = 0;
     uint64_t key;
     uint8_t *addr;
+    shmem_transport_ofi_mr_entry_t *entry;
+    void *desc;
+
+    if (ctx->rails) {
+        len = shmem_transport_ofi_rail_issue(ctx, 1, target, source, len, pe);
+        if (len == 0)
+            return;
+    }
 
     shmem_transport_ofi_get_mr(source, pe, &addr, &key);
+    desc = shmem_transport_ofi_local_desc(ctx, target, len, &entry);
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
-    if (len <= shmem_transport_ofi_max_msg_size) {
+    if (len <= shmem_transport_ofi_get_frag_size) {
 
         SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
         do {
             ret = fi_read(ctx->ep,
                           target,
                           len,
-                          NULL,
+                          desc,
                           GET_DEST(dst),
                           (uint64_t) addr,
                           key,
@@ -858,15 +1955,16 @@ void shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *s
         size_t frag_len = len;
 
         while (frag_target < ((uint8_t *) target) + len) {
-            frag_len = MIN(shmem_transport_ofi_max_msg_size,
+            frag_len = MIN(shmem_transport_ofi_get_frag_size,
                            (size_t) (((uint8_t *) target) + len - frag_target));
             polled = 0;
 
+            shmem_transport_ofi_get_window_wait(ctx);
             SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
 
             do {
                 ret = fi_read(ctx->ep,
-                              frag_target, frag_len, NULL,
+                              frag_target, frag_len, desc,
                               GET_DEST(dst), frag_source,
                               key, NULL);
             } while (try_again(ctx, ret, &polled));
@@ -876,6 +1974,102 @@ void shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *s
         }
     }
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
+
+    shmem_transport_ofi_local_desc_release(entry);
+}
+
+/* Blocking get that hands target to callback one fragment at a time, in
+ * address order, as soon as the fragment and all those before it have
+ * arrived.  Fragments are shmem_transport_ofi_get_frag_size bytes, with up to
+ * the get window of them in flight. */
+void shmem_transport_get_stream(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                                size_t len, int pe, shmemx_stream_fn_t callback, void *arg);
+
+/* Strided get of nblocks blocks of bsize bytes; the target and source strides
+ * are given in bytes.  Blocks are read with as few fi_readmsg() calls as the
+ * iov limits allow, with adjacent blocks merged into a single iov.  Completion
+ * is by get_wait. */
+static inline
+void shmem_transport_get_strided(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                                 ptrdiff_t tst, ptrdiff_t sst, size_t bsize,
+                                 size_t nblocks, int pe)
+{
+    int ret = 0;
+    uint64_t dst = (uint64_t) pe;
+    uint64_t polled;
+    uint64_t key;
+    uint8_t *addr;
+    uint8_t *tgt = (uint8_t *) target;
+    size_t i, n;
+    struct iovec msg_iov[SHMEM_TRANSPORT_OFI_MAX_IOV];
+    struct fi_rma_iov rma_iov[SHMEM_TRANSPORT_OFI_MAX_IOV];
+
+    if (bsize > shmem_transport_ofi_max_msg_size) {
+        for (i = 0; i < nblocks; i++)
+            shmem_transport_get(ctx, tgt + (ptrdiff_t) i * tst,
+                                (uint8_t *) source + (ptrdiff_t) i * sst, bsize, pe);
+        return;
+    }
+
+    shmem_transport_ofi_get_mr(source, pe, &addr, &key);
+
+    SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+    while (nblocks > 0) {
+        size_t niov = 0, nrma_iov = 0, len = 0;
+
+        for (n = 0; n < nblocks && len + bsize <= shmem_transport_ofi_max_msg_size; n++) {
+            uint8_t *t = tgt + (ptrdiff_t) n * tst;
+            uint64_t s = (uint64_t) (addr + (ptrdiff_t) n * sst);
+            int t_ext = niov > 0 &&
+                        (uint8_t *) msg_iov[niov-1].iov_base + msg_iov[niov-1].iov_len == t;
+            int s_ext = nrma_iov > 0 &&
+                        rma_iov[nrma_iov-1].addr + rma_iov[nrma_iov-1].len == s;
+
+            if ((!t_ext && niov == shmem_transport_ofi_iov_limit) ||
+                (!s_ext && nrma_iov == shmem_transport_ofi_rma_iov_limit))
+                break;
+
+            if (t_ext) {
+                msg_iov[niov-1].iov_len += bsize;
+            } else {
+                msg_iov[niov].iov_base = t;
+                msg_iov[niov].iov_len  = bsize;
+                niov++;
+            }
+
+            if (s_ext) {
+                rma_iov[nrma_iov-1].len += bsize;
+            } else {
+                rma_iov[nrma_iov].addr = s;
+                rma_iov[nrma_iov].len  = bsize;
+                rma_iov[nrma_iov].key  = key;
+                nrma_iov++;
+            }
+            len += bsize;
+        }
+
+        const struct fi_msg_rma msg = {
+                                        .msg_iov       = msg_iov,
+                                        .desc          = NULL,
+                                        .iov_count     = niov,
+                                        .addr          = GET_DEST(dst),
+                                        .rma_iov       = rma_iov,
+                                        .rma_iov_count = nrma_iov,
+                                        .context       = NULL,
+                                        .data          = 0
+                                      };
+
+        SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_get_cntr);
+        polled = 0;
+        do {
+            ret = fi_readmsg(ctx->ep, &msg, 0);
+        } while (try_again(ctx, ret, &polled));
+
+        tgt     += (ptrdiff_t) n * tst;
+        addr    += (ptrdiff_t) n * sst;
+        nblocks -= n;
+    }
+    SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 }
 
 
@@ -895,6 +2089,9 @@ void shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
 
+    if (ctx->rails)
+        shmem_transport_ofi_rail_wait(ctx, 1);
+
     while (poll_count < shmem_transport_ofi_get_poll_limit ||
            shmem_transport_ofi_get_poll_limit < 0) {
         success = fi_cntr_read(ctx->get_cntr);
@@ -1064,24 +2261,46 @@ void shmem_transport_atomic(shmem_transport_ctx_t* ctx, void *target, const void
     uint64_t polled = 0;
     uint64_t key;
     uint8_t *addr;
+    int slot;
 
     shmem_transport_ofi_get_mr(target, pe, &addr, &key);
 
     shmem_internal_assert(SHMEM_Dtsize[SHMEM_TRANSPORT_DTYPE(datatype)] == len);
 
     SHMEM_TRANSPORT_OFI_CTX_LOCK(ctx);
+    slot = shmem_transport_ofi_pe_issue(ctx, pe);
     SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
 
-    do {
-        ret = fi_inject_atomic(ctx->ep,
-                               source,
-                               1,
-                               GET_DEST(dst),
-                               (uint64_t) addr,
-                               key,
-                               SHMEM_TRANSPORT_DTYPE(datatype),
-                               op);
-    } while (try_again(ctx, ret, &polled));
+    if (slot < 0) {
+        do {
+            ret = fi_inject_atomic(ctx->ep,
+                                   source,
+                                   1,
+                                   GET_DEST(dst),
+                                   (uint64_t) addr,
+                                   key,
+                                   SHMEM_TRANSPORT_DTYPE(datatype),
+                                   op);
+        } while (try_again(ctx, ret, &polled));
+    } else {
+        const struct fi_ioc        msg_iov = { .addr = (void *) source, .count = 1 };
+        const struct fi_rma_ioc    rma_iov = { .addr = (uint64_t) addr, .count = 1, .key = key };
+        const struct fi_msg_atomic msg     = {
+                                               .msg_iov       = &msg_iov,
+                                               .desc          = NULL,
+                                               .iov_count     = 1,
+                                               .addr          = GET_DEST(dst),
+                                               .rma_iov       = &rma_iov,
+                                               .rma_iov_count = 1,
+                                               .datatype      = SHMEM_TRANSPORT_DTYPE(datatype),
+                                               .op            = op,
+                                               .context       = SHMEM_TRANSPORT_OFI_PE_CNTR_CTX(slot),
+                                               .data          = 0
+                                             };
+        do {
+            ret = fi_atomicmsg(ctx->ep, &msg, FI_INJECT | FI_COMPLETION | FI_DELIVERY_COMPLETE);
+        } while (try_again(ctx, ret, &polled));
+    }
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 }
 
@@ -1099,6 +2318,7 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
     uint64_t key;
     uint8_t *addr;
     size_t max_atomic_size = 0;
+    int slot;
 
     shmem_internal_assert(SHMEM_Dtsize[dt] * len == full_len);
 
@@ -1120,18 +2340,39 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
 
         polled = 0;
 
+        slot = shmem_transport_ofi_pe_issue(ctx, pe);
         SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
 
-        do {
-            ret = fi_inject_atomic(ctx->ep,
-                                   source,
-                                   len,
-                                   GET_DEST(dst),
-                                   (uint64_t) addr,
-                                   key,
-                                   dt,
-                                   op);
-        } while (try_again(ctx, ret, &polled));
+        if (slot < 0) {
+            do {
+                ret = fi_inject_atomic(ctx->ep,
+                                       source,
+                                       len,
+                                       GET_DEST(dst),
+                                       (uint64_t) addr,
+                                       key,
+                                       dt,
+                                       op);
+            } while (try_again(ctx, ret, &polled));
+        } else {
+            const struct fi_ioc        msg_iov = { .addr = (void *) source, .count = len };
+            const struct fi_rma_ioc    rma_iov = { .addr = (uint64_t) addr, .count = len, .key = key };
+            const struct fi_msg_atomic msg     = {
+                                                   .msg_iov       = &msg_iov,
+                                                   .desc          = NULL,
+                                                   .iov_count     = 1,
+                                                   .addr          = GET_DEST(dst),
+                                                   .rma_iov       = &rma_iov,
+                                                   .rma_iov_count = 1,
+                                                   .datatype      = dt,
+                                                   .op            = op,
+                                                   .context       = SHMEM_TRANSPORT_OFI_PE_CNTR_CTX(slot),
+                                                   .data          = 0
+                                                 };
+            do {
+                ret = fi_atomicmsg(ctx->ep, &msg, FI_INJECT | FI_COMPLETION | FI_DELIVERY_COMPLETE);
+            } while (try_again(ctx, ret, &polled));
+        }
 
     } else if (full_len <=
                MIN(shmem_transport_ofi_bounce_buffer_size, max_atomic_size) &&
@@ -1141,6 +2382,7 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
             create_bounce_buffer(ctx, source, full_len);
 
         polled = 0;
+        buff->frag.pe_slot = shmem_transport_ofi_pe_issue(ctx, pe);
         SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
 
         const struct fi_ioc        msg_iov = { .addr = buff->data, .count = len };
@@ -1169,21 +2411,50 @@ void shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const voi
             size_t chunksize = MIN((len-sent),
                                    (max_atomic_size/SHMEM_Dtsize[dt]));
             polled = 0;
+            slot = shmem_transport_ofi_pe_issue(ctx, pe);
             SHMEM_TRANSPORT_OFI_CNTR_INC(&ctx->pending_put_cntr);
-            do {
-                ret = fi_atomic(ctx->ep,
-                                (void *)((char *)source +
-                                         (sent*SHMEM_Dtsize[dt])),
-                                chunksize,
-                                NULL,
-                                GET_DEST(dst),
-                                ((uint64_t) addr +
-                                 (sent*SHMEM_Dtsize[dt])),
-                                key,
-                                dt,
-                                op,
-                                NULL);
-            } while (try_again(ctx, ret, &polled));
+
+            if (slot < 0) {
+                do {
+                    ret = fi_atomic(ctx->ep,
+                                    (void *)((char *)source +
+                                             (sent*SHMEM_Dtsize[dt])),
+                                    chunksize,
+                                    NULL,
+                                    GET_DEST(dst),
+                                    ((uint64_t) addr +
+                                     (sent*SHMEM_Dtsize[dt])),
+                                    key,
+                                    dt,
+                                    op,
+                                    NULL);
+                } while (try_again(ctx, ret, &polled));
+            } else {
+                const struct fi_ioc        msg_iov = {
+                                                       .addr  = (char *) source + sent*SHMEM_Dtsize[dt],
+                                                       .count = chunksize
+                                                     };
+                const struct fi_rma_ioc    rma_iov = {
+                                                       .addr  = (uint64_t) addr + sent*SHMEM_Dtsize[dt],
+                                                       .count = chunksize,
+                                                       .key   = key
+                                                     };
+                const struct fi_msg_atomic msg     = {
+                                                       .msg_iov       = &msg_iov,
+                                                       .desc          = NULL,
+                                                       .iov_count     = 1,
+                                                       .addr          = GET_DEST(dst),
+                                                       .rma_iov       = &rma_iov,
+                                                       .rma_iov_count = 1,
+                                                       .datatype      = dt,
+                                                       .op            = op,
+                                                       .context       = SHMEM_TRANSPORT_OFI_PE_CNTR_CTX(slot),
+                                                       .data          = 0
+                                                     };
+                do {
+                    ret = fi_atomicmsg(ctx->ep, &msg, FI_COMPLETION | FI_DELIVERY_COMPLETE);
+                } while (try_again(ctx, ret, &polled));
+            }
 
             sent += chunksize;
         }
@@ -1400,7 +2671,12 @@ uint64_t shmem_transport_received_cntr_get(void)
     shmem_internal_assert(shmem_internal_thread_level == SHMEM_THREAD_SINGLE);
     /* NOTE-MT: This is only reachable in single-threaded runs, otherwise
      * we would need a mutex to support FI_THREAD_COMPLETION builds. */
-    return fi_cntr_read(shmem_transport_ofi_target_cntrfd);
+    uint64_t cnt = fi_cntr_read(shmem_transport_ofi_target_cntrfd);
+
+    for (int r = 1; r < shmem_transport_ofi_num_rails; r++)
+        cnt += fi_cntr_read(shmem_transport_ofi_rails[r].target_cntr);
+
+    return cnt;
 #else
     RAISE_ERROR_STR("OFI transport configured for hard polling");
     return 0;
@@ -1414,6 +2690,16 @@ void shmem_transport_received_cntr_wait(uint64_t ge_val)
     shmem_internal_assert(shmem_internal_thread_level == SHMEM_THREAD_SINGLE);
     /* NOTE-MT: This is only reachable in single-threaded runs, otherwise
      * we would need a mutex to support FI_THREAD_COMPLETION builds. */
+    if (shmem_transport_ofi_num_rails > 1) {
+        /* Writes may arrive on any rail, and there is no way to block on
+         * several counters at once */
+        while (shmem_transport_received_cntr_get() < ge_val) {
+            shmem_transport_probe();
+            SPINLOCK_BODY();
+        }
+        return;
+    }
+
     int ret = fi_cntr_wait(shmem_transport_ofi_target_cntrfd, ge_val, -1);
 
     OFI_CHECK_ERROR(ret);
@@ -1439,11 +2725,9 @@ uint64_t shmem_transport_pcntr_get_issued_write(shmem_transport_ctx_t *ctx)
     cnt = SHMEM_TRANSPORT_OFI_CNTR_READ(&ctx->pending_put_cntr);
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 
-    if (ctx->options & SHMEMX_CTX_BOUNCE_BUFFER) {
-        SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
-        cnt += ctx->pending_bb_cntr;
-        SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
-    }
+    if (ctx->options & SHMEMX_CTX_BOUNCE_BUFFER)
+        cnt += shmem_internal_cntr_read(&ctx->pending_bb_cntr);
+
     return cnt;
 }
 
@@ -1465,11 +2749,9 @@ uint64_t shmem_transport_pcntr_get_completed_write(shmem_transport_ctx_t *ctx)
     cnt = fi_cntr_read(ctx->put_cntr);
     SHMEM_TRANSPORT_OFI_CTX_UNLOCK(ctx);
 
-    if (ctx->options & SHMEMX_CTX_BOUNCE_BUFFER) {
-        SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
-        cnt += ctx->completed_bb_cntr;
-        SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
-    }
+    if (ctx->options & SHMEMX_CTX_BOUNCE_BUFFER)
+        cnt += shmem_internal_cntr_read(&ctx->completed_bb_cntr);
+
     return cnt;
 }
 
@@ -1502,6 +2784,15 @@ uint64_t shmem_transport_pcntr_get_completed_target(void)
     return cnt;
 }
 
+static inline
+double shmem_transport_pcntr_get_cq_batch(shmem_transport_ctx_t *ctx)
+{
+    uint64_t batches = shmem_internal_cntr_read(&ctx->cq_batch_cntr);
+    uint64_t entries = shmem_internal_cntr_read(&ctx->cq_entry_cntr);
+
+    return batches ? (double) entries / batches : 0.0;
+}
+
 static inline
 void shmem_transport_pcntr_get_all(shmem_transport_ctx_t *ctx, shmemx_pcntr_t *pcntr)
 {
@@ -1510,10 +2801,8 @@ void shmem_transport_pcntr_get_all(shmem_transport_ctx_t *ctx, shmemx_pcntr_t *p
     pcntr->pending_put = 0;
 
     if (ctx->options & SHMEMX_CTX_BOUNCE_BUFFER) {
-        SHMEM_TRANSPORT_OFI_CTX_BB_LOCK(ctx);
-        pcntr->completed_put = ctx->completed_bb_cntr;
-        pcntr->pending_put = ctx->pending_bb_cntr;
-        SHMEM_TRANSPORT_OFI_CTX_BB_UNLOCK(ctx);
+        pcntr->completed_put = shmem_internal_cntr_read(&ctx->completed_bb_cntr);
+        pcntr->pending_put = shmem_internal_cntr_read(&ctx->pending_bb_cntr);
     }
     pcntr->completed_put += fi_cntr_read(ctx->put_cntr);
     pcntr->completed_get = fi_cntr_read(ctx->get_cntr);
@@ -607,6 +607,20 @@ shmem_transport_put_nb(shmem_transport_ctx_t* ctx, void *target, const void *sou
     }
 }
 
+static inline
+void
+shmem_transport_put_strided(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                            ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                            int pe, long *completion)
+{
+    size_t i;
+
+    for (i = 0; i < nblocks; i++)
+        shmem_transport_put_nb(ctx, (uint8_t *) target + (ptrdiff_t) i * tst,
+                               (uint8_t *) source + (ptrdiff_t) i * sst, bsize, pe,
+                               completion);
+}
+
 
 static inline
 void
@@ -680,6 +694,19 @@ void shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *s
 #endif
 }
 
+static inline
+void
+shmem_transport_get_strided(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                            ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                            int pe)
+{
+    size_t i;
+
+    for (i = 0; i < nblocks; i++)
+        shmem_transport_get(ctx, (uint8_t *) target + (ptrdiff_t) i * tst,
+                            (uint8_t *) source + (ptrdiff_t) i * sst, bsize, pe);
+}
+
 
 static inline
 void shmem_transport_get_ct(shmem_transport_ct_t *ct, void *target,
@@ -715,6 +742,19 @@ shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
 }
 
 
+/* Completion is tracked by a single counter, so the whole buffer is handed
+ * over at once */
+static inline
+void
+shmem_transport_get_stream(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                           size_t len, int pe, shmemx_stream_fn_t callback, void *arg)
+{
+    shmem_transport_get(ctx, target, source, len, pe);
+    shmem_transport_get_wait(ctx);
+    callback(target, len, arg);
+}
+
+
 static inline
 void
 shmem_transport_swap(shmem_transport_ctx_t* ctx, void *target, const void *source, void *dest, size_t len,
@@ -1409,6 +1449,12 @@ uint64_t shmem_transport_pcntr_get_completed_target(void)
 #endif
 }
 
+static inline
+double shmem_transport_pcntr_get_cq_batch(shmem_transport_ctx_t *ctx)
+{
+    return 0.0;
+}
+
 static inline
 void shmem_transport_pcntr_get_all(shmem_transport_ctx_t *ctx, shmemx_pcntr_t *pcntr)
 {
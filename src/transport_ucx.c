@@ -15,6 +15,7 @@
 #include "transport_ucx.h"
 #include "shmem.h"
 #include "shmem_team.h"
+#include "shmem_internal_op.h"
 #include <ucs/type/status.h>
 #include <ucs/type/thread_mode.h>
 #include <ucp/api/ucp_def.h>
@@ -59,13 +60,164 @@ void shmem_transport_ucx_cb_nop(void *request, ucs_status_t status) {
 }
 
 void shmem_transport_ucx_cb_complete(void *request, ucs_status_t status, void *user_data) {
+    shmem_transport_ucx_op_t *op = (shmem_transport_ucx_op_t *) user_data;
+
     if (status != UCS_OK)
         RAISE_ERROR_STR("Error while completing operation");
 
-    __atomic_store_n((long*)user_data, 1, __ATOMIC_RELEASE);
+    shmem_internal_cntr_inc(&op->cntr->completed);
+
+    if (op->completion)
+        __atomic_fetch_sub(op->completion, 1, __ATOMIC_RELEASE);
+
+    if (op->fl)
+        shmem_free_list_free(op->fl, op);
+
     return;
 }
 
+static void shmem_transport_ucx_cb_free(void *request, ucs_status_t status, void *user_data) {
+    if (status != UCS_OK)
+        RAISE_ERROR_STR("Error while completing operation");
+
+    free(user_data);
+}
+
+/* Apply an atomic update sent by shmem_transport_ucx_amo_am and acknowledge
+ * it to the originating context */
+static ucs_status_t shmem_transport_ucx_am_amo(void *arg, const void *header, size_t header_length,
+                                               void *data, size_t length,
+                                               const ucp_am_recv_param_t *param)
+{
+    shmem_transport_ucx_amo_hdr_t hdr;
+    ucs_status_ptr_t pstatus;
+    uint64_t *ack;
+    void *in = data;
+
+    /* Updates are sent eager, so the payload is always delivered with the
+     * message */
+    if (header_length != sizeof(hdr))
+        RAISE_ERROR_MSG("Malformed atomic active message (header %zu)\n", header_length);
+
+    memcpy(&hdr, header, sizeof(hdr));
+
+    /* The payload is not guaranteed to be aligned for the element type */
+    if ((uintptr_t) data % sizeof(long double)) {
+        in = malloc(length);
+        if (in == NULL)
+            RAISE_ERROR_MSG("Out of memory, allocating atomic payload (%zu bytes)\n", length);
+        memcpy(in, data, length);
+    }
+
+    shmem_internal_reduce_local((shm_internal_op_t) hdr.op,
+                                (shm_internal_datatype_t) hdr.datatype,
+                                (int) hdr.count, in, (void *) hdr.addr);
+
+    if (in != data)
+        free(in);
+
+    if (!(param->recv_attr & UCP_AM_RECV_ATTR_FIELD_REPLY_EP))
+        RAISE_ERROR_STR("Atomic active message without reply endpoint");
+
+    /* The header must stay valid until the send completes, which may be
+     * after this handler returns */
+    ack = malloc(sizeof(uint64_t));
+    if (ack == NULL)
+        RAISE_ERROR_STR("Out of memory, allocating atomic acknowledgement");
+    *ack = hdr.ack;
+
+    ucp_request_param_t reply_param = {
+        .op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA |
+                        UCP_OP_ATTR_FIELD_FLAGS,
+        .flags        = UCP_AM_SEND_FLAG_EAGER,
+        .cb.send      = &shmem_transport_ucx_cb_free,
+        .user_data    = ack
+    };
+
+    pstatus = ucp_am_send_nbx(param->reply_ep, SHMEM_TRANSPORT_UCX_AM_AMO_ACK,
+                              ack, sizeof(*ack), NULL, 0, &reply_param);
+    /* The callback is not invoked when the send completes immediately */
+    if (pstatus == NULL)
+        free(ack);
+    else
+        UCX_CHECK_STATUS_INPROGRESS(shmem_transport_ucx_release_op(pstatus));
+
+    return UCS_OK;
+}
+
+static ucs_status_t shmem_transport_ucx_am_amo_ack(void *arg, const void *header, size_t header_length,
+                                                   void *data, size_t length,
+                                                   const ucp_am_recv_param_t *param)
+{
+    uint64_t ack;
+
+    memcpy(&ack, header, sizeof(ack));
+    shmem_internal_cntr_inc((shmem_internal_cntr_t *) ack);
+
+    return UCS_OK;
+}
+
+/* Register the active message handlers.  Updates arrive on the worker whose
+ * address was published; acknowledgements arrive on the worker of the
+ * context that sent the update. */
+static void shmem_transport_ucx_set_am_handlers(ucp_worker_h worker, int target)
+{
+    ucs_status_t status;
+    ucp_am_handler_param_t params;
+
+    params.field_mask = UCP_AM_HANDLER_PARAM_FIELD_ID |
+                        UCP_AM_HANDLER_PARAM_FIELD_CB |
+                        UCP_AM_HANDLER_PARAM_FIELD_ARG;
+    params.arg        = NULL;
+
+    if (target) {
+        params.id = SHMEM_TRANSPORT_UCX_AM_AMO;
+        params.cb = &shmem_transport_ucx_am_amo;
+        status = ucp_worker_set_am_recv_handler(worker, &params);
+        UCX_CHECK_STATUS(status);
+    }
+
+    params.id = SHMEM_TRANSPORT_UCX_AM_AMO_ACK;
+    params.cb = &shmem_transport_ucx_am_amo_ack;
+    status = ucp_worker_set_am_recv_handler(worker, &params);
+    UCX_CHECK_STATUS(status);
+}
+
+static void shmem_transport_ucx_op_init(shmem_free_list_item_t *item)
+{
+    shmem_transport_ucx_op_t *op = (shmem_transport_ucx_op_t *) item;
+
+    op->cntr       = NULL;
+    op->completion = NULL;
+    op->fl         = NULL;
+}
+
+/* Set up completion tracking for a context */
+static int shmem_transport_ucx_ctx_init_cntrs(shmem_transport_ctx_t *ctx)
+{
+    shmem_internal_cntr_write(&ctx->put_cntr.issued, 0);
+    shmem_internal_cntr_write(&ctx->put_cntr.completed, 0);
+    ctx->put_cntr.quiet = 0;
+    shmem_internal_cntr_write(&ctx->get_cntr.issued, 0);
+    shmem_internal_cntr_write(&ctx->get_cntr.completed, 0);
+    ctx->get_cntr.quiet = 0;
+
+    shmem_internal_cntr_write(&ctx->am_issued, 0);
+    shmem_internal_cntr_write(&ctx->am_acked, 0);
+
+    ctx->put_op.cntr       = &ctx->put_cntr;
+    ctx->put_op.completion = NULL;
+    ctx->put_op.fl         = NULL;
+
+    ctx->nb_ops = shmem_free_list_init(sizeof(shmem_transport_ucx_op_t),
+                                       shmem_transport_ucx_op_init);
+
+    return ctx->nb_ops == NULL;
+}
+
+/* Thread mode requested for UCX workers, based on the SHMEM thread level */
+static ucs_thread_mode_t shmem_transport_ucx_thread_mode;
+
 static pthread_t shmem_transport_ucx_progress_thread;
 static int shmem_transport_ucx_progress_thread_enabled = 1;
 
@@ -79,6 +231,186 @@ static void * shmem_transport_ucx_progress_thread_func(void *arg)
     return NULL;
 }
 
+void shmem_transport_ucx_ctx_connect(shmem_transport_ctx_t *ctx, int pe)
+{
+    ucs_status_t status;
+    ucp_ep_params_t params;
+    shmem_transport_ucx_conn_t *conn;
+
+    SHMEM_MUTEX_LOCK(ctx->lock);
+
+    if (ctx->conns == NULL) {
+        shmem_transport_ucx_conn_t *conns;
+        size_t len = shmem_internal_num_pes * sizeof(shmem_transport_ucx_conn_t);
+
+        if (posix_memalign((void **) &conns, SHMEM_INTERNAL_CACHELINE_SIZE, len))
+            RAISE_ERROR_STR("Out of memory, allocating UCX endpoint table");
+        memset(conns, 0, len);
+
+#ifdef SHMEM_TRANSPORT_UCX_SHR_ORDERING
+        ctx->pending_pes = malloc(shmem_internal_num_pes * sizeof(int));
+        if (ctx->pending_pes == NULL)
+            RAISE_ERROR_STR("Out of memory, allocating UCX pending PE list");
+        ctx->npending = 0;
+#endif
+
+        __atomic_store_n(&ctx->conns, conns, __ATOMIC_RELEASE);
+    }
+
+    conn = &ctx->conns[pe];
+
+    if (conn->ep != NULL) {
+        /* Another thread connected while we waited on the lock */
+        SHMEM_MUTEX_UNLOCK(ctx->lock);
+        return;
+    }
+
+    params.field_mask = UCP_EP_PARAM_FIELD_REMOTE_ADDRESS;
+    params.address    = shmem_transport_peers[pe].addr;
+
+    ucp_ep_h ep;
+    status = ucp_ep_create(ctx->worker, &params, &ep);
+    UCX_CHECK_STATUS(status);
+
+    status = ucp_ep_rkey_unpack(ep, shmem_transport_peers[pe].data_rkey_buf,
+                                &conn->rkey[SHMEM_INTERNAL_SEG_DATA]);
+    UCX_CHECK_STATUS(status);
+    status = ucp_ep_rkey_unpack(ep, shmem_transport_peers[pe].heap_rkey_buf,
+                                &conn->rkey[SHMEM_INTERNAL_SEG_HEAP]);
+    UCX_CHECK_STATUS(status);
+
+#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
+    conn->base[SHMEM_INTERNAL_SEG_DATA] = shmem_internal_data_base;
+    conn->base[SHMEM_INTERNAL_SEG_HEAP] = shmem_internal_heap_base;
+#else
+    conn->base[SHMEM_INTERNAL_SEG_DATA] = shmem_transport_peers[pe].data_base;
+    conn->base[SHMEM_INTERNAL_SEG_HEAP] = shmem_transport_peers[pe].heap_base;
+#endif
+
+    /* Publish the endpoint last, readers check it without the lock */
+    __atomic_store_n(&conn->ep, ep, __ATOMIC_RELEASE);
+
+    SHMEM_MUTEX_UNLOCK(ctx->lock);
+
+    DEBUG_MSG("Connected to PE %d on worker %p\n", pe, (void *) ctx->worker);
+}
+
+static void shmem_transport_ucx_ctx_disconnect(shmem_transport_ctx_t *ctx)
+{
+    int i;
+
+    if (ctx->conns == NULL)
+        return;
+
+    for (i = 0; i < shmem_internal_num_pes; i++) {
+        if (ctx->conns[i].ep == NULL)
+            continue;
+
+        ucp_rkey_destroy(ctx->conns[i].rkey[SHMEM_INTERNAL_SEG_DATA]);
+        ucp_rkey_destroy(ctx->conns[i].rkey[SHMEM_INTERNAL_SEG_HEAP]);
+        ucs_status_ptr_t pstatus = ucp_ep_close_nb(ctx->conns[i].ep,
+                                                   UCP_EP_CLOSE_MODE_FLUSH);
+        shmem_transport_ucx_complete_op(ctx, pstatus);
+    }
+
+    free(ctx->conns);
+    ctx->conns = NULL;
+#ifdef SHMEM_TRANSPORT_UCX_SHR_ORDERING
+    free(ctx->pending_pes);
+    ctx->pending_pes = NULL;
+    ctx->npending = 0;
+#endif
+}
+
+int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx)
+{
+    ucs_status_t status;
+    ucp_worker_params_t worker_params;
+    ucp_worker_attr_t worker_attr;
+
+    if (team == NULL)
+        RAISE_ERROR_STR("Context creation occured on a NULL team");
+
+    *ctx = malloc(sizeof(shmem_transport_ctx_t));
+
+    if (*ctx == NULL)
+        return 1;
+
+    (*ctx)->team    = team;
+    (*ctx)->options = options;
+    (*ctx)->conns   = NULL;
+
+    if (shmem_transport_ucx_ctx_init_cntrs(*ctx)) {
+        RAISE_WARN_STR("Out of memory, allocating context operation records");
+        free(*ctx);
+        *ctx = NULL;
+        return 1;
+    }
+#ifdef SHMEM_TRANSPORT_UCX_SHR_ORDERING
+    (*ctx)->pending_pes = NULL;
+    (*ctx)->npending    = 0;
+#endif
+
+    /* Each context drives its own worker, so that operations on separate
+     * contexts do not contend on the worker lock or share completion
+     * tracking.  A private context is only used by its creating thread. */
+    worker_params.field_mask  = UCP_WORKER_PARAM_FIELD_THREAD_MODE;
+    worker_params.thread_mode = shmem_transport_ucx_thread_mode;
+
+    if (options & SHMEM_CTX_PRIVATE)
+        worker_params.thread_mode = UCS_THREAD_MODE_SINGLE;
+    else if ((options & SHMEM_CTX_SERIALIZED) &&
+             worker_params.thread_mode > UCS_THREAD_MODE_SERIALIZED)
+        worker_params.thread_mode = UCS_THREAD_MODE_SERIALIZED;
+
+    status = ucp_worker_create(shmem_transport_ucp_ctx, &worker_params, &(*ctx)->worker);
+    if (status != UCS_OK) {
+        RAISE_WARN_MSG("UCX worker creation failed (%s)\n", ucs_status_string(status));
+        shmem_free_list_destroy((*ctx)->nb_ops);
+        free(*ctx);
+        *ctx = NULL;
+        return 1;
+    }
+
+    worker_attr.field_mask = UCP_WORKER_ATTR_FIELD_THREAD_MODE;
+    status = ucp_worker_query((*ctx)->worker, &worker_attr);
+    UCX_CHECK_STATUS(status);
+
+    if (worker_attr.thread_mode < worker_params.thread_mode) {
+        RAISE_WARN_MSG("UCX context thread mode %d, requested %d\n",
+                       worker_attr.thread_mode, worker_params.thread_mode);
+        ucp_worker_destroy((*ctx)->worker);
+        shmem_free_list_destroy((*ctx)->nb_ops);
+        free(*ctx);
+        *ctx = NULL;
+        return 1;
+    }
+
+    shmem_transport_ucx_set_am_handlers((*ctx)->worker, 0);
+
+    SHMEM_MUTEX_INIT((*ctx)->lock);
+
+    DEBUG_MSG("Created context %p, options 0x%lx, UCX thread mode %d\n",
+              (void *) *ctx, options, worker_attr.thread_mode);
+
+    return 0;
+}
+
+void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
+{
+    if (ctx == NULL)
+        return;
+    else if (ctx == (shmem_transport_ctx_t *) SHMEM_CTX_DEFAULT)
+        RAISE_ERROR_STR("Cannot destroy SHMEM_CTX_DEFAULT");
+
+    shmem_transport_quiet(ctx);
+    shmem_transport_ucx_ctx_disconnect(ctx);
+    ucp_worker_destroy(ctx->worker);
+    shmem_free_list_destroy(ctx->nb_ops);
+    SHMEM_MUTEX_DESTROY(ctx->lock);
+    free(ctx);
+}
+
 int shmem_transport_init(void)
 {
     ucs_status_t status;
@@ -88,7 +420,8 @@ int shmem_transport_init(void)
     ucs_thread_mode_t requested;
 
     params.field_mask = UCP_PARAM_FIELD_FEATURES;
-    params.features   = UCP_FEATURE_RMA | UCP_FEATURE_AMO32 | UCP_FEATURE_AMO64;
+    params.features   = UCP_FEATURE_RMA | UCP_FEATURE_AMO32 | UCP_FEATURE_AMO64 |
+                        UCP_FEATURE_AM;
 
     status = ucp_config_read(NULL, NULL, &shmem_transport_ucp_config);
     UCX_CHECK_STATUS(status);
@@ -115,6 +448,7 @@ int shmem_transport_init(void)
     }
 
     requested = worker_params.thread_mode;
+    shmem_transport_ucx_thread_mode = requested;
 
     if (shmem_internal_params.PROGRESS_INTERVAL > 0)
         worker_params.thread_mode = UCS_THREAD_MODE_MULTI;
@@ -127,6 +461,8 @@ int shmem_transport_init(void)
     status = ucp_worker_query(shmem_transport_ucp_worker, &worker_attr);
     UCX_CHECK_STATUS(status);
 
+    shmem_transport_ucx_set_am_handlers(shmem_transport_ucp_worker, 1);
+
     DEBUG_MSG("UCX thread mode %d, requested %d\n",
               worker_attr.thread_mode, worker_params.thread_mode);
 
@@ -247,6 +583,15 @@ int shmem_transport_init(void)
     /* Configure the default context */
     shmem_transport_ctx_default.options = 0;
     shmem_transport_ctx_default.team    = &shmem_internal_team_world;
+    shmem_transport_ctx_default.worker  = shmem_transport_ucp_worker;
+    shmem_transport_ctx_default.conns   = NULL;
+    if (shmem_transport_ucx_ctx_init_cntrs(&shmem_transport_ctx_default))
+        RAISE_ERROR_STR("Out of memory, allocating default context operation records");
+#ifdef SHMEM_TRANSPORT_UCX_SHR_ORDERING
+    shmem_transport_ctx_default.pending_pes = NULL;
+    shmem_transport_ctx_default.npending    = 0;
+#endif
+    SHMEM_MUTEX_INIT(shmem_transport_ctx_default.lock);
 
     return 0;
 }
@@ -260,8 +605,6 @@ int shmem_transport_startup(void)
 
     /* Build connection table to each peer */
     for (i = 0; i < shmem_internal_num_pes; i++) {
-        ucs_status_t status;
-        ucp_ep_params_t params;
         size_t rkey_len;
         void *rkey;
         uint8_t *addr_bytes;
@@ -288,21 +631,15 @@ int shmem_transport_startup(void)
             }
         }
 
-        params.field_mask = UCP_EP_PARAM_FIELD_REMOTE_ADDRESS;
-        params.address    = shmem_transport_peers[i].addr;
-
-        status = ucp_ep_create(shmem_transport_ucp_worker, &params, &shmem_transport_peers[i].ep);
-        UCX_CHECK_STATUS(status);
-
+        /* Endpoints are created and rkeys unpacked per context, on first use */
         ret = shmem_runtime_get(i, "data_rkey_len", &rkey_len, sizeof(size_t));
         if (ret) RAISE_ERROR_MSG("Runtime get of UCX data rkey length failed (PE %d, ret %d)\n", i, ret);
         rkey = malloc(rkey_len);
         if (rkey == NULL) RAISE_ERROR_MSG("Out of memory, allocating rkey buffer (len = %zu)\n", rkey_len);
         ret = shmem_runtime_get(i, "data_rkey", rkey, rkey_len);
         if (ret) RAISE_ERROR_MSG("Runtime get of UCX data rkey failed (PE %d, ret %d)\n", i, ret);
-        status = ucp_ep_rkey_unpack(shmem_transport_peers[i].ep, rkey, &shmem_transport_peers[i].data_rkey);
-        UCX_CHECK_STATUS(status);
-        free(rkey);
+        shmem_transport_peers[i].data_rkey_buf = rkey;
+        shmem_transport_peers[i].data_rkey_len = rkey_len;
 
         ret = shmem_runtime_get(i, "heap_rkey_len", &rkey_len, sizeof(size_t));
         if (ret) RAISE_ERROR_MSG("Runtime get of UCX heap rkey length failed (PE %d, ret %d)\n", i, ret);
@@ -310,9 +647,8 @@ int shmem_transport_startup(void)
         if (rkey == NULL) RAISE_ERROR_MSG("Out of memory, allocating rkey buffer (len = %zu)\n", rkey_len);
         ret = shmem_runtime_get(i, "heap_rkey", rkey, rkey_len);
         if (ret) RAISE_ERROR_MSG("Runtime get of UCX heap rkey failed (PE %d, ret %d)\n", i, ret);
-        status = ucp_ep_rkey_unpack(shmem_transport_peers[i].ep, rkey, &shmem_transport_peers[i].heap_rkey);
-        UCX_CHECK_STATUS(status);
-        free(rkey);
+        shmem_transport_peers[i].heap_rkey_buf = rkey;
+        shmem_transport_peers[i].heap_rkey_len = rkey_len;
 
 #ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
         ret = shmem_runtime_get(i, "data_base", &shmem_transport_peers[i].data_base, sizeof(void*));
@@ -343,14 +679,14 @@ int shmem_transport_fini(void)
 
     /* Clean up contexts */
     shmem_transport_quiet(&shmem_transport_ctx_default);
+    shmem_transport_ucx_ctx_disconnect(&shmem_transport_ctx_default);
+    shmem_free_list_destroy(shmem_transport_ctx_default.nb_ops);
+    SHMEM_MUTEX_DESTROY(shmem_transport_ctx_default.lock);
 
     /* Clean up peers table */
     for (i = 0; i < shmem_internal_num_pes; i++) {
-        ucp_rkey_destroy(shmem_transport_peers[i].data_rkey);
-        ucp_rkey_destroy(shmem_transport_peers[i].heap_rkey);
-        ucs_status_ptr_t pstatus = ucp_ep_close_nb(shmem_transport_peers[i].ep,
-                                                   UCP_EP_CLOSE_MODE_FLUSH);
-        shmem_transport_ucx_complete_op(pstatus);
+        free(shmem_transport_peers[i].data_rkey_buf);
+        free(shmem_transport_peers[i].heap_rkey_buf);
         free(shmem_transport_peers[i].addr);
     }
 
@@ -15,6 +15,7 @@
 #include <string.h>
 #include "shmem_internal.h"
 #include "transport.h"
+#include "shmem_free_list.h"
 #include <ucs/type/status.h>
 #include <ucp/api/ucp_def.h>
 #include <ucp/api/ucp.h>
@@ -30,31 +31,101 @@ enum shm_internal_op_t {
     SHM_INTERNAL_PROD
 };
 
-/* The last op supported by the transport layer atomics. Additional ops/types
- * can be implemented to support reductions and are enabled via the
- * shmem_transport_atomic_supported routine below. */
+/* The last op supported by UCP atomics. Other ops and non-integer types are
+ * applied at the target by an active message handler (see
+ * shmem_transport_ucx_amo_am below). */
 #define SHMEM_TRANSPORT_UCX_OP_LAST SHM_INTERNAL_SUM
 
+/* Active message IDs */
+#define SHMEM_TRANSPORT_UCX_AM_AMO     0
+#define SHMEM_TRANSPORT_UCX_AM_AMO_ACK 1
+
 extern ucp_atomic_post_op_t shmem_transport_ucx_post_op[];
 extern ucp_atomic_fetch_op_t shmem_transport_ucx_fetch_op[];
 
 typedef enum shm_internal_op_t shm_internal_op_t;
 typedef int shmem_transport_ct_t;
 
+/* Put/get to on-node peers bypass UCX, while atomics (and CMA puts/gets
+ * above the size limits) go through UCX.  A fence must then complete the UCX
+ * operations to a peer before later shared memory accesses to that peer. */
+#if defined(USE_CMA) || (defined(USE_XPMEM) && !defined(USE_SHR_ATOMICS))
+#define SHMEM_TRANSPORT_UCX_SHR_ORDERING 1
+#endif
+
+/* Endpoint to a peer from a context's worker, with the peer's rkeys unpacked
+ * for that endpoint.  The rkey and remote segment base are indexed by
+ * symmetric segment ID, so translation does not touch the peers table. */
+typedef struct {
+    ucp_ep_h       ep;
+    ucp_rkey_h     rkey[SHMEM_INTERNAL_NSEG];
+    uint8_t       *base[SHMEM_INTERNAL_NSEG];
+#ifdef SHMEM_TRANSPORT_UCX_SHR_ORDERING
+    int            pending;
+#endif
+} shmem_transport_ucx_conn_t;
+
+/* Counts of operations issued on a context and of those known complete.
+ * Operations completed by a callback are counted as they complete; the rest
+ * are accounted for by quiet, which records the issue count it covered. */
+typedef struct {
+    shmem_internal_cntr_t issued;
+    shmem_internal_cntr_t completed;
+    uint64_t              quiet;
+} shmem_transport_ucx_cntr_t;
+
+/* Header of an atomic update carried by active message.  The target applies
+ * op to count elements at addr and returns ack to the originator. */
+typedef struct {
+    uint64_t addr;
+    uint64_t ack;
+    uint32_t op;
+    uint32_t datatype;
+    uint64_t count;
+} shmem_transport_ucx_amo_hdr_t;
+
+/* user_data for shmem_transport_ucx_cb_complete.  Operations that signal a
+ * completion variable, or whose header must outlive the call, carry their
+ * own record, drawn from fl. */
+typedef struct {
+    shmem_free_list_item_t        item;
+    shmem_transport_ucx_cntr_t   *cntr;
+    long                         *completion;
+    shmem_free_list_t            *fl;
+    shmem_transport_ucx_amo_hdr_t hdr;
+} shmem_transport_ucx_op_t;
+
 struct shmem_transport_ctx_t {
     long options;
     struct shmem_internal_team_t *team;
+    ucp_worker_h worker;
+    /* Indexed by PE, allocated and filled in on first communication */
+    shmem_transport_ucx_conn_t *conns;
+    shmem_transport_ucx_cntr_t put_cntr, get_cntr;
+    shmem_transport_ucx_op_t put_op;
+    shmem_free_list_t *nb_ops;
+    /* Active message atomics sent, and acknowledged by their targets */
+    shmem_internal_cntr_t am_issued, am_acked;
+#ifdef SHMEM_TRANSPORT_UCX_SHR_ORDERING
+    /* On-node PEs with UCX operations issued since the last fence */
+    int *pending_pes;
+    int npending;
+#endif
+#ifdef ENABLE_THREADS
+    shmem_internal_mutex_t lock;
+#endif
 };
 typedef struct shmem_transport_ctx_t shmem_transport_ctx_t;
 
 typedef struct {
     size_t         addr_len;
     ucp_address_t *addr;
-    ucp_ep_h       ep;
 #ifndef ENABLE_REMOTE_VIRTUAL_ADDRESSING
     uint8_t       *data_base, *heap_base;
 #endif
-    ucp_rkey_h     data_rkey, heap_rkey;
+    /* Packed rkeys, unpacked for each context that connects to the peer */
+    void          *data_rkey_buf, *heap_rkey_buf;
+    size_t         data_rkey_len, heap_rkey_len;
 } shmem_transport_peer_t;
 
 extern shmem_transport_peer_t *shmem_transport_peers;
@@ -67,6 +138,10 @@ int shmem_transport_init(void);
 int shmem_transport_startup(void);
 int shmem_transport_fini(void);
 
+int shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx);
+void shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx);
+void shmem_transport_ucx_ctx_connect(shmem_transport_ctx_t *ctx, int pe);
+
 #define UCX_CHECK_STATUS(status)                                                        \
     do {                                                                                \
         if (status != UCS_OK) {                                                         \
@@ -88,19 +163,31 @@ shmem_transport_probe(void)
     ucp_worker_progress(shmem_transport_ucp_worker);
 }
 
+/* Progress a context's operations.  Traffic targeting this PE always arrives
+ * on the default worker, so it is progressed as well. */
+static inline
+void
+shmem_transport_ucx_progress(shmem_transport_ctx_t *ctx)
+{
+    shmem_transport_probe();
+
+    if (ctx->worker != shmem_transport_ucp_worker)
+        ucp_worker_progress(ctx->worker);
+}
+
 static inline
-ucs_status_t shmem_transport_ucx_complete_op(ucs_status_ptr_t req) {
+ucs_status_t shmem_transport_ucx_complete_op(shmem_transport_ctx_t *ctx, ucs_status_ptr_t req) {
     if (req == NULL) {
         /* All calls to complete_op must generate progress to avoid deadlock
          * in application-level polling loops */
-        shmem_transport_probe();
+        shmem_transport_ucx_progress(ctx);
         return UCS_OK;
     } else if (UCS_PTR_IS_ERR(req)) {
         return UCS_PTR_STATUS(req);
     } else {
         ucs_status_t status;
         do {
-            shmem_transport_probe();
+            shmem_transport_ucx_progress(ctx);
             status = ucp_request_check_status(req);
         } while (status == UCS_INPROGRESS);
         ucp_request_free(req);
@@ -120,10 +207,17 @@ ucs_status_t shmem_transport_ucx_release_op(ucs_status_ptr_t req) {
     }
 }
 
+/* Account for a callback operation that completed immediately, in which case
+ * UCX does not invoke the callback, or release the request of one that is
+ * still in flight */
 static inline
-ucs_status_t shmem_transport_ucx_post_cb_op(ucs_status_ptr_t req, void *completion) {
+ucs_status_t shmem_transport_ucx_post_cb_op(ucs_status_ptr_t req, shmem_transport_ucx_op_t *op) {
     if (req == NULL) {
-        __atomic_store_n((long*)completion, 0, __ATOMIC_RELEASE);
+        shmem_internal_cntr_inc(&op->cntr->completed);
+        if (op->completion)
+            __atomic_fetch_sub(op->completion, 1, __ATOMIC_RELEASE);
+        if (op->fl)
+            shmem_free_list_free(op->fl, op);
         return UCS_OK;
     } else if (UCS_PTR_IS_ERR(req)) {
         return UCS_PTR_STATUS(req);
@@ -133,69 +227,74 @@ ucs_status_t shmem_transport_ucx_post_cb_op(ucs_status_ptr_t req, void *completi
     }
 }
 
+/* Record that all operations counted in cntr->issued up to mark completed */
 static inline
-void shmem_transport_ucx_get_mr(const void *addr, int dest_pe,
-                                uint8_t **remote_addr, ucp_rkey_h *rkey) {
-    if ((void*) addr >= shmem_internal_data_base &&
-        (uint8_t*) addr < (uint8_t*) shmem_internal_data_base + shmem_internal_data_length) {
+void shmem_transport_ucx_cntr_quiet(shmem_transport_ucx_cntr_t *cntr, uint64_t mark) {
+    uint64_t old = __atomic_load_n(&cntr->quiet, __ATOMIC_RELAXED);
 
-        *rkey = shmem_transport_peers[dest_pe].data_rkey;
-#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-        *remote_addr = (uint8_t *) addr;
-#else
-        *remote_addr = (uint8_t*) (((uint8_t *) addr - (uint8_t *) shmem_internal_data_base) +
-                       shmem_transport_peers[dest_pe].data_base);
-#endif
-    } else if ((void*) addr >= shmem_internal_heap_base &&
-               (uint8_t*) addr < (uint8_t*) shmem_internal_heap_base + shmem_internal_heap_length) {
+    while (old < mark &&
+           !__atomic_compare_exchange_n(&cntr->quiet, &old, mark, 1,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        ;
+}
 
-        *rkey = shmem_transport_peers[dest_pe].heap_rkey;
-#ifdef ENABLE_REMOTE_VIRTUAL_ADDRESSING
-        *remote_addr = (uint8_t *) addr;
-#else
-        *remote_addr = (uint8_t*) (((uint8_t *) addr - (uint8_t *) shmem_internal_heap_base) +
-                       shmem_transport_peers[dest_pe].heap_base);
-#endif
-    } else {
-        RAISE_ERROR_MSG("address (%p) outside of symmetric areas\n", addr);
-    }
+static inline
+uint64_t shmem_transport_ucx_cntr_completed(shmem_transport_ucx_cntr_t *cntr) {
+    uint64_t completed = shmem_internal_cntr_read(&cntr->completed);
+    uint64_t quiet     = __atomic_load_n(&cntr->quiet, __ATOMIC_ACQUIRE);
+
+    return completed > quiet ? completed : quiet;
 }
 
 static inline
-int
-shmem_transport_ctx_create(struct shmem_internal_team_t *team, long options, shmem_transport_ctx_t **ctx)
+shmem_transport_ucx_conn_t *
+shmem_transport_ucx_conn(shmem_transport_ctx_t *ctx, int pe)
 {
-    /* FIXME: Contexts are not optimized yet. We could create a separate set of
-     * EPs for each context (or team), and/or we could use completion callbacks
-     * to implement completion counters at the SOS level to enable separate
-     * completion tracking per context. */
+    shmem_transport_ucx_conn_t *conns = __atomic_load_n(&ctx->conns, __ATOMIC_ACQUIRE);
 
-    if (team == NULL)
-        RAISE_ERROR_STR("Context creation occured on a NULL team");
+    if (conns == NULL || __atomic_load_n(&conns[pe].ep, __ATOMIC_ACQUIRE) == NULL) {
+        shmem_transport_ucx_ctx_connect(ctx, pe);
+        conns = ctx->conns;
+    }
+
+    return &conns[pe];
+}
 
-    *ctx = malloc(sizeof(shmem_transport_ctx_t));
+/* Translate addr for dest_pe and return the context's endpoint to it */
+static inline
+ucp_ep_h shmem_transport_ucx_get_mr(shmem_transport_ctx_t *ctx, const void *addr, int dest_pe,
+                                    uint8_t **remote_addr, ucp_rkey_h *rkey) {
+    shmem_transport_ucx_conn_t *conn = shmem_transport_ucx_conn(ctx, dest_pe);
+    size_t offset;
+    int seg;
 
-    if (*ctx == NULL)
-        return 1;
+    seg = shmem_internal_seg_lookup(addr, &offset);
 
-    (*ctx)->team = team;
-    (*ctx)->options = 0;
+    *rkey = conn->rkey[seg];
+    *remote_addr = conn->base[seg] + offset;
 
-    return 0;
+    return conn->ep;
 }
 
+/* Record that a UCX operation that may still be in flight was issued to pe */
 static inline
 void
-shmem_transport_ctx_destroy(shmem_transport_ctx_t *ctx)
+shmem_transport_ucx_mark_pending(shmem_transport_ctx_t *ctx, int pe)
 {
-    if (ctx == NULL)
+#ifdef SHMEM_TRANSPORT_UCX_SHR_ORDERING
+    shmem_transport_ucx_conn_t *conn = &ctx->conns[pe];
+
+    if (shmem_internal_get_shr_rank(pe) == -1 ||
+        __atomic_load_n(&conn->pending, __ATOMIC_RELAXED))
         return;
-    else if (ctx == (shmem_transport_ctx_t *) SHMEM_CTX_DEFAULT)
-        RAISE_ERROR_STR("Cannot destroy SHMEM_CTX_DEFAULT");
-    else
-        free(ctx);
 
-    return;
+    SHMEM_MUTEX_LOCK(ctx->lock);
+    if (!conn->pending) {
+        conn->pending = 1;
+        ctx->pending_pes[ctx->npending++] = pe;
+    }
+    SHMEM_MUTEX_UNLOCK(ctx->lock);
+#endif
 }
 
 static inline
@@ -203,10 +302,46 @@ int
 shmem_transport_quiet(shmem_transport_ctx_t* ctx)
 {
     ucs_status_t status;
+    ucp_request_param_t param = { .op_attr_mask = 0 };
+    uint64_t put_mark = shmem_internal_cntr_read(&ctx->put_cntr.issued);
+    uint64_t get_mark = shmem_internal_cntr_read(&ctx->get_cntr.issued);
+    uint64_t am_mark  = shmem_internal_cntr_read(&ctx->am_issued);
+
+    /* Nothing to flush if no put or atomic was issued since the last quiet
+     * and every read has completed.  Put callbacks signal only local
+     * completion, so puts are covered by quiet alone. */
+    if (put_mark == __atomic_load_n(&ctx->put_cntr.quiet, __ATOMIC_ACQUIRE) &&
+        get_mark == shmem_transport_ucx_cntr_completed(&ctx->get_cntr)) {
+        shmem_transport_ucx_progress(ctx);
+        return 0;
+    }
 
-    status = ucp_worker_flush(shmem_transport_ucp_worker);
+    /* Flush by polling a request rather than with the blocking
+     * ucp_worker_flush, so that the default worker keeps making progress
+     * while a context worker is drained */
+    status = shmem_transport_ucx_complete_op(ctx, ucp_worker_flush_nbx(ctx->worker, &param));
     UCX_CHECK_STATUS(status);
 
+    /* Flushing delivers active messages, but the target reports when the
+     * update has been applied */
+    while (shmem_internal_cntr_read(&ctx->am_acked) < am_mark)
+        shmem_transport_ucx_progress(ctx);
+
+    shmem_transport_ucx_cntr_quiet(&ctx->put_cntr, put_mark);
+    shmem_transport_ucx_cntr_quiet(&ctx->get_cntr, get_mark);
+
+#ifdef SHMEM_TRANSPORT_UCX_SHR_ORDERING
+    if (__atomic_load_n(&ctx->npending, __ATOMIC_RELAXED) > 0) {
+        int i;
+
+        SHMEM_MUTEX_LOCK(ctx->lock);
+        for (i = 0; i < ctx->npending; i++)
+            ctx->conns[ctx->pending_pes[i]].pending = 0;
+        ctx->npending = 0;
+        SHMEM_MUTEX_UNLOCK(ctx->lock);
+    }
+#endif
+
     return 0;
 }
 
@@ -214,15 +349,37 @@ static inline
 int
 shmem_transport_fence(shmem_transport_ctx_t* ctx)
 {
+    uint64_t am_mark = shmem_internal_cntr_read(&ctx->am_issued);
     ucs_status_t status;
 
-#if defined(USE_CMA) || (defined(USE_XPMEM) && !defined(USE_SHR_ATOMICS))
-    /* Put/get use shared memory and atomics use UCX. Flush to resolve a race
-     * across transports. */
-    status = ucp_worker_flush(shmem_transport_ucp_worker);
-#else
-    status = ucp_worker_fence(shmem_transport_ucp_worker);
+#ifdef SHMEM_TRANSPORT_UCX_SHR_ORDERING
+    /* Shared memory accesses complete synchronously, so only the endpoints
+     * to on-node peers with UCX operations in flight need to be flushed */
+    if (__atomic_load_n(&ctx->npending, __ATOMIC_RELAXED) > 0) {
+        int i;
+
+        SHMEM_MUTEX_LOCK(ctx->lock);
+        for (i = 0; i < ctx->npending; i++) {
+            shmem_transport_ucx_conn_t *conn = &ctx->conns[ctx->pending_pes[i]];
+            ucs_status_ptr_t pstatus = ucp_ep_flush_nb(conn->ep, 0,
+                                                       &shmem_transport_ucx_cb_nop);
+
+            status = shmem_transport_ucx_complete_op(ctx, pstatus);
+            UCX_CHECK_STATUS(status);
+            conn->pending = 0;
+        }
+        ctx->npending = 0;
+        SHMEM_MUTEX_UNLOCK(ctx->lock);
+    }
 #endif
+
+    /* Active-message atomics are applied by the target's progress, which a
+     * worker fence does not order, so wait for their acks as quiet does */
+    while (shmem_internal_cntr_read(&ctx->am_acked) < am_mark)
+        shmem_transport_ucx_progress(ctx);
+
+    /* Orders the remaining operations, which all travel through UCX */
+    status = ucp_worker_fence(ctx->worker);
     UCX_CHECK_STATUS(status);
 
     return 0;
@@ -233,20 +390,33 @@ void
 shmem_transport_put_scalar(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len, int pe)
 {
     ucs_status_t status;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     uint8_t *remote_addr;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ucp_request_param_t param = {
+        .op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA,
+        .cb.send      = &shmem_transport_ucx_cb_complete,
+        .user_data    = &ctx->put_op
+    };
+
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_mark_pending(ctx, pe);
 
-    status = ucp_put_nbi(shmem_transport_peers[pe].ep, source, len, (uint64_t) remote_addr, rkey);
-    UCX_CHECK_STATUS_INPROGRESS(status);
+    shmem_internal_cntr_inc(&ctx->put_cntr.issued);
+
+    ucs_status_ptr_t pstatus = ucp_put_nbx(ep, source, len, (uint64_t) remote_addr,
+                                           rkey, &param);
 
-    /* SOS expects scalar puts to complete locally. Use ucp_put_nbi in the hope
-     * scalar puts are buffered/inlined and fix via quieting if not. If UCX
-     * isn't providing immediate remote completion, ucp_put_nb may be more
-     * efficient than ucp_put_nbi + quiet */
-    if (status != UCS_OK)
-        shmem_transport_quiet(ctx);
+    /* SOS expects scalar puts to complete locally.  Small puts are usually
+     * inlined and complete immediately; otherwise wait only for this request
+     * to release the source buffer, rather than flushing the worker. */
+    if (pstatus == NULL) {
+        shmem_internal_cntr_inc(&ctx->put_cntr.completed);
+    } else {
+        status = shmem_transport_ucx_complete_op(ctx, pstatus);
+        UCX_CHECK_STATUS(status);
+    }
 }
 
 static inline
@@ -255,21 +425,35 @@ shmem_transport_put_nb(shmem_transport_ctx_t* ctx, void *target, const void *sou
                        int pe, long *completion)
 {
     ucs_status_t status;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     uint8_t *remote_addr;
+    shmem_transport_ucx_op_t *op;
+
+    op = (shmem_transport_ucx_op_t *) shmem_free_list_alloc(ctx->nb_ops);
+    if (op == NULL)
+        RAISE_ERROR_STR("Out of memory, allocating UCX operation record");
+
+    op->cntr       = &ctx->put_cntr;
+    op->completion = completion;
+    op->fl         = ctx->nb_ops;
 
     ucp_request_param_t param = {
         .op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA,
         .cb.send      = &shmem_transport_ucx_cb_complete,
-        .user_data    = completion
+        .user_data    = op
     };
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_mark_pending(ctx, pe);
+
+    shmem_internal_cntr_inc(&ctx->put_cntr.issued);
+    __atomic_fetch_add(completion, 1, __ATOMIC_RELAXED);
 
-    ucs_status_ptr_t pstatus = ucp_put_nbx(shmem_transport_peers[pe].ep, source,
+    ucs_status_ptr_t pstatus = ucp_put_nbx(ep, source,
                                            len, (uint64_t) remote_addr, rkey, &param);
 
-    status = shmem_transport_ucx_post_cb_op(pstatus, completion);
+    status = shmem_transport_ucx_post_cb_op(pstatus, op);
     UCX_CHECK_STATUS_INPROGRESS(status);
 }
 
@@ -278,7 +462,7 @@ void
 shmem_transport_put_wait(shmem_transport_ctx_t* ctx, long *completion)
 {
     while (__atomic_load_n(completion, __ATOMIC_ACQUIRE) > 0)
-        shmem_transport_probe();
+        shmem_transport_ucx_progress(ctx);
 }
 
 static inline
@@ -287,13 +471,35 @@ shmem_transport_put_nbi(shmem_transport_ctx_t* ctx, void *target, const void *so
                        int pe)
 {
     ucs_status_t status;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     uint8_t *remote_addr;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_mark_pending(ctx, pe);
+
+    shmem_internal_cntr_inc(&ctx->put_cntr.issued);
 
-    status = ucp_put_nbi(shmem_transport_peers[pe].ep, source, len, (uint64_t) remote_addr, rkey);
+    status = ucp_put_nbi(ep, source, len, (uint64_t) remote_addr, rkey);
     UCX_CHECK_STATUS_INPROGRESS(status);
+
+    /* Otherwise, accounted for by the next quiet */
+    if (status == UCS_OK)
+        shmem_internal_cntr_inc(&ctx->put_cntr.completed);
+}
+
+static inline
+void
+shmem_transport_put_strided(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                            ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                            int pe, long *completion)
+{
+    size_t i;
+
+    for (i = 0; i < nblocks; i++)
+        shmem_transport_put_nb(ctx, (uint8_t *) target + (ptrdiff_t) i * tst,
+                               (uint8_t *) source + (ptrdiff_t) i * sst, bsize, pe,
+                               completion);
 }
 
 static inline
@@ -301,16 +507,34 @@ void
 shmem_transport_get(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len, int pe)
 {
     ucs_status_ptr_t pstatus;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     uint8_t *remote_addr;
 
-    shmem_transport_ucx_get_mr(source, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, source, pe, &remote_addr, &rkey);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.issued);
 
-    pstatus = ucp_get_nb(shmem_transport_peers[pe].ep, target, len,
+    pstatus = ucp_get_nb(ep, target, len,
                          (uint64_t) remote_addr, rkey, &shmem_transport_ucx_cb_nop);
 
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
+    ucs_status_t status = shmem_transport_ucx_complete_op(ctx, pstatus);
     UCX_CHECK_STATUS(status);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.completed);
+}
+
+static inline
+void
+shmem_transport_get_strided(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                            ptrdiff_t tst, ptrdiff_t sst, size_t bsize, size_t nblocks,
+                            int pe)
+{
+    size_t i;
+
+    for (i = 0; i < nblocks; i++)
+        shmem_transport_get(ctx, (uint8_t *) target + (ptrdiff_t) i * tst,
+                            (uint8_t *) source + (ptrdiff_t) i * sst, bsize, pe);
 }
 
 static inline
@@ -320,6 +544,17 @@ shmem_transport_get_wait(shmem_transport_ctx_t* ctx)
     /* Blocking fetching ops are completed in place, so this is a nop */
 }
 
+/* Gets complete in place, so the whole buffer is handed over at once */
+static inline
+void
+shmem_transport_get_stream(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                           size_t len, int pe, shmemx_stream_fn_t callback, void *arg)
+{
+    shmem_transport_get(ctx, target, source, len, pe);
+    shmem_transport_get_wait(ctx);
+    callback(target, len, arg);
+}
+
 
 static inline
 void
@@ -327,11 +562,14 @@ shmem_transport_swap(shmem_transport_ctx_t* ctx, void *target, const void *sourc
                      size_t len, int pe, shm_internal_datatype_t datatype)
 {
     uint8_t *remote_addr;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     ucs_status_ptr_t pstatus;
     uint64_t value;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.issued);
 
     switch (len) {
         case 1:
@@ -350,12 +588,14 @@ shmem_transport_swap(shmem_transport_ctx_t* ctx, void *target, const void *sourc
             RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
     }
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_SWAP, value,
+    pstatus = ucp_atomic_fetch_nb(ep, UCP_ATOMIC_FETCH_OP_SWAP, value,
                                   dest, len, (uint64_t) remote_addr, rkey,
                                   &shmem_transport_ucx_cb_nop);
 
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
+    ucs_status_t status = shmem_transport_ucx_complete_op(ctx, pstatus);
     UCX_CHECK_STATUS(status);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.completed);
 }
 
 static inline
@@ -364,11 +604,15 @@ shmem_transport_swap_nbi(shmem_transport_ctx_t* ctx, void *target, const void *s
                          size_t len, int pe, shm_internal_datatype_t datatype)
 {
     uint8_t *remote_addr;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     ucs_status_ptr_t pstatus;
     uint64_t value;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_mark_pending(ctx, pe);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.issued);
 
     switch (len) {
         case 1:
@@ -387,15 +631,18 @@ shmem_transport_swap_nbi(shmem_transport_ctx_t* ctx, void *target, const void *s
             RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
     }
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_SWAP, value,
+    pstatus = ucp_atomic_fetch_nb(ep, UCP_ATOMIC_FETCH_OP_SWAP, value,
                                   dest, len, (uint64_t) remote_addr, rkey,
                                   &shmem_transport_ucx_cb_nop);
 
     /* Manual progress to avoid deadlock for application-level polling */
-    shmem_transport_probe();
+    shmem_transport_ucx_progress(ctx);
 
     ucs_status_t status = shmem_transport_ucx_release_op(pstatus);
     UCX_CHECK_STATUS_INPROGRESS(status);
+
+    if (status == UCS_OK)
+        shmem_internal_cntr_inc(&ctx->get_cntr.completed);
 }
 
 static inline
@@ -405,11 +652,14 @@ shmem_transport_cswap(shmem_transport_ctx_t* ctx, void *target, const void *sour
                       shm_internal_datatype_t datatype)
 {
     uint8_t *remote_addr;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     ucs_status_ptr_t pstatus;
     uint64_t value;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.issued);
 
     memcpy(dest, source, len);
 
@@ -430,12 +680,14 @@ shmem_transport_cswap(shmem_transport_ctx_t* ctx, void *target, const void *sour
             RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
     }
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_CSWAP,
+    pstatus = ucp_atomic_fetch_nb(ep, UCP_ATOMIC_FETCH_OP_CSWAP,
                                   value, dest, len, (uint64_t) remote_addr, rkey,
                                   &shmem_transport_ucx_cb_nop);
 
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
+    ucs_status_t status = shmem_transport_ucx_complete_op(ctx, pstatus);
     UCX_CHECK_STATUS(status);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.completed);
 }
 
 static inline
@@ -445,11 +697,15 @@ shmem_transport_cswap_nbi(shmem_transport_ctx_t* ctx, void *target, const void *
                           shm_internal_datatype_t datatype)
 {
     uint8_t *remote_addr;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     ucs_status_ptr_t pstatus;
     uint64_t value;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_mark_pending(ctx, pe);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.issued);
 
     memcpy(dest, source, len);
 
@@ -470,15 +726,131 @@ shmem_transport_cswap_nbi(shmem_transport_ctx_t* ctx, void *target, const void *
             RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
     }
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_CSWAP,
+    pstatus = ucp_atomic_fetch_nb(ep, UCP_ATOMIC_FETCH_OP_CSWAP,
                                   value, dest, len, (uint64_t) remote_addr, rkey,
                                   &shmem_transport_ucx_cb_nop);
 
     /* Manual progress to avoid deadlock for application-level polling */
-    shmem_transport_probe();
+    shmem_transport_ucx_progress(ctx);
 
     ucs_status_t status = shmem_transport_ucx_release_op(pstatus);
     UCX_CHECK_STATUS_INPROGRESS(status);
+
+    if (status == UCS_OK)
+        shmem_internal_cntr_inc(&ctx->get_cntr.completed);
+}
+
+/* Element size of the types the active message path can update, or 0 */
+static inline
+size_t
+shmem_transport_ucx_dtsize(shm_internal_datatype_t datatype)
+{
+    switch (datatype) {
+        case SHM_INTERNAL_UCHAR:
+            return sizeof(unsigned char);
+        case SHM_INTERNAL_SHORT:
+        case SHM_INTERNAL_USHORT:
+            return sizeof(short);
+        case SHM_INTERNAL_INT:
+        case SHM_INTERNAL_UINT:
+            return sizeof(int);
+        case SHM_INTERNAL_LONG:
+        case SHM_INTERNAL_ULONG:
+            return sizeof(long);
+        case SHM_INTERNAL_LONG_LONG:
+        case SHM_INTERNAL_ULONG_LONG:
+            return sizeof(long long);
+        case SHM_INTERNAL_INT32:
+            return sizeof(int32_t);
+        case SHM_INTERNAL_INT64:
+            return sizeof(int64_t);
+        case SHM_INTERNAL_FLOAT:
+            return sizeof(float);
+        case SHM_INTERNAL_DOUBLE:
+            return sizeof(double);
+        case SHM_INTERNAL_LONG_DOUBLE:
+            return sizeof(long double);
+        case SHM_INTERNAL_FLOAT_COMPLEX:
+            return sizeof(float _Complex);
+        case SHM_INTERNAL_DOUBLE_COMPLEX:
+            return sizeof(double _Complex);
+        default:
+            return 0;
+    }
+}
+
+/* Whether a UCP atomic can perform op on a single element of the given type */
+static inline
+int
+shmem_transport_ucx_amo_native(shm_internal_op_t op, shm_internal_datatype_t datatype,
+                               size_t len)
+{
+    if (op > SHMEM_TRANSPORT_UCX_OP_LAST || (len != 4 && len != 8))
+        return 0;
+
+    switch (datatype) {
+        case SHM_INTERNAL_FLOAT:
+        case SHM_INTERNAL_DOUBLE:
+        case SHM_INTERNAL_LONG_DOUBLE:
+        case SHM_INTERNAL_FLOAT_COMPLEX:
+        case SHM_INTERNAL_DOUBLE_COMPLEX:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+/* Apply op to len bytes at target on pe by active message.  The target
+ * performs the update in its progress engine, which serializes it with other
+ * active message updates, and acknowledges it to this context. */
+static inline
+void
+shmem_transport_ucx_amo_am(shmem_transport_ctx_t* ctx, void *target, const void *source,
+                           size_t len, int pe, shm_internal_op_t op,
+                           shm_internal_datatype_t datatype, size_t type_size,
+                           long *completion)
+{
+    uint8_t *remote_addr;
+    ucp_ep_h ep;
+    ucp_rkey_h rkey;
+    ucs_status_t status;
+    shmem_transport_ucx_op_t *rec;
+
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_mark_pending(ctx, pe);
+
+    rec = (shmem_transport_ucx_op_t *) shmem_free_list_alloc(ctx->nb_ops);
+    if (rec == NULL)
+        RAISE_ERROR_STR("Out of memory, allocating UCX operation record");
+
+    rec->cntr         = &ctx->put_cntr;
+    rec->completion   = completion;
+    rec->fl           = ctx->nb_ops;
+    rec->hdr.addr     = (uint64_t) remote_addr;
+    rec->hdr.ack      = (uint64_t) &ctx->am_acked;
+    rec->hdr.op       = op;
+    rec->hdr.datatype = datatype;
+    rec->hdr.count    = len / type_size;
+
+    ucp_request_param_t param = {
+        .op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_USER_DATA |
+                        UCP_OP_ATTR_FIELD_FLAGS,
+        .flags        = UCP_AM_SEND_FLAG_REPLY | UCP_AM_SEND_FLAG_EAGER,
+        .cb.send      = &shmem_transport_ucx_cb_complete,
+        .user_data    = rec
+    };
+
+    shmem_internal_cntr_inc(&ctx->put_cntr.issued);
+    shmem_internal_cntr_inc(&ctx->am_issued);
+    if (completion)
+        __atomic_fetch_add(completion, 1, __ATOMIC_RELAXED);
+
+    ucs_status_ptr_t pstatus = ucp_am_send_nbx(ep, SHMEM_TRANSPORT_UCX_AM_AMO,
+                                               &rec->hdr, sizeof(rec->hdr),
+                                               source, len, &param);
+
+    status = shmem_transport_ucx_post_cb_op(pstatus, rec);
+    UCX_CHECK_STATUS_INPROGRESS(status);
 }
 
 static inline
@@ -487,21 +859,26 @@ shmem_transport_atomic(shmem_transport_ctx_t* ctx, void *target, const void *sou
                        int pe, shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
     uint8_t *remote_addr;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     ucs_status_t status;
     uint64_t value;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    /* Sub-word integers and ops without a UCP equivalent */
+    if (!shmem_transport_ucx_amo_native(op, datatype, len)) {
+        if (shmem_transport_ucx_dtsize(datatype) != len)
+            RAISE_ERROR_MSG("Unsupported atomic (op %d, datatype %d)\n", op, datatype);
 
-    shmem_internal_assert(op <= SHMEM_TRANSPORT_UCX_OP_LAST);
+        shmem_transport_ucx_amo_am(ctx, target, source, len, pe, op, datatype, len, NULL);
+        return;
+    }
+
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_mark_pending(ctx, pe);
+
+    shmem_internal_cntr_inc(&ctx->put_cntr.issued);
 
     switch (len) {
-        case 1:
-            value = (uint64_t) *(uint8_t*)source;
-            break;
-        case 2:
-            value = (uint64_t) *(uint16_t*)source;
-            break;
         case 4:
             value = (uint64_t) *(uint32_t*)source;
             break;
@@ -512,9 +889,12 @@ shmem_transport_atomic(shmem_transport_ctx_t* ctx, void *target, const void *sou
             RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
     }
 
-    status = ucp_atomic_post(shmem_transport_peers[pe].ep, shmem_transport_ucx_post_op[op],
+    status = ucp_atomic_post(ep, shmem_transport_ucx_post_op[op],
                              value, len, (uint64_t) remote_addr, rkey);
     UCX_CHECK_STATUS_INPROGRESS(status);
+
+    if (status == UCS_OK)
+        shmem_internal_cntr_inc(&ctx->put_cntr.completed);
 }
 
 static inline
@@ -522,9 +902,20 @@ void
 shmem_transport_atomicv(shmem_transport_ctx_t* ctx, void *target, const void *source, size_t len,
                         int pe, shm_internal_op_t op, shm_internal_datatype_t datatype, long *completion)
 {
-    /* Used only by reductions, currently redirected to softwre reductions via
-     * the shmem_transport_atomic_supported query below. */
-    RAISE_ERROR_STR("Unsupported operation");
+    size_t type_size = shmem_transport_ucx_dtsize(datatype);
+
+    if (type_size == 0)
+        RAISE_ERROR_MSG("Unsupported atomic vector (op %d, datatype %d)\n", op, datatype);
+
+    /* A single element maps onto one UCP atomic when one exists.  Longer
+     * vectors are sent whole and applied at the target; a given reduction
+     * issues the same length from every PE, so each target location is
+     * always updated through one path. */
+    if (len == type_size && shmem_transport_ucx_amo_native(op, datatype, len))
+        shmem_transport_atomic(ctx, target, source, len, pe, op, datatype);
+    else
+        shmem_transport_ucx_amo_am(ctx, target, source, len, pe, op, datatype,
+                                   type_size, completion);
 }
 
 static inline
@@ -533,11 +924,14 @@ shmem_transport_fetch_atomic(shmem_transport_ctx_t* ctx, void *target, const voi
                              int pe, shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
     uint8_t *remote_addr;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     ucs_status_ptr_t pstatus;
     uint64_t value;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.issued);
 
     shmem_internal_assert(op <= SHMEM_TRANSPORT_UCX_OP_LAST);
 
@@ -558,13 +952,15 @@ shmem_transport_fetch_atomic(shmem_transport_ctx_t* ctx, void *target, const voi
             RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
     }
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep,
+    pstatus = ucp_atomic_fetch_nb(ep,
                                   shmem_transport_ucx_fetch_op[op], value,
                                   dest, len, (uint64_t) remote_addr, rkey,
                                   &shmem_transport_ucx_cb_nop);
 
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
+    ucs_status_t status = shmem_transport_ucx_complete_op(ctx, pstatus);
     UCX_CHECK_STATUS(status);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.completed);
 }
 
 static inline
@@ -573,11 +969,15 @@ shmem_transport_fetch_atomic_nbi(shmem_transport_ctx_t* ctx, void *target, const
                                  int pe, shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
     uint8_t *remote_addr;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     ucs_status_ptr_t pstatus;
     uint64_t value;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_mark_pending(ctx, pe);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.issued);
 
     shmem_internal_assert(op <= SHMEM_TRANSPORT_UCX_OP_LAST);
 
@@ -598,16 +998,19 @@ shmem_transport_fetch_atomic_nbi(shmem_transport_ctx_t* ctx, void *target, const
             RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
     }
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep,
+    pstatus = ucp_atomic_fetch_nb(ep,
                                   shmem_transport_ucx_fetch_op[op], value,
                                   dest, len, (uint64_t) remote_addr, rkey,
                                   &shmem_transport_ucx_cb_nop);
 
     /* Manual progress to avoid deadlock for application-level polling */
-    shmem_transport_probe();
+    shmem_transport_ucx_progress(ctx);
 
     ucs_status_t status = shmem_transport_ucx_release_op(pstatus);
     UCX_CHECK_STATUS_INPROGRESS(status);
+
+    if (status == UCS_OK)
+        shmem_internal_cntr_inc(&ctx->get_cntr.completed);
 }
 
 static inline
@@ -616,17 +1019,22 @@ shmem_transport_atomic_fetch(shmem_transport_ctx_t* ctx, void *target, const voi
                              int pe, shm_internal_datatype_t datatype)
 {
     uint8_t *remote_addr;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     ucs_status_ptr_t pstatus;
 
-    shmem_transport_ucx_get_mr(source, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, source, pe, &remote_addr, &rkey);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.issued);
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_FADD, 0,
+    pstatus = ucp_atomic_fetch_nb(ep, UCP_ATOMIC_FETCH_OP_FADD, 0,
                                   target, len, (uint64_t) remote_addr, rkey,
                                   &shmem_transport_ucx_cb_nop);
 
-    ucs_status_t status = shmem_transport_ucx_complete_op(pstatus);
+    ucs_status_t status = shmem_transport_ucx_complete_op(ctx, pstatus);
     UCX_CHECK_STATUS(status);
+
+    shmem_internal_cntr_inc(&ctx->get_cntr.completed);
 }
 
 static inline
@@ -635,6 +1043,7 @@ shmem_transport_atomic_set(shmem_transport_ctx_t* ctx, void *target, const void
                              int pe, shm_internal_datatype_t datatype)
 {
     uint8_t *remote_addr;
+    ucp_ep_h ep;
     ucp_rkey_h rkey;
     ucs_status_ptr_t pstatus;
     uint64_t value;
@@ -644,7 +1053,10 @@ shmem_transport_atomic_set(shmem_transport_ctx_t* ctx, void *target, const void
      * completion before returning. */
     static uint64_t dest;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    ep = shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_mark_pending(ctx, pe);
+
+    shmem_internal_cntr_inc(&ctx->put_cntr.issued);
 
     switch (len) {
         case 1:
@@ -663,12 +1075,15 @@ shmem_transport_atomic_set(shmem_transport_ctx_t* ctx, void *target, const void
             RAISE_ERROR_MSG("Unsupported datatype len=%zu\n", len);
     }
 
-    pstatus = ucp_atomic_fetch_nb(shmem_transport_peers[pe].ep, UCP_ATOMIC_FETCH_OP_SWAP, value,
+    pstatus = ucp_atomic_fetch_nb(ep, UCP_ATOMIC_FETCH_OP_SWAP, value,
                                   &dest, len, (uint64_t) remote_addr, rkey,
                                   &shmem_transport_ucx_cb_nop);
 
     ucs_status_t status = shmem_transport_ucx_release_op(pstatus);
     UCX_CHECK_STATUS_INPROGRESS(status);
+
+    if (status == UCS_OK)
+        shmem_internal_cntr_inc(&ctx->put_cntr.completed);
 }
 
 static inline
@@ -681,7 +1096,7 @@ shmem_transport_mswap(shmem_transport_ctx_t* ctx, void *target, const void *sour
     ucp_rkey_h rkey;
     int done = 0;
 
-    shmem_transport_ucx_get_mr(target, pe, &remote_addr, &rkey);
+    shmem_transport_ucx_get_mr(ctx, target, pe, &remote_addr, &rkey);
 
     if (len != 4)
         RAISE_ERROR_STR("Unsupported datatype");
@@ -698,15 +1113,34 @@ shmem_transport_mswap(shmem_transport_ctx_t* ctx, void *target, const void *sour
         if (*(uint32_t *)dest == v) done = 1;
 
         /* Manual progress to avoid deadlock for application-level polling */
-        shmem_transport_probe();
+        shmem_transport_ucx_progress(ctx);
     }
 }
 
 static inline
 int shmem_transport_atomic_supported(shm_internal_op_t op, shm_internal_datatype_t datatype)
 {
-    /* Use software reductions, instead of atomic vector operation */
+#ifdef USE_SHR_ATOMICS
+    /* Use software reductions, shared memory atomicv is not implemented */
     return 0;
+#else
+    switch (datatype) {
+        case SHM_INTERNAL_FLOAT:
+        case SHM_INTERNAL_DOUBLE:
+        case SHM_INTERNAL_LONG_DOUBLE:
+            return op == SHM_INTERNAL_SUM || op == SHM_INTERNAL_PROD ||
+                   op == SHM_INTERNAL_MIN || op == SHM_INTERNAL_MAX;
+        case SHM_INTERNAL_FLOAT_COMPLEX:
+        case SHM_INTERNAL_DOUBLE_COMPLEX:
+            return op == SHM_INTERNAL_SUM || op == SHM_INTERNAL_PROD;
+        case SHM_INTERNAL_UCHAR:
+            return op == SHM_INTERNAL_BAND || op == SHM_INTERNAL_BOR ||
+                   op == SHM_INTERNAL_BXOR;
+        default:
+            /* Active message updates go through shmem_internal_reduce_local */
+            return shmem_transport_ucx_dtsize(datatype) != 0;
+    }
+#endif
 }
 
 static inline
@@ -809,37 +1243,48 @@ void shmem_transport_received_cntr_wait(uint64_t ge_val)
 static inline
 uint64_t shmem_transport_pcntr_get_issued_write(shmem_transport_ctx_t *ctx)
 {
-    return 0;
+    return shmem_internal_cntr_read(&ctx->put_cntr.issued);
 }
 
 static inline
 uint64_t shmem_transport_pcntr_get_issued_read(shmem_transport_ctx_t *ctx)
 {
-    return 0;
+    return shmem_internal_cntr_read(&ctx->get_cntr.issued);
 }
 
 static inline
 uint64_t shmem_transport_pcntr_get_completed_write(shmem_transport_ctx_t *ctx)
 {
-    return 0;
+    return shmem_transport_ucx_cntr_completed(&ctx->put_cntr);
 }
 
 static inline
 uint64_t shmem_transport_pcntr_get_completed_read(shmem_transport_ctx_t *ctx)
 {
-    return 0;
+    return shmem_transport_ucx_cntr_completed(&ctx->get_cntr);
 }
 
 static inline
 uint64_t shmem_transport_pcntr_get_completed_target(void)
 {
+    /* UCX does not report incoming operations */
     return 0;
 }
 
+static inline
+double shmem_transport_pcntr_get_cq_batch(shmem_transport_ctx_t *ctx)
+{
+    return 0.0;
+}
+
 static inline
 void shmem_transport_pcntr_get_all(shmem_transport_ctx_t *ctx, shmemx_pcntr_t *pcntr)
 {
-    return;
+    pcntr->completed_put = shmem_transport_pcntr_get_completed_write(ctx);
+    pcntr->pending_put   = shmem_transport_pcntr_get_issued_write(ctx);
+    pcntr->completed_get = shmem_transport_pcntr_get_completed_read(ctx);
+    pcntr->pending_get   = shmem_transport_pcntr_get_issued_read(ctx);
+    pcntr->target        = shmem_transport_pcntr_get_completed_target();
 }
 
 #endif /* TRANSPORT_UCX_H */
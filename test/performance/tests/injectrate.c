@@ -0,0 +1,195 @@
+/* -*- C -*-
+ *
+ * Copyright 2011 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S.  Government
+ * retains certain rights in this software.
+ *
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ * This software is available to you under the BSD license.
+ *
+ * This file is part of the Sandia OpenSHMEM software package. For license
+ * information, see the LICENSE file in the top level directory of the
+ * distribution.
+ *
+ */
+
+/*
+ * Small-message injection rate.  Each PE issues single-element puts and
+ * atomics to a rotating set of peers, targeting either the symmetric heap or
+ * the symmetric data segment, and the aggregate rate is reported.  The
+ * per-operation cost is dominated by the library's issue path, including
+ * remote address and key translation.
+ */
+
+#include <shmem.h>
+#include <shmemx.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define MAX_WINDOW 1024
+
+/* configuration parameters - setable by command line arguments */
+int niters = 100;
+int window = 256;
+int heap_only = 0;
+int machine_output = 0;
+
+/* globals */
+long data_target[MAX_WINDOW];
+long *heap_target;
+double rate, total_rate;
+
+int rank = -1;
+int world_size = -1;
+
+
+static inline double
+timer(void)
+{
+#ifdef HAVE_SHMEMX_WTIME
+    return shmemx_wtime();
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0;
+#endif /* HAVE_SHMEMX_WTIME */
+}
+
+
+static void
+display_result(const char *test, const double result)
+{
+    if (0 == rank) {
+        if (machine_output) {
+            printf("%.2f ", result);
+        } else {
+            printf("%16s: %.2f Mops/s\n", test, result);
+        }
+    }
+}
+
+
+static void
+test_p(const char *name, long *target)
+{
+    int i, k;
+    double start;
+
+    shmem_barrier_all();
+
+    start = timer();
+    for (i = 0 ; i < niters ; ++i) {
+        for (k = 0 ; k < window ; ++k) {
+            shmem_long_p(&target[k], k, (rank + 1 + k) % world_size);
+        }
+        shmem_quiet();
+    }
+    rate = (double) niters * window / (timer() - start) / 1.0e6;
+
+    shmem_double_sum_reduce(SHMEM_TEAM_WORLD, &total_rate, &rate, 1);
+    display_result(name, total_rate);
+}
+
+
+static void
+test_atomic_add(const char *name, long *target)
+{
+    int i, k;
+    double start;
+
+    shmem_barrier_all();
+
+    start = timer();
+    for (i = 0 ; i < niters ; ++i) {
+        for (k = 0 ; k < window ; ++k) {
+            shmem_long_atomic_add(&target[k], 1, (rank + 1 + k) % world_size);
+        }
+        shmem_quiet();
+    }
+    rate = (double) niters * window / (timer() - start) / 1.0e6;
+
+    shmem_double_sum_reduce(SHMEM_TEAM_WORLD, &total_rate, &rate, 1);
+    display_result(name, total_rate);
+}
+
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: injectrate [OPTION]...\n\n");
+    fprintf(stderr, "  -h           Display this help message and exit\n");
+    fprintf(stderr, "  -i <num>     Number of iterations per test\n");
+    fprintf(stderr, "  -w <num>     Number of operations per iteration (max %d)\n", MAX_WINDOW);
+    fprintf(stderr, "  -H           Only target the symmetric heap\n");
+    fprintf(stderr, "  -o           Format output to be machine readable\n");
+}
+
+
+int
+main(int argc, char *argv[])
+{
+    int ch;
+
+    shmem_init();
+
+    rank = shmem_my_pe();
+    world_size = shmem_n_pes();
+
+    while ((ch = getopt(argc, argv, "i:w:Hoh")) != -1) {
+        switch (ch) {
+        case 'i':
+            niters = atoi(optarg);
+            break;
+        case 'w':
+            window = atoi(optarg);
+            break;
+        case 'H':
+            heap_only = 1;
+            break;
+        case 'o':
+            machine_output = 1;
+            break;
+        case 'h':
+        default:
+            if (0 == rank) usage();
+            shmem_finalize();
+            return 1;
+        }
+    }
+
+    if (window < 1 || window > MAX_WINDOW || niters < 1) {
+        if (0 == rank) usage();
+        shmem_finalize();
+        return 1;
+    }
+
+    heap_target = shmem_calloc(MAX_WINDOW, sizeof(long));
+    if (NULL == heap_target) {
+        fprintf(stderr, "%d: Symmetric heap allocation failed\n", rank);
+        shmem_global_exit(1);
+    }
+
+    if (0 == rank && !machine_output) {
+        printf("job size:   %d\n", world_size);
+        printf("niters:     %d\n", niters);
+        printf("window:     %d\n", window);
+    }
+
+    test_p("put heap", heap_target);
+    if (!heap_only)
+        test_p("put data", data_target);
+
+    test_atomic_add("atomic add heap", heap_target);
+    if (!heap_only)
+        test_atomic_add("atomic add data", data_target);
+
+    if (0 == rank && machine_output) printf("\n");
+
+    shmem_barrier_all();
+    shmem_free(heap_target);
+    shmem_finalize();
+
+    return 0;
+}
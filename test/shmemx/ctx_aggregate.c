@@ -0,0 +1,102 @@
+/*
+ *  Copyright (c) 2026 Intel Corporation. All rights reserved.
+ *  This software is available to you under the BSD license below:
+ *
+ *      Redistribution and use in source and binary forms, with or
+ *      without modification, are permitted provided that the following
+ *      conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Validate write-combining of small puts on a SHMEMX_CTX_AGGREGATE context.
+ * Exercises contiguous runs, strided (non-contiguous) targets, repeated
+ * writes to the same location, and alternating destination PEs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <shmem.h>
+#include <shmemx.h>
+
+#define N 1024
+
+long dest[N];
+long flag[N];
+
+int main(int argc, char **argv) {
+    int i, me, npes, next, prev, errors = 0;
+    shmem_ctx_t ctx;
+
+    shmem_init();
+
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+    next = (me + 1) % npes;
+    prev = (me + npes - 1) % npes;
+
+    if (shmem_ctx_create(SHMEMX_CTX_AGGREGATE, &ctx)) {
+        printf("%d: Unable to create aggregating context, using default\n", me);
+        ctx = SHMEM_CTX_DEFAULT;
+    }
+
+    /* Contiguous run */
+    for (i = 0; i < N / 2; i++)
+        shmem_ctx_long_p(ctx, &dest[i], me * N + i, next);
+
+    /* Strided targets, written twice to check that a fence keeps the later
+     * values winning */
+    for (i = N / 2; i < N; i += 4)
+        shmem_ctx_long_p(ctx, &dest[i], -1, next);
+    shmem_ctx_fence(ctx);
+    for (i = N / 2; i < N; i += 4)
+        shmem_ctx_long_p(ctx, &dest[i], me * N + i, next);
+
+    shmem_ctx_fence(ctx);
+
+    /* Fill the gaps, alternating between two targets */
+    for (i = N / 2; i < N; i++) {
+        if (i % 4 == 0) continue;
+        shmem_ctx_long_p(ctx, &dest[i], me * N + i, next);
+        shmem_ctx_long_p(ctx, &flag[i], me, prev);
+    }
+
+    shmem_ctx_quiet(ctx);
+    shmem_barrier_all();
+
+    for (i = 0; i < N; i++) {
+        if (dest[i] != prev * N + i) {
+            if (errors < 10)
+                printf("%d: dest[%d] = %ld, expected %d\n", me, i, dest[i], prev * N + i);
+            errors++;
+        }
+        if (i >= N / 2 && i % 4 != 0 && flag[i] != next) {
+            if (errors < 10)
+                printf("%d: flag[%d] = %ld, expected %d\n", me, i, flag[i], next);
+            errors++;
+        }
+    }
+
+    if (ctx != SHMEM_CTX_DEFAULT)
+        shmem_ctx_destroy(ctx);
+
+    shmem_finalize();
+
+    return errors != 0;
+}
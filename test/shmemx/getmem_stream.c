@@ -0,0 +1,128 @@
+/*
+ *  Copyright (c) 2026 Intel Corporation. All rights reserved.
+ *  This software is available to you under the BSD license below:
+ *
+ *      Redistribution and use in source and binary forms, with or
+ *      without modification, are permitted provided that the following
+ *      conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Validate shmemx_getmem_stream.  Pieces must be handed to the callback in
+ * address order, cover the whole buffer exactly once, and already hold the
+ * source data when the callback runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <shmem.h>
+#include <shmemx.h>
+
+#define N (1024 * 1024 + 17)
+
+struct stream_state {
+    long   *base;
+    size_t  next;
+    long    npieces;
+    long    errors;
+    long    expected_base;
+};
+
+static void check_piece(void *chunk, size_t nbytes, void *arg)
+{
+    struct stream_state *st = (struct stream_state *) arg;
+    long *p = (long *) chunk;
+    size_t i, first = (size_t) (p - st->base);
+
+    if ((uint8_t *) chunk != (uint8_t *) st->base + st->next * sizeof(long) ||
+        nbytes % sizeof(long) != 0) {
+        if (st->errors < 10)
+            printf("%d: piece %ld at offset %zu (%zu bytes), expected offset %zu\n",
+                   shmem_my_pe(), st->npieces,
+                   (size_t) ((uint8_t *) chunk - (uint8_t *) st->base), nbytes,
+                   st->next * sizeof(long));
+        st->errors++;
+    }
+
+    for (i = 0; i < nbytes / sizeof(long); i++) {
+        if (p[i] != st->expected_base + (long) (first + i)) {
+            if (st->errors < 10)
+                printf("%d: dest[%zu] = %ld, expected %ld\n", shmem_my_pe(),
+                       first + i, p[i], st->expected_base + (long) (first + i));
+            st->errors++;
+            break;
+        }
+    }
+
+    st->next = first + nbytes / sizeof(long);
+    st->npieces++;
+}
+
+int main(int argc, char **argv) {
+    int me, npes, next;
+    long *src, *dest;
+    size_t i;
+    struct stream_state st;
+
+    shmem_init();
+
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+    next = (me + 1) % npes;
+
+    src = shmem_malloc(N * sizeof(long));
+    dest = malloc(N * sizeof(long));
+    if (src == NULL || dest == NULL) {
+        printf("%d: Allocation failed\n", me);
+        shmem_global_exit(1);
+    }
+
+    for (i = 0; i < N; i++) {
+        src[i] = (long) me * N + (long) i;
+        dest[i] = -1;
+    }
+
+    shmem_barrier_all();
+
+    st.base = dest;
+    st.next = 0;
+    st.npieces = 0;
+    st.errors = 0;
+    st.expected_base = (long) next * N;
+
+    shmemx_getmem_stream(dest, src, N * sizeof(long), next, check_piece, &st);
+
+    if (st.next != N) {
+        printf("%d: pieces covered %zu of %d elements\n", me, st.next, N);
+        st.errors++;
+    }
+
+    /* Zero-length transfers do not call back */
+    shmemx_ctx_getmem_stream(SHMEM_CTX_DEFAULT, dest, src, 0, next, check_piece, &st);
+
+    shmem_barrier_all();
+
+    shmem_free(src);
+    free(dest);
+    shmem_finalize();
+
+    return st.errors != 0;
+}
@@ -57,6 +57,7 @@ static void put_and_progress_check(void) {
 
     shmem_ctx_t ctx;
     shmemx_pcntr_t pcntr;
+    double cq_batch;
     ret = shmem_ctx_create(SHMEM_CTX_PRIVATE, &ctx);
     if (ret) {
         printf("Error creating context (%d)\n", ret);
@@ -72,6 +73,7 @@ static void put_and_progress_check(void) {
     }
 
     shmemx_pcntr_get_all(ctx, &pcntr);
+    shmemx_pcntr_get_cq_batch(ctx, &cq_batch);
     if (ctx != SHMEM_CTX_DEFAULT)
         shmem_ctx_destroy(ctx);
 
@@ -84,8 +86,9 @@ static void put_and_progress_check(void) {
            "Issued Put    = %10"PRIu64"\n"
            "Issued Get    = %10"PRIu64"\n"
            "Target        = %10"PRIu64"\n"
+           "Avg. CQ batch = %10.2f\n"
            , pcntr.completed_put, pcntr.completed_get, pcntr.pending_put,
-           pcntr.pending_get, pcntr.target);
+           pcntr.pending_get, pcntr.target, cq_batch);
 
     return;
 }
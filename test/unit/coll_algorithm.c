@@ -0,0 +1,207 @@
+/*
+ *  Copyright (c) 2026 Intel Corporation. All rights reserved.
+ *  This software is available to you under the BSD license below:
+ *
+ *      Redistribution and use in source and binary forms, with or
+ *      without modification, are permitted provided that the following
+ *      conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Run the collectives with one algorithm forced through the environment.
+ * The variable and value are given at compile time by COLL_ENV and
+ * COLL_ALGORITHM, and set before shmem_init.  Each collective is validated
+ * over teams of every size with strides of one and two, starting at the
+ * first and second PE, so runs on three or more PEs cover non-power-of-two
+ * and strided sets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <shmem.h>
+
+#if !defined(COLL_ENV) || !defined(COLL_ALGORITHM)
+#error "COLL_ENV and COLL_ALGORITHM must be defined"
+#endif
+
+#define MAX_NELEMS   4096
+#define COLLECT_UNIT 37
+
+static const size_t bcast_sizes[]  = { 1, 100, 3 * 8192 + 5 };
+static const size_t reduce_sizes[] = { 1, 7, 3000 };
+static const size_t fcoll_sizes[]  = { 1, 1000 };
+
+#define NSIZES(a) (sizeof(a) / sizeof((a)[0]))
+
+static long *src, *dst;
+static int me, npes;
+
+static int check(const char *coll, int start, int stride, int size,
+                 size_t i, long expected)
+{
+    if (dst[i] != expected) {
+        printf("%d: %s (%d, %d, %d): expected dst[%zu] = %ld, got %ld\n",
+               me, coll, start, stride, size, i, expected, dst[i]);
+        return 1;
+    }
+    return 0;
+}
+
+static void reset_dst(void)
+{
+    for (size_t i = 0; i < (size_t) npes * MAX_NELEMS; i++)
+        dst[i] = -1;
+}
+
+static int test_team(shmem_team_t team, int start, int stride, int size)
+{
+    int errors = 0;
+    int rank = shmem_team_my_pe(team);
+    size_t i, n, total;
+    int j, root;
+
+    /* Broadcast: every root for the small sizes, the last PE for the large
+     * one.  Only the non-root PEs are checked. */
+    for (n = 0; n < NSIZES(bcast_sizes); n++) {
+        size_t nbytes = bcast_sizes[n];
+        size_t nlongs = (nbytes + sizeof(long) - 1) / sizeof(long);
+
+        root = (n + 1 < NSIZES(bcast_sizes)) ? 0 : size - 1;
+
+        for ( ; root < size; root++) {
+            for (i = 0; i < nlongs; i++)
+                src[i] = root * 1000000L + (long) i;
+            reset_dst();
+            shmem_team_sync(team);
+
+            shmem_broadcastmem(team, dst, src, nbytes, root);
+
+            if (rank != root) {
+                if (memcmp(dst, src, nbytes) != 0) {
+                    printf("%d: broadcast (%d, %d, %d) of %zu bytes from %d: data mismatch\n",
+                           me, start, stride, size, nbytes, root);
+                    errors++;
+                }
+                errors += check("broadcast", start, stride, size, nlongs, -1);
+            }
+            shmem_team_sync(team);
+        }
+    }
+
+    /* Sum reduction */
+    for (n = 0; n < NSIZES(reduce_sizes); n++) {
+        size_t count = reduce_sizes[n];
+        long base = (long) size * (size - 1) / 2;
+
+        for (i = 0; i < count; i++)
+            src[i] = rank + (long) i;
+        reset_dst();
+        shmem_team_sync(team);
+
+        shmem_long_sum_reduce(team, dst, src, count);
+
+        for (i = 0; i < count; i++)
+            errors += check("sum_reduce", start, stride, size, i,
+                            base + (long) size * (long) i);
+        errors += check("sum_reduce", start, stride, size, count, -1);
+        shmem_team_sync(team);
+    }
+
+    /* Collect: team PE r contributes (r + 1) * COLLECT_UNIT elements */
+    for (i = 0; i < (size_t) (rank + 1) * COLLECT_UNIT; i++)
+        src[i] = rank * 1000000L + (long) i;
+    reset_dst();
+    shmem_team_sync(team);
+
+    shmem_long_collect(team, dst, src, (size_t) (rank + 1) * COLLECT_UNIT);
+
+    for (j = 0, total = 0; j < size; j++)
+        for (i = 0; i < (size_t) (j + 1) * COLLECT_UNIT; i++, total++)
+            errors += check("collect", start, stride, size, total,
+                            j * 1000000L + (long) i);
+    errors += check("collect", start, stride, size, total, -1);
+    shmem_team_sync(team);
+
+    /* Fixed-size collect */
+    for (n = 0; n < NSIZES(fcoll_sizes); n++) {
+        size_t count = fcoll_sizes[n];
+
+        for (i = 0; i < count; i++)
+            src[i] = rank * 1000000L + (long) i;
+        reset_dst();
+        shmem_team_sync(team);
+
+        shmem_long_fcollect(team, dst, src, count);
+
+        for (j = 0; j < size; j++)
+            for (i = 0; i < count; i++)
+                errors += check("fcollect", start, stride, size, j * count + i,
+                                j * 1000000L + (long) i);
+        errors += check("fcollect", start, stride, size, size * count, -1);
+        shmem_team_sync(team);
+    }
+
+    return errors;
+}
+
+int main(void)
+{
+    int errors = 0;
+    int start, stride, size;
+
+    setenv(COLL_ENV, COLL_ALGORITHM, 1);
+
+    shmem_init();
+
+    me = shmem_my_pe();
+    npes = shmem_n_pes();
+
+    src = shmem_malloc(MAX_NELEMS * sizeof(long));
+    dst = shmem_malloc((size_t) npes * MAX_NELEMS * sizeof(long));
+
+    if (me == 0)
+        printf("Testing collectives with %s=%s\n", COLL_ENV, COLL_ALGORITHM);
+
+    for (stride = 1; stride <= 2; stride++) {
+        for (start = 0; start <= 1 && start < npes; start++) {
+            for (size = (npes - 1 - start) / stride + 1; size > 0; size--) {
+                shmem_team_t team;
+
+                shmem_team_split_strided(SHMEM_TEAM_WORLD, start, stride, size,
+                                         NULL, 0, &team);
+
+                if (team != SHMEM_TEAM_INVALID) {
+                    errors += test_team(team, start, stride, size);
+                    shmem_team_destroy(team);
+                }
+
+                shmem_barrier_all();
+            }
+        }
+    }
+
+    shmem_free(dst);
+    shmem_free(src);
+
+    shmem_finalize();
+
+    return errors != 0;
+}